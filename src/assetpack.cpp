@@ -0,0 +1,184 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assetpack.hpp"
+#include "followexception.hpp"
+
+// Return if a number is a power of two
+static bool
+is_power_of_two(uint32_t n)
+{
+    return n && !(n & (n - 1));
+}
+
+/* Constructor.
+   Parameters:
+     * file: path of the asset pack.
+   Throws FollowException if the file can't be mapped or isn't a valid asset
+   pack.
+*/
+AssetPack::AssetPack(const string& file):
+    data(0), length(0), header(0), entries(0)
+{
+    const asset_entry_t *e;
+    struct stat st;
+    void *addr;
+    int fd;
+
+    if ((fd = open(file.c_str(), O_RDONLY)) < 0) {
+        throw FollowException("cannot open " + file + ": " + strerror(errno));
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw FollowException("cannot stat " + file + ": " + strerror(errno));
+    }
+    length = st.st_size;
+    if (length < sizeof(asset_header_t)) {
+        close(fd);
+        throw FollowException(file + " is not an asset pack");
+    }
+    addr = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw FollowException("cannot map " + file + ": " + strerror(errno));
+    }
+    data = (unsigned char *)addr;
+    header = (const asset_header_t *)data;
+    entries = (const asset_entry_t *)(header + 1);
+
+    // Check the header and that all the assets are inside the file
+    try {
+        if (memcmp(header->magic, ASSET_MAGIC, ASSET_MAGIC_SIZE) != 0) {
+            throw FollowException(file + " is not an asset pack");
+        }
+        if (header->version != ASSET_VERSION) {
+            throw FollowException(file + " has an unsupported version");
+        }
+        if (sizeof(asset_header_t) + header->nassets * sizeof(asset_entry_t)
+            > length)
+        {
+            throw FollowException(file + " is truncated");
+        }
+        for (uint32_t i = 0; i < header->nassets; i++) {
+            e = &entries[i];
+            if (e->offset > length || e->size > length - e->offset) {
+                throw FollowException(file + " is truncated");
+            }
+            // The other files are given as strings, so they must end with
+            // their null byte
+            if (!memchr(e->name, 0, ASSET_NAME_SIZE)
+                || (e->levels > 0 && e->size
+                != get_texture_size(e->width, e->height, e->levels))
+                || (!e->levels && (!e->size
+                || data[e->offset + e->size - 1] != 0)))
+            {
+                throw FollowException(file + " has an invalid entry");
+            }
+        }
+    } catch (FollowException&) {
+        munmap(data, length);
+        throw;
+    }
+}
+
+AssetPack::~AssetPack()
+{
+    if (data)
+        munmap(data, length);
+}
+
+/* Find an asset.
+   Parameters:
+     * name: name of the asset.
+   Return its entry, or 0 if the pack doesn't have it.
+*/
+const asset_entry_t *
+AssetPack::find(const string& name) const
+{
+    for (uint32_t i = 0; i < header->nassets; i++) {
+        if (name == entries[i].name)
+            return &entries[i];
+    }
+    return 0;
+}
+
+/* Return the data of an asset.
+   Parameters:
+     * entry: entry of the asset.
+*/
+const unsigned char *
+AssetPack::get_data(const asset_entry_t& entry) const
+{
+    return data + entry.offset;
+}
+
+/* Return the size in bytes of all the mip levels of a texture.
+   Parameters:
+     * width: width of the texture.
+     * height: height of the texture.
+     * levels: number of mip levels.
+*/
+size_t
+AssetPack::get_texture_size(uint32_t width, uint32_t height, uint32_t levels)
+{
+    size_t size = 0;
+
+    for (uint32_t i = 0; i < levels; i++) {
+        size += (size_t)width * height * 3;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+/* Add the mip levels of a texture after the first one, each one with the
+   mean of 2x2 pixels of the previous one. They are only added when both
+   sides are powers of two, as GLES2 has no mipmaps for the other textures.
+   Parameters:
+     * data: the texture, with the first level in it.
+     * width: width of the texture.
+     * height: height of the texture.
+   Return the number of mip levels, including the first one.
+*/
+uint32_t
+AssetPack::add_levels(vector<unsigned char>& data, uint32_t width,
+    uint32_t height)
+{
+    uint32_t w = width, h = height, nw, nh, levels = 1;
+    size_t src = 0, dst;
+    unsigned int sum;
+
+    if (!is_power_of_two(width) || !is_power_of_two(height))
+        return levels;
+    while (w > 1 || h > 1) {
+        nw = w > 1 ? w / 2 : 1;
+        nh = h > 1 ? h / 2 : 1;
+        dst = data.size();
+        data.resize(dst + (size_t)nw * nh * 3);
+        for (uint32_t y = 0; y < nh; y++) {
+            for (uint32_t x = 0; x < nw; x++) {
+                for (int c = 0; c < 3; c++) {
+                    // With a side of 1, the pixels of that side are repeated
+                    sum = 0;
+                    for (uint32_t dy = 0; dy < 2; dy++) {
+                        for (uint32_t dx = 0; dx < 2; dx++) {
+                            sum += data[src + (((y * 2 + dy) % h) * w
+                                + (x * 2 + dx) % w) * 3 + c];
+                        }
+                    }
+                    data[dst + (y * nw + x) * 3 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+        src = dst;
+        w = nw;
+        h = nh;
+        levels++;
+    }
+    return levels;
+}
@@ -0,0 +1,123 @@
+/* assetpack.hpp
+   Layout of the asset pack, a single file with the textures and the
+   shaders of the virtual track, written by follow-mkpack. It has a fixed
+   header, followed by an entry for each asset and then the data of the
+   assets, each one aligned to ASSET_ALIGNMENT bytes. The textures are RGB,
+   3 bytes for each pixel and rows without padding, with all their mip
+   levels one after another from the largest. The other files are kept as
+   they are, with a null byte at the end. All the values are in the byte
+   order of the machine that wrote the file.
+   The pack is mapped read only, so the data is given to OpenGL without
+   copying it, and all the processes that use the pack share the pages.
+*/
+
+#ifndef ASSETPACK_HPP
+#define ASSETPACK_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Magic string at the start of the file and version of the layout
+#define ASSET_MAGIC         "FOLLOWAP"
+#define ASSET_MAGIC_SIZE    8
+#define ASSET_VERSION       1
+
+// Size of the names of the assets, with the null byte
+#define ASSET_NAME_SIZE     48
+
+// Alignment of the data of each asset
+#define ASSET_ALIGNMENT     16
+
+// Header of the file
+typedef struct {
+    char magic[ASSET_MAGIC_SIZE];
+    uint32_t version;
+
+    // Number of assets
+    uint32_t nassets;
+} asset_header_t;
+
+// Entry of an asset
+typedef struct {
+    // Name of the file the asset was made from, without the directory
+    char name[ASSET_NAME_SIZE];
+
+    // Size of the textures and number of mip levels (0 for other files)
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t reserved;
+
+    // Offset and size of the data
+    uint64_t offset;
+    uint64_t size;
+} asset_entry_t;
+
+// An asset pack mapped in memory
+class AssetPack {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * file: path of the asset pack.
+           Throws FollowException if the file can't be mapped or isn't a
+           valid asset pack.
+        */
+        AssetPack(const string& file);
+
+        // Destructor
+        ~AssetPack();
+
+        /* Find an asset.
+           Parameters:
+             * name: name of the asset.
+           Return its entry, or 0 if the pack doesn't have it.
+        */
+        const asset_entry_t *find(const string& name) const;
+
+        /* Return the data of an asset.
+           Parameters:
+             * entry: entry of the asset.
+        */
+        const unsigned char *get_data(const asset_entry_t& entry) const;
+
+        /* Return the size in bytes of all the mip levels of a texture.
+           Parameters:
+             * width: width of the texture.
+             * height: height of the texture.
+             * levels: number of mip levels.
+        */
+        static size_t get_texture_size(uint32_t width, uint32_t height,
+            uint32_t levels);
+
+        /* Add the mip levels of a texture after the first one, each one
+           with the mean of 2x2 pixels of the previous one. They are only
+           added when both sides are powers of two, as GLES2 has no mipmaps
+           for the other textures.
+           Parameters:
+             * data: the texture, with the first level in it.
+             * width: width of the texture.
+             * height: height of the texture.
+           Return the number of mip levels, including the first one.
+        */
+        static uint32_t add_levels(vector<unsigned char>& data,
+            uint32_t width, uint32_t height);
+
+    private:
+
+        // The mapped file
+        unsigned char *data;
+        size_t length;
+
+        // The header and the entries
+        const asset_header_t *header;
+        const asset_entry_t *entries;
+};
+
+#endif
+
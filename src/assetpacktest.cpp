@@ -0,0 +1,184 @@
+/* assetpacktest.cpp
+   Checks that a pack written by follow-mkpack is read back with the same
+   assets, and that the packs that are corrupt or truncated are rejected.
+   It's run from the build directory, where follow-mkpack is.
+*/
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "assetpack.hpp"
+#include "followexception.hpp"
+#include "testcheck.hpp"
+
+// Size of the texture of the test, its mip levels go down to 1x1
+#define TEXTURE_W   4
+#define TEXTURE_H   2
+
+#define MKPACK      "./follow-mkpack"
+
+const char shader[] = "void main() { gl_FragColor = vec4(1.0); }\n";
+
+/* Write a file.
+   Parameters:
+     * file: path of the file.
+     * data: contents.
+*/
+void
+write_file(const string& file, const vector<unsigned char>& data)
+{
+    FILE *f;
+
+    if (!(f = fopen(file.c_str(), "w")))
+        err(1, "cannot create %s", file.c_str());
+    if (!data.empty())
+        fwrite(&data[0], 1, data.size(), f);
+    if (ferror(f) || fclose(f) != 0)
+        err(1, "cannot write %s", file.c_str());
+}
+
+/* Read a file.
+   Parameters:
+     * file: path of the file.
+     * data: returned contents.
+*/
+void
+read_file(const string& file, vector<unsigned char>& data)
+{
+    unsigned char buf[BUFSIZ];
+    FILE *f;
+    size_t r;
+
+    if (!(f = fopen(file.c_str(), "r")))
+        err(1, "cannot open %s", file.c_str());
+    data.clear();
+    while ((r = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + r);
+    }
+    fclose(f);
+}
+
+// Check the assets of the pack written by follow-mkpack
+void
+check_round_trip(const string& pack, const vector<unsigned char>& texture)
+{
+    const asset_entry_t *e;
+    vector<unsigned char> levels(texture);
+
+    try {
+        AssetPack assets(pack);
+
+        AssetPack::add_levels(levels, TEXTURE_W, TEXTURE_H);
+        e = assets.find("texture.data");
+        CHECK(e && e->width == TEXTURE_W && e->height == TEXTURE_H
+            && e->levels == 3 && e->size == levels.size()
+            && e->offset % ASSET_ALIGNMENT == 0
+            && !memcmp(assets.get_data(*e), &levels[0], levels.size()),
+            "wrong texture in the pack");
+        e = assets.find("shader.sl");
+        CHECK(e && e->levels == 0 && e->size == sizeof(shader)
+            && e->offset % ASSET_ALIGNMENT == 0
+            && !memcmp(assets.get_data(*e), shader, sizeof(shader)),
+            "wrong shader in the pack");
+        CHECK(!assets.find("missing.sl"), "asset found that isn't there");
+    } catch (FollowException& e) {
+        CHECK(false, "cannot read the pack: %s", e.what());
+    }
+}
+
+/* Check that a pack is rejected.
+   Parameters:
+     * file: path where to write the pack.
+     * data: contents of the pack.
+     * what: what is wrong with the pack.
+*/
+void
+check_rejected(const string& file, const vector<unsigned char>& data,
+    const char *what)
+{
+    write_file(file, data);
+    try {
+        AssetPack assets(file);
+        CHECK(false, "pack accepted with %s", what);
+    } catch (FollowException& e) {
+    }
+}
+
+// Check that the corrupt packs are rejected
+void
+check_corrupt(const string& pack, const string& file)
+{
+    vector<unsigned char> good, bad;
+    asset_header_t *header;
+    asset_entry_t *texture, *shader;
+
+    read_file(pack, good);
+    // Each check starts again from the good pack
+#define CORRUPT(what, change) \
+    do { \
+        bad = good; \
+        header = (asset_header_t *)&bad[0]; \
+        texture = (asset_entry_t *)(header + 1); \
+        shader = texture + 1; \
+        change; \
+        check_rejected(file, bad, what); \
+    } while (0)
+
+    CORRUPT("an empty file", bad.clear());
+    CORRUPT("a wrong magic", header->magic[0] = 'X');
+    CORRUPT("a wrong version", header->version = ASSET_VERSION + 1);
+    CORRUPT("the entries out of the file", header->nassets = 1000);
+    CORRUPT("the data truncated", bad.pop_back());
+    CORRUPT("an offset out of the file", shader->offset = bad.size() + 1);
+    CORRUPT("a name without its null byte",
+        memset(texture->name, 'a', ASSET_NAME_SIZE));
+    CORRUPT("a texture of the wrong size", texture->levels = 1);
+    CORRUPT("a shader without its null byte",
+        bad[shader->offset + shader->size - 1] = 'a');
+    CORRUPT("an empty shader", shader->size = 0);
+#undef CORRUPT
+}
+
+int
+main(int argc, char **argv)
+{
+    char dir[] = "/tmp/assetpacktest.XXXXXX";
+    vector<unsigned char> texture(TEXTURE_W * TEXTURE_H * 3);
+    string texture_file, shader_file, pack, bad_pack, command;
+
+    if (!mkdtemp(dir))
+        err(1, "cannot create a temporary directory");
+    texture_file = string(dir) + "/texture.data";
+    shader_file = string(dir) + "/shader.sl";
+    pack = string(dir) + "/test.pack";
+    bad_pack = string(dir) + "/bad.pack";
+
+    // The shader is written without the null byte, that mkpack adds
+    for (size_t i = 0; i < texture.size(); i++) {
+        texture[i] = i * 7;
+    }
+    write_file(texture_file, texture);
+    write_file(shader_file, vector<unsigned char>(shader,
+        shader + sizeof(shader) - 1));
+    command = string(MKPACK) + " " + pack + " " + texture_file + "="
+        + to_string(TEXTURE_W) + "x" + to_string(TEXTURE_H) + " "
+        + shader_file;
+    if (system(command.c_str()) != 0) {
+        CHECK(false, "%s failed", MKPACK);
+    } else {
+        check_round_trip(pack, texture);
+        check_corrupt(pack, bad_pack);
+    }
+
+    unlink(texture_file.c_str());
+    unlink(shader_file.c_str());
+    unlink(pack.c_str());
+    unlink(bad_pack.c_str());
+    rmdir(dir);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+
+#include <atomic>
+#include <err.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <glm/glm.hpp>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "followexception.hpp"
+#include "motors.hpp"
+#include "options.hpp"
+#include "pilot.hpp"
+#include "pipeline.hpp"
+#include "replaycamera.hpp"
+#include "stats.hpp"
+#include "utilities.hpp"
+#include "v4l2camera.hpp"
+
+#define OPTSTRING   "c:n:w:h"
+
+#define DEFAULT_FRAMES  1000
+#define DEFAULT_WARMUP  100
+
+#define NS_PER_SECOND   1e9
+
+using namespace utilities;
+
+// Configuration file
+const char *config_file = 0;
+
+// File of raw frames
+const char *frames_file = 0;
+
+// Number of frames to measure and to run before measuring
+long nframes = DEFAULT_FRAMES;
+long nwarmup = DEFAULT_WARMUP;
+
+// Number of allocations done through operator new. The data of the frames
+// and other cv::Mat is allocated by OpenCV with cv::fastMalloc, that isn't
+// counted
+static atomic<unsigned long> allocations(0);
+
+void *
+operator new(size_t size)
+{
+    void *p;
+
+    allocations++;
+    if (!(p = malloc(size ? size : 1))) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void
+operator delete(void *p, size_t size) noexcept
+{
+    free(p);
+}
+
+// Motors that don't move, that only let the pilot compute the commands that
+// the line follower would give, that the road finder uses to track the road
+class BenchMotors: public Motors {
+
+    public:
+
+        BenchMotors(float wheel_distance): Motors(wheel_distance) {}
+
+        virtual void move(float speed, float turn) {}
+
+        virtual void start() {}
+
+        virtual void stop() {}
+
+};
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: follow-bench [options ...] FILE\n"
+           "Runs the road and path finders on the frames of FILE, either a\n"
+           "capture file recorded with follow --record or a file of raw\n"
+           "frames as given by CameraWidth, CameraHeight and CameraFormat.\n"
+           "The commands of the pilot are computed as in the line follower\n"
+           "and given to the road finder, without moving any motors. The\n"
+           "allocations counted are the ones of operator new, those of the\n"
+           "cv::Mat data are not.\n"
+           "Options:\n"
+           "  -h, --help                    Show this message and exit.\n"
+           "  -c=CONFIG, --config=CONFIG    Give the configuration file.\n"
+           "  -n=FRAMES, --frames=FRAMES    Number of frames to measure.\n"
+           "  -w=FRAMES, --warmup=FRAMES    Number of frames to run before\n"
+           "                                measuring.\n");
+    exit(0);
+}
+
+// Parse the command line arguments
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"config", required_argument, 0, 'c'},
+        {"frames", required_argument, 0, 'n'},
+        {"warmup", required_argument, 0, 'w'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 'c':
+                config_file = optarg;
+                break;
+            case 'n':
+                nframes = atol(optarg);
+                break;
+            case 'w':
+                nwarmup = atol(optarg);
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+
+    if (!config_file)
+        errx(1, "missing config file");
+    if (optind != argc - 1)
+        errx(1, "missing frames file");
+    frames_file = argv[optind];
+    if (nframes <= 0 || nwarmup < 0)
+        errx(1, "invalid number of frames");
+}
+
+/* Return true if a file is a capture file.
+   Parameters:
+     * file: path of the file.
+*/
+bool
+is_capture_file(const char *file)
+{
+    char magic[CAPTURE_MAGIC_SIZE];
+    ssize_t n;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0)
+        err(1, "cannot open %s", file);
+    n = read(fd, magic, CAPTURE_MAGIC_SIZE);
+    close(fd);
+    return n == CAPTURE_MAGIC_SIZE
+        && !memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+}
+
+/* Print the times of a stage.
+   Parameters:
+     * name: name of the stage.
+     * stats: the recorded times.
+     * stage: the stage to print.
+     * total: total time of the stage, in seconds.
+*/
+void
+print_stage(const char *name, const Stats& stats, stats_stage_t stage,
+    double total)
+{
+    stats_summary_t summary;
+
+    stats.get_summary(stage, summary);
+    printf("%-6s %10.0f ns/frame  p50 %6u us  p99 %6u us  max %6u us\n",
+        name, total * NS_PER_SECOND / nframes, summary.p50, summary.p99,
+        summary.max);
+}
+
+int
+main(int argc, char **argv)
+{
+    map<string, string> defaults;
+    Options options;
+    cam_params_t cam_params;
+    Camera *camera;
+    RoadFinder *road_finder;
+    PathFinder *path_finder;
+    Motors *motors;
+    Pilot *pilot;
+    Road road;
+    vector<glm::vec2> path;
+    Stats stats;
+    struct timespec timestamp, t0, t1, t2;
+    double road_time = 0, path_time = 0;
+    unsigned long allocs = 0;
+
+    parse_args(argc, argv);
+    pipeline::set_default_options(defaults);
+    options = Options(config_file, defaults);
+    pipeline::get_cam_params(options, cam_params);
+    try {
+        // The capture files give the size and format of the frames
+        if (is_capture_file(frames_file)) {
+            ReplayCamera::get_cam_params(frames_file, cam_params);
+            camera = new ReplayCamera(frames_file, REPLAY_FAST);
+        } else {
+            camera = new V4L2Camera(cam_params, frames_file, 0);
+        }
+    } catch (FollowException& e) {
+        errx(1, "cannot open frames: %s", e.what());
+    }
+    road_finder = pipeline::create_road_finder(options, cam_params);
+    path_finder = pipeline::create_path_finder(options);
+    motors = new BenchMotors(options.get_float("WheelDistance"));
+    pilot = new Pilot(motors, options.get_float("MaxSpeed"),
+        options.get_float("Kp"), options.get_float("Ki"),
+        options.get_float("Kd"), options.get_float("PIDPeriod") / 1000.0);
+
+    for (long i = -nwarmup; i < nframes; i++) {
+        camera->fetch();
+        Mat& frame = camera->next();
+        timestamp = camera->get_timestamp();
+        if (!i) {
+            allocs = allocations;
+        }
+        timenow(t0);
+        road_finder->find(frame, timestamp, road);
+        timenow(t1);
+        path_finder->find(road, path);
+        timenow(t2);
+        // The same as the autonomous mode of the line follower, so the road
+        // is tracked with the motion it would have
+        if (path.size() > 2) {
+            glm::vec2 v = glm::normalize(path[2] - path[0]);
+            pilot->set_angle(-v[0], road.get_timestamp());
+        }
+        road_finder->set_motors(pilot->get_speed(), pilot->get_turn());
+        if (i >= 0) {
+            stats.add(STAGE_ROAD, timediff(t0, t1));
+            stats.add(STAGE_PATH, timediff(t1, t2));
+            road_time += timediff(t0, t1);
+            path_time += timediff(t1, t2);
+        }
+    }
+    allocs = allocations - allocs;
+
+    printf("%ld frames of %zux%zu from %s\n", nframes, cam_params.width,
+        cam_params.height, frames_file);
+    print_stage("road", stats, STAGE_ROAD, road_time);
+    print_stage("path", stats, STAGE_PATH, path_time);
+    printf("total  %10.0f ns/frame  %.1f frames/s\n",
+        (road_time + path_time) * NS_PER_SECOND / nframes,
+        nframes / (road_time + path_time));
+    printf("allocs %10.2f per frame (operator new)\n",
+        (double)allocs / nframes);
+
+    delete pilot;
+    delete motors;
+    delete path_finder;
+    delete road_finder;
+    delete camera;
+    return 0;
+}
+
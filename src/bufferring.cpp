@@ -0,0 +1,28 @@
+
+#include "bufferring.hpp"
+
+BufferRing::BufferRing()
+{}
+
+BufferRing::~BufferRing()
+{}
+
+/* Return the size in bytes of a frame.
+   Parameters:
+     * cam_params: camera's parameters (size and pixel format).
+*/
+size_t
+BufferRing::frame_size(const cam_params_t& cam_params)
+{
+    size_t pixels = cam_params.width * cam_params.height;
+
+    switch (cam_params.pixel_format) {
+        case PIXFMT_YUYV:
+            return pixels * 2;
+        case PIXFMT_NV12:
+            return pixels + pixels / 2;
+        default:
+            return pixels * 3;
+    }
+}
+
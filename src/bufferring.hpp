@@ -0,0 +1,55 @@
+/* bufferring.hpp
+   A ring of frame buffers that are filled by some source (a V4L2 device or
+   a file) and lent to the camera without copying them. The camera dequeues
+   a filled buffer, uses it in place and enqueues it again when it doesn't
+   need it anymore.
+*/
+
+#ifndef BUFFERRING_HPP
+#define BUFFERRING_HPP
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "camparams.hpp"
+
+class BufferRing {
+
+    public:
+
+        BufferRing();
+        virtual ~BufferRing();
+
+        // Return the number of buffers of the ring
+        virtual size_t get_size() const = 0;
+
+        /* Return the memory of a buffer.
+           Parameters:
+             * index: index of the buffer.
+        */
+        virtual unsigned char *get_buffer(size_t index) const = 0;
+
+        /* Wait until a buffer is filled and take it out of the ring.
+           Parameters:
+             * timestamp: output capture time of the frame (from the
+                 monotonic clock).
+           Return the index of the buffer.
+        */
+        virtual size_t dequeue(struct timespec& timestamp) = 0;
+
+        /* Give a buffer back to the ring, to be filled again.
+           Parameters:
+             * index: index of the buffer.
+        */
+        virtual void enqueue(size_t index) = 0;
+
+        /* Return the size in bytes of a frame.
+           Parameters:
+             * cam_params: camera's parameters (size and pixel format).
+        */
+        static size_t frame_size(const cam_params_t& cam_params);
+
+};
+
+#endif
+
@@ -2,7 +2,10 @@
 #include "camera.hpp"
 
 Camera::Camera()
-{}
+{
+    timestamp.tv_sec = 0;
+    timestamp.tv_nsec = 0;
+}
 
 Camera::~Camera()
 {}
@@ -14,6 +17,35 @@ Camera::next()
     return front_frame;
 }
 
+/* Lend the buffer of the frame returned by next, so that it stays valid
+   after the next fetch, until it's given back. The cameras that reuse their
+   buffers can't lend them.
+   Return an index of the buffer, or -1 if it can't be lent and the frame
+   must be copied.
+*/
+ssize_t
+Camera::lend()
+{
+    return -1;
+}
+
+/* Give back a buffer lent by lend. It can be called from another thread
+   than the one that fetches the frames.
+   Parameters:
+     * buffer: the index returned by lend.
+*/
+void
+Camera::give_back(ssize_t buffer)
+{}
+
+// Return the capture time of the frame returned by next (from the monotonic
+// clock)
+const struct timespec&
+Camera::get_timestamp() const
+{
+    return timestamp;
+}
+
 // PROTECTED FUNCTIONS
 
 /* Set the buffers that the camera has to use.
@@ -38,3 +70,13 @@ Camera::swap_buffers()
     back_frame = aux;
 }
 
+/* Set the capture time of the front frame.
+   Parameters:
+     * timestamp: the capture time (from the monotonic clock).
+*/
+void
+Camera::set_timestamp(const struct timespec& timestamp)
+{
+    this->timestamp = timestamp;
+}
+
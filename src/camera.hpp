@@ -7,6 +7,9 @@
 #ifndef CAMERA_HPP
 #define CAMERA_HPP
 
+#include <sys/types.h>
+#include <time.h>
+
 #include "opencv2/opencv.hpp"
 
 using namespace cv;
@@ -31,6 +34,25 @@ class Camera {
         // Retrieves the next frame.
         Mat& next();
 
+        /* Lend the buffer of the frame returned by next, so that it stays
+           valid after the next fetch, until it's given back. The cameras
+           that reuse their buffers can't lend them.
+           Return an index of the buffer, or -1 if it can't be lent and the
+           frame must be copied.
+        */
+        virtual ssize_t lend();
+
+        /* Give back a buffer lent by lend. It can be called from another
+           thread than the one that fetches the frames.
+           Parameters:
+             * buffer: the index returned by lend.
+        */
+        virtual void give_back(ssize_t buffer);
+
+        // Return the capture time of the frame returned by next (from the
+        // monotonic clock)
+        const struct timespec& get_timestamp() const;
+
     protected:
 
         /* Set the buffers that the camera has to use.
@@ -43,11 +65,20 @@ class Camera {
         // Swap the front and back buffers
         void swap_buffers();
 
+        /* Set the capture time of the front frame.
+           Parameters:
+             * timestamp: the capture time (from the monotonic clock).
+        */
+        void set_timestamp(const struct timespec& timestamp);
+
     private:
 
         // The back and front frames
         Mat back_frame, front_frame;
 
+        // Capture time of the front frame
+        struct timespec timestamp;
+
 };
 
 #endif
@@ -4,6 +4,16 @@
 
 #include <sys/types.h>
 
+// Layout of the pixels of the camera frames
+typedef enum {
+    // Packed BGR or BGRA pixels (the number of channels is given by the frame)
+    PIXFMT_BGR,
+    // Packed Y0 U Y1 V pixel pairs, as delivered by most USB cameras
+    PIXFMT_YUYV,
+    // A plane of Y followed by a plane of interleaved U V at half resolution
+    PIXFMT_NV12
+} pixel_format_t;
+
 typedef struct {
     // The camera's viewport's size
     size_t width;
@@ -18,6 +28,9 @@ typedef struct {
 
     // Angle of the camera with the horizontal plane (in radians)
     float cam_angle;
+
+    // Layout of the pixels of the frames
+    pixel_format_t pixel_format;
 } cam_params_t;
 
 #endif
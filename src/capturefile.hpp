@@ -0,0 +1,79 @@
+/* capturefile.hpp
+   Layout of the capture files written by the recorder. A capture file has
+   a fixed header, an index with an entry for each frame and the records
+   with the frames, in this order and each part aligned to a page, so any
+   record can be mapped on its own. All the values are in the byte order of
+   the machine that recorded the file.
+*/
+
+#ifndef CAPTUREFILE_HPP
+#define CAPTUREFILE_HPP
+
+#include <stdint.h>
+
+// Magic string at the start of the file and version of the layout
+#define CAPTURE_MAGIC       "FOLLOWCP"
+#define CAPTURE_MAGIC_SIZE  8
+#define CAPTURE_VERSION     1
+
+// Space reserved to the header
+#define CAPTURE_HEADER_SIZE 4096
+
+// Header of the file
+typedef struct {
+    char magic[CAPTURE_MAGIC_SIZE];
+    uint32_t version;
+
+    // Camera size and pixel format (a pixel_format_t)
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixel_format;
+
+    // Rows, columns and OpenCV type of the frames, and size in bytes
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t type;
+    uint32_t frame_size;
+
+    // Distance between the start of two consecutive records
+    uint64_t record_size;
+
+    // Offsets of the index and of the first record
+    uint64_t index_offset;
+    uint64_t data_offset;
+
+    // Number of entries of the index
+    uint64_t max_frames;
+
+    // Number of frames written and dropped. Updated after each record, so
+    // the file is valid even if the recorder didn't finish.
+    uint64_t nframes;
+    uint64_t dropped;
+} capture_header_t;
+
+// Entry of the index
+typedef struct {
+    // Capture time of the frame (from the monotonic clock)
+    int64_t tv_sec;
+    int64_t tv_nsec;
+
+    // Offset of the record
+    uint64_t offset;
+} capture_index_t;
+
+// Header of a record, followed by the frame data
+typedef struct {
+    // Capture time of the frame (from the monotonic clock)
+    int64_t tv_sec;
+    int64_t tv_nsec;
+
+    // Command given to the motors for this frame
+    float speed;
+    float turn;
+
+    // Number of the frame, counting the dropped ones
+    uint64_t seq;
+} capture_record_t;
+
+#endif
+
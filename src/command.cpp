@@ -14,6 +14,7 @@
 #define MAX_DATA_LENGTH 512
 #define MAX_SECTIONS    26
 #define MAX_ROAD_POINTS 8
+#define EVT_STATS_LENGTH    (2 + NUM_STAGES*4*sizeof(uint32_t))
 
 // Transform an element of struct timespec to a double. Converting the struct
 // timespec to a double is useful to substract them and calculate time deltas.
@@ -47,19 +48,22 @@ decf(char *buf) {
 
 const ssize_t Command::msg_lengths[] = {
     0, 1, 1, 1, 1, 1, 1 + 2*sizeof(float), 1,
-    EVT_ECHO_LENGTH, 1, 1, 1, 1, 1 + 2*sizeof(float), 0, 1 + 4*sizeof(float)
+    EVT_ECHO_LENGTH, 1, 1, 1, 1, 1 + 2*sizeof(float), 0, 1 + 4*sizeof(float),
+    1, EVT_STATS_LENGTH
 };
 
 char Command::echo_event[EVT_ECHO_LENGTH];
 
-Command::Command()
+Command::Command():
+    stats(0)
 {}
 
 /* Constructor.
    Parameters:
      * options: application options.
 */
-Command::Command(const Options& options)
+Command::Command(const Options& options):
+    stats(0)
 {
     struct sockaddr_in addr;
     char hostname[HOST_NAME_MAX + 1];
@@ -148,7 +152,7 @@ Command::get_command(msg_t& command)
     }
     // Check that the received command is valid
     cmd = buf[0];
-    if (cmd < CMD_ECHO || cmd > CMD_INFO) {
+    if ((cmd < CMD_ECHO || cmd > CMD_INFO) && cmd != CMD_STATS) {
         warnx("received unknown command %d", cmd);
         return 0;
     }
@@ -172,6 +176,7 @@ Command::get_command(msg_t& command)
             command.turn = decf(buf + 1 + sizeof(float));
             break;
         case CMD_INFO: send_info(addr); break;
+        case CMD_STATS: send_stats(addr); break;
         default: break;
     }
     update_subscriptor_timestamp(addr);
@@ -238,6 +243,16 @@ Command::send_event(const msg_t& event)
     send_event_data(buf, size);
 }
 
+/* Set the statistics to be sent when asked for.
+   Parameters:
+     * stats: the statistics.
+*/
+void
+Command::set_stats(const Stats *stats)
+{
+    this->stats = stats;
+}
+
 // PRIVATE FUNCTIONS
 
 /* Send an echo event.
@@ -325,6 +340,37 @@ Command::send_info(struct sockaddr_in& addr)
     sendto(fd, buf, msg_lengths[EVT_INFO], 0, (sockaddr*)&addr, sizeof(addr));
 }
 
+/* Send the timing statistics to a client.
+   For each stage, the event contains the number of times recorded and the
+   median, the 99th percentile and the maximum (in us).
+   Parameters:
+     * addr: the recipient's address.
+*/
+void
+Command::send_stats(struct sockaddr_in& addr)
+{
+    char buf[EVT_STATS_LENGTH];
+    stats_summary_t summary;
+    char *ptr = buf + 2;
+
+    buf[0] = EVT_STATS;
+    buf[1] = NUM_STAGES;
+    for (size_t i = 0; i < NUM_STAGES; i++) {
+        if (stats) {
+            stats->get_summary((stats_stage_t)i, summary);
+        } else {
+            memset(&summary, 0, sizeof(summary));
+        }
+        *(uint32_t*)ptr = htobe32(summary.count);
+        *(uint32_t*)(ptr + sizeof(uint32_t)) = htobe32(summary.p50);
+        *(uint32_t*)(ptr + 2*sizeof(uint32_t)) = htobe32(summary.p99);
+        *(uint32_t*)(ptr + 3*sizeof(uint32_t)) = htobe32(summary.max);
+        ptr += 4*sizeof(uint32_t);
+    }
+    sendto(fd, buf, msg_lengths[EVT_STATS], 0, (sockaddr*)&addr,
+        sizeof(addr));
+}
+
 /* Add a subscriber.
    Parameters:
      * addr: Internet address of the subscriber.
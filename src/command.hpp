@@ -8,6 +8,7 @@
 
 #include "options.hpp"
 #include "road.hpp"
+#include "stats.hpp"
 
 // Enumeration of message types
 typedef enum {
@@ -26,7 +27,9 @@ typedef enum {
     EVT_STOPPED,
     EVT_MOVED,
     EVT_DATA,
-    EVT_INFO
+    EVT_INFO,
+    CMD_STATS,
+    EVT_STATS
 } msg_type_t;
 
 // Contents of a message
@@ -95,6 +98,12 @@ class Command {
         */
         void send_event(const msg_t& event);
 
+        /* Set the statistics to be sent when asked for.
+           Parameters:
+             * stats: the statistics.
+        */
+        void set_stats(const Stats *stats);
+
     private:
 
         // File descriptor for the UDP socket
@@ -110,6 +119,9 @@ class Command {
         float wheel_diameter;
         float front_wheel_offset;
 
+        // Timing statistics to be sent when asked for
+        const Stats *stats;
+
         // Lengths of the different types of messages
         static const ssize_t msg_lengths[];
 
@@ -151,6 +163,12 @@ class Command {
         */
         void send_info(struct sockaddr_in& addr);
 
+        /* Send the timing statistics to a client.
+           Parameters:
+             * addr: the recipient's address.
+        */
+        void send_stats(struct sockaddr_in& addr);
+
         /* Add a subscriber.
            Parameters:
              * addr: Internet address of the subscriber.
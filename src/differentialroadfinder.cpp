@@ -3,11 +3,9 @@
 #include <math.h>
 
 #include "differentialroadfinder.hpp"
+#include "followexception.hpp"
 #include "utilities.hpp"
 
-// Originally this value was set to 16, but it can be too few depending on the
-// surroundings of the road.
-#define MAX_EDGES           32
 #define MAX_WIDTH_PIXELS    3280
 
 #define DEG_TO_RAD(d)       ((d) * M_PI / 180.0)
@@ -15,13 +13,64 @@
 // TODO: Make it an algorithm parameter
 #define ROAD_DELTA  15.0
 
+// Luma of the white and black references of the YUV frames, that the V4L2
+// and UVC cameras give in limited range (16 to 235), unlike the BGR frames
+// converted by OpenCV
+#define YUV_WHITE_Y             235
+#define YUV_BLACK_Y             16
+#define YUV_LUMA_LEVELS         (YUV_WHITE_Y - YUV_BLACK_Y)
+
+// Minimum fraction of the sections of the previous frame that must be found
+// in the tracked scanlines, or the whole scanlines are scanned again
+#define MIN_TRACKED_SECTIONS    0.5
+
+// Minimum width of a tracked scanline, in pixels
+#define MIN_WINDOW_PIXELS       8
+
+// Minimum change of direction of the road between two scanlines to add a
+// scanline between them
+#define MIN_BEND                DEG_TO_RAD(15.0)
+
 using namespace utilities;
 
 typedef enum {ST_START, ST_LANE1, ST_LINE, ST_LANE2, ST_END} state_t;
 
+/* Interpolate the x coordinate of a polyline at a given y.
+   Parameters:
+     * points: the points of the polyline.
+     * y: the y coordinate.
+     * x: the output x coordinate.
+   Return false if the polyline doesn't reach y.
+*/
+static bool
+interpolate_x(const vector<glm::vec2>& points, float y, float& x)
+{
+    const glm::vec2 *a, *b;
+
+    for (size_t i = 1; i < points.size(); i++) {
+        a = &points[i - 1];
+        b = &points[i];
+        if ((y >= (*a)[1] && y <= (*b)[1]) || (y >= (*b)[1] && y <= (*a)[1]))
+        {
+            if ((*a)[1] == (*b)[1])
+                x = (*a)[0];
+            else
+                x = (*a)[0] + ((*b)[0] - (*a)[0]) * (y - (*a)[1])
+                    / ((*b)[1] - (*a)[1]);
+            return true;
+        }
+    }
+    return false;
+}
+
 /* Constructor.
    Parameters:
      * cam_params: camera's parameters.
+     * calibration: path of the calibration of the camera, to convert the
+           pixels to world coordinates with the lens distortion, or "" to use
+           the field of view.
+     * ground_lut_file: path of the ground lookup table computed from the
+           calibration.
      * scanlines: number of lines of the original image to process.
      * min_derivative: value to use to filter the values in the derivative
            function.
@@ -32,91 +81,162 @@ typedef enum {ST_START, ST_LANE1, ST_LINE, ST_LANE2, ST_END} state_t;
            coordinates.
      * scanline_distance: if using the SL_WORLD frame, distance between
            the scanlines.
+     * scanline_budget: pixels of the scanlines scanned per frame, to add
+           scanlines where the road bends and remove them where it's
+           straight, or 0 to scan always the same scanlines.
      * wheel_distance: distance between wheels (in cm).
+     * edge_kernel: name of the kernel used to find the edges, or "auto" to
+           use the fastest one.
+     * threads: number of threads used to process the scanlines (0 to use one
+           per CPU).
+     * tracking_margin: distance to both sides of the road of the previous
+           frame that is scanned (in cm), or 0 to scan the whole scanlines
+           always.
+     * max_speed: speed of the robot with the motors at max speed (in cm/s),
+           to predict where the road moves.
+   Throws FollowException if no scanline is inside the image.
 */
 DifferentialRoadFinder::DifferentialRoadFinder(const cam_params_t& cam_params,
+        const string& calibration, const string& ground_lut_file,
         size_t scanlines, int min_derivative, int color_distance_threshold,
         scanline_frame_t scanline_frame, float scanline_distance,
-        float wheel_distance):
+        size_t scanline_budget, float wheel_distance,
+        const string& edge_kernel, size_t threads,
+        float tracking_margin, float max_speed):
     cam_params(cam_params), scanlines(scanlines),
     min_derivative(min_derivative),
     color_distance_threshold(color_distance_threshold), scanline_params(0),
-    wheel_distance(wheel_distance)
+    ground_lut(0), scanline_budget(scanline_budget),
+    wheel_distance(wheel_distance), edge_kernel(edgekernel::get(edge_kernel)),
+    current_frame(0), tracking_margin(tracking_margin), max_speed(max_speed),
+    prev_scanlines(0), motors_speed(0.0), motors_turn(0.0)
 {
+    if (!calibration.empty())
+        ground_lut = new GroundLut(ground_lut_file, calibration, cam_params);
     init_scanline_params(scanline_frame, scanline_distance);
+    // With SL_WORLD, the first scanline can already be out of the image
+    if (!this->scanlines) {
+        delete[] scanline_params;
+        delete ground_lut;
+        throw FollowException("no scanlines inside the image");
+    }
+    if (scanline_budget) {
+        init_adaptive_scanlines();
+        active_scanlines = base_scanlines;
+    } else {
+        for (size_t i = 0; i < this->scanlines; i++) {
+            active_scanlines.push_back(i);
+        }
+    }
+    // The colors of the YUV frames are classified without converting them
+    if (cam_params.pixel_format == PIXFMT_BGR) {
+        color_distance = colordistance;
+        white_color = Scalar(255, 255, 255);
+        black_color = Scalar(0, 0, 0);
+    } else {
+        color_distance = yuvdistance;
+        white_color = Scalar(YUV_WHITE_Y, 128, 128);
+        black_color = Scalar(YUV_BLACK_Y, 128, 128);
+        // The threshold is given for the BGR distances, scale it to the
+        // narrower luma range
+        this->color_distance_threshold = color_distance_threshold
+            * YUV_LUMA_LEVELS * YUV_LUMA_LEVELS / (255 * 255);
+    }
+    features = new scanline_features_t[this->scanlines];
+    windows = new scanline_window_t[this->scanlines];
+    set_full_windows();
+    prev_timestamp.tv_sec = prev_timestamp.tv_nsec = 0;
+    workers = new WorkerPool(threads);
 }
 
 DifferentialRoadFinder::~DifferentialRoadFinder()
 {
+    delete workers;
+    delete[] windows;
+    delete[] features;
     if (scanline_params)
         delete[] scanline_params;
+    if (ground_lut)
+        delete ground_lut;
 }
 
 /* Find the road in the image.
    Parameters:
      * frame: image of the road.
+     * timestamp: capture time of the frame, kept in the road.
      * road: output parameter that contains the road found.
 */
 void
-DifferentialRoadFinder::find(Mat& frame, Road& road)
+DifferentialRoadFinder::find(Mat& frame, const struct timespec& timestamp,
+    Road& road)
 {
-    // NOTE: Add 2 to the edges array in order to account for the start and the
-    //       end of the array.
-    int edges[MAX_EDGES + 2];
-    // NOTE: Add 1 to the color_segments array in order to add a sentinel.
-    color_segment_t color_segments[MAX_EDGES + 2];
-    size_t nedges;
-    road_section_t section, prev_section = {{-1, -1}, {-1, -1}, {-1, -1}};
-    uchar *gray_ptr, *color_ptr;
-    bool goal_set = false;
+    bool goal_set, tracked;
+    glm::vec2 goal;
     road_section_t last_section;
 
     // Empty the road
     road.clear();
+    road.set_timestamp(timestamp);
     sections.clear();
 
-    // 1) Convert the frame to gray color
-    cvtColor(frame, gray_frame, COLOR_BGR2GRAY);
-
-    // 2) Analize each row of the input frame.
-    //    NOTE: The images are scanned top to bottom.
-    for (size_t i = 0; i < scanlines; i++) {
-        gray_ptr = gray_frame.data + scanline_params[i].offset;
-        color_ptr = frame.data + scanline_params[i].offset * frame.elemSize();
-
-        // 2.1) Obtain the edges between similar colors
-        nedges = find_edges(gray_ptr, gray_frame.cols, edges);
+    // 1) Extract the edges and color segments of each scanline. The
+    //    scanlines are independent, so this is done in parallel. When the
+    //    road is tracked, only the part of the scanlines around the road
+    //    predicted from the previous frame is scanned, and with a scanline
+    //    budget, the scanlines are selected where the road bended.
+    tracked = predict_windows(timestamp);
+    select_scanlines();
+    current_frame = &frame;
+    workers->run(extract_features_task, this);
+
+    // 2) Obtain the road limits of each scanline
+    goal_set = find_sections(goal);
+
+    // 2.1) If the tracked road was lost, scan the whole scanlines again.
+    //     They are selected again, as they cost more than the windows
+    //     they were selected with.
+    if (tracked && sections.size() * prev_scanlines
+        < MIN_TRACKED_SECTIONS * prev_sections.size()
+        * active_scanlines.size())
+    {
+        sections.clear();
+        set_full_windows();
+        select_scanlines();
+        workers->run(extract_features_task, this);
+        goal_set = find_sections(goal);
+    }
 
-        // 2.2) Obtain the color segments of the scanline
-        find_color_segments(
-            color_ptr, frame.elemSize(), edges, nedges, color_segments);
+    // 3) Reduce the road according to the dimensions of the robot
+    add_secure_dist(road);
 
-        // 2.3) Obtain the road limits of the scanline
-        if (find_road_section(color_segments, nedges, i, prev_section,
-            section))
-        {
-            sections.push_back(section);
-            // 2.4) Update the goal
-            if (section.line[0] != FLT_MAX) {
-                road.set_goal(section.line);
-                goal_set = true;
-            }
-            // Update the previous section
-            prev_section = section;
-        }
-        // Draw the scanline
-        /*line(frame, Point(0, scanline_params[i].offset/frame.cols),
-            Point(frame.cols, scanline_params[i].offset/frame.cols),
-            Scalar(0, 0, 255));*/
-    }
-    // 3) If the goal was not set, set it to the middle of the last section
-    if (!goal_set && road.get_size()) {
-        last_section = road.get_section(road.get_size());
+    // 4) Set the goal to the last line found, or if there's no line, to the
+    //    middle of the last section
+    if (goal_set) {
+        road.set_goal(goal);
+    } else if (road.get_size()) {
+        last_section = road.get_section(road.get_size() - 1);
         road.set_goal((last_section.left + last_section.right)*0.5f);
     }
 
-    // 4) Reduce the road according to the dimensions of the robot
-    add_secure_dist(road);
+    // Keep the road to track it in the next frame
+    if (tracking_margin > 0.0 || scanline_budget) {
+        prev_sections = sections;
+        prev_scanlines = active_scanlines.size();
+        prev_timestamp = timestamp;
+    }
+}
+
+/* Give the command sent to the motors after the last road was found, that
+   moves the road in the next frame.
+   Parameters:
+     * speed: mean speed (0.0 is no movement and 1.0 is max speed).
+     * turn: difference of speed between the two wheels.
+*/
+void
+DifferentialRoadFinder::set_motors(float speed, float turn)
+{
+    motors_speed = speed;
+    motors_turn = turn;
 }
 
 // PRIVATE FUNCTIONS
@@ -161,21 +281,93 @@ DifferentialRoadFinder::add_secure_dist(Road& road)
     }
 }
 
+/* Extract the features of a subset of the scanlines of the current frame.
+   Each worker processes one of every nworkers scanlines.
+   Parameters:
+     * worker: index of the worker.
+     * nworkers: total number of workers.
+*/
+void
+DifferentialRoadFinder::extract_features(size_t worker, size_t nworkers)
+{
+    Mat& frame = *current_frame;
+    // Gray version of the current scanline
+    uchar gray_row[MAX_WIDTH_PIXELS];
+    uchar *color_ptr, *chroma_ptr = 0, *gray_ptr;
+    size_t i, row, start, len;
+    scanline_features_t *f;
+
+    // NOTE: Only the scanlines are converted to gray, not the whole frame.
+    //       The Y values of the YUV frames are used as they are.
+    for (size_t k = worker; k < active_scanlines.size(); k += nworkers) {
+        i = active_scanlines[k];
+        f = &features[i];
+        color_ptr = frame.data + scanline_params[i].offset * frame.elemSize();
+        start = windows[i].start;
+        len = windows[i].end - windows[i].start;
+
+        // 1) Convert the scanned part of the scanline to gray color, in
+        //    the same position of gray_row
+        switch (cam_params.pixel_format) {
+            case PIXFMT_YUYV:
+                lumarowyuyv(color_ptr + start * 2, len, gray_row + start);
+                gray_ptr = gray_row;
+                break;
+            case PIXFMT_NV12:
+                // The UV plane starts after the Y plane, with a row for
+                // every two rows of Y
+                row = scanline_params[i].offset / frame.cols;
+                chroma_ptr = frame.data + cam_params.height * frame.cols
+                    + (row / 2) * frame.cols;
+                gray_ptr = color_ptr;
+                break;
+            default:
+                grayrow(color_ptr + start * frame.elemSize(), len,
+                    frame.elemSize(), gray_row + start);
+                gray_ptr = gray_row;
+                break;
+        }
+
+        // 2) Obtain the edges between similar colors
+        f->nedges = find_edges(gray_ptr, start, len, f->edges);
+
+        // 3) Obtain the color segments of the scanline
+        find_color_segments(color_ptr, chroma_ptr, frame.elemSize(), f->edges,
+            f->nedges, f->color_segments);
+    }
+}
+
+/* Worker task that calls extract_features.
+   Parameters:
+     * instance: the DifferentialRoadFinder instance.
+     * worker: index of the worker.
+     * nworkers: total number of workers.
+*/
+void
+DifferentialRoadFinder::extract_features_task(
+    void *instance, size_t worker, size_t nworkers)
+{
+    ((DifferentialRoadFinder *)instance)->extract_features(worker, nworkers);
+}
+
 /* Convert the line of pixels in a sequence of color segments.
    Parameters:
-     * row: pointer to the row in the image that contains the colored pixels.
+     * row: pointer to the row in the image that contains the colored pixels
+            (the Y plane for NV12).
+     * chroma: for NV12, pointer to the row of the UV plane that corresponds
+            to row.
      * channels: number of color channels in the source image.
      * edges: the positions of the segments edges.
      * nedges: the number of edges in the edges array.
      * color_segments: the colors of each segment.
 */
 void
-DifferentialRoadFinder::find_color_segments(uchar *row, size_t channels,
-    int edges[], size_t nedges, color_segment_t color_segments[])
+DifferentialRoadFinder::find_color_segments(uchar *row, uchar *chroma,
+    size_t channels, int edges[], size_t nedges,
+    color_segment_t color_segments[])
 {
     size_t seglen;
     Scalar mean_color;
-    uchar *ptr = row;
     size_t i;
 
     for (i = 0; i < nedges - 1; i++) {
@@ -183,20 +375,30 @@ DifferentialRoadFinder::find_color_segments(uchar *row, size_t channels,
         color_segments[i].start = edges[i];
         color_segments[i].length = seglen;
         // Compute the mean color of the current segment
-        meancolor(ptr, seglen, channels, mean_color);
+        switch (cam_params.pixel_format) {
+            case PIXFMT_YUYV:
+                meancoloryuyv(row, edges[i], seglen, mean_color);
+                break;
+            case PIXFMT_NV12:
+                meancolornv12(row, chroma, edges[i], seglen, mean_color);
+                break;
+            default:
+                meancolor(row + edges[i] * channels, seglen, channels,
+                    mean_color);
+                break;
+        }
         // Classify the mean color in white, black or other
-        if (colordistance(mean_color, Scalar(255, 255, 255))
+        if (color_distance(mean_color, white_color)
             < color_distance_threshold)
         {
             color_segments[i].color = COLOR_WHITE;
-        } else if (colordistance(mean_color, Scalar(0, 0, 0))
+        } else if (color_distance(mean_color, black_color)
             < color_distance_threshold)
         {
             color_segments[i].color = COLOR_BLACK;
         } else {
             color_segments[i].color = COLOR_OTHER;
         }
-        ptr += seglen * channels;
     }
     // Add a sentinel
     color_segments[i].start = color_segments[i - 1].start
@@ -209,29 +411,30 @@ DifferentialRoadFinder::find_color_segments(uchar *row, size_t channels,
 /* Find the road limits.
    Parameters:
      * row: pointer to the row in the image to analize.
-     * len: number of pixels in row.
-     * edges: contains the found edges positions.
+     * start: first pixel of row to analize.
+     * len: number of pixels to analize.
+     * edges: contains the found edges positions (in the row).
    Return the number of edges found.
 */
 size_t
-DifferentialRoadFinder::find_edges(uchar *row, size_t len, int edges[])
+DifferentialRoadFinder::find_edges(uchar *row, size_t start, size_t len,
+    int edges[])
 {
     size_t nedges;
-    int aux_row[MAX_WIDTH_PIXELS];
-
-    // 1) Compute the derivative of the row
-    derivative(row, len, aux_row);
-    // 2) Compute the absolute value of the derivative
-    abs(aux_row, len, aux_row);
-    // 3) Filter out (set to zero) the low values of the derivative
-    filterlt(aux_row, len, min_derivative, aux_row);
-    // 4) Search the local maximums (to stablish a point of max derivative)
+
+    // 1) Search the local maximums of the derivative of the row that are
+    //    not lower than min_derivative (to stablish a point of max
+    //    derivative). The kernel does it in a single pass over the row.
     //    NOTE: leave position 0 for the start of the array.
-    nedges = localmax(aux_row, len, MAX_EDGES, edges + 1);
-    // 5) Add the start and end positions of the row (for convenience to the
+    nedges = edge_kernel(row + start, len, min_derivative, MAX_EDGES,
+        edges + 1);
+    for (size_t i = 1; i <= nedges; i++) {
+        edges[i] += start;
+    }
+    // 2) Add the start and end positions of the row (for convenience to the
     //    next algorithms to apply).
-    edges[0] = 0;
-    edges[nedges + 1] = len;
+    edges[0] = start;
+    edges[nedges + 1] = start + len;
     nedges += 2;
     return nedges;
 }
@@ -343,6 +546,104 @@ DifferentialRoadFinder::find_road_section(color_segment_t color_segments[],
     return false;
 }
 
+/* Return the change of direction of the road of the previous frame between
+   two distances (in radians). The signed bends are added, so the errors of
+   the road cancel out.
+   Parameters:
+     * y0: the nearest distance.
+     * y1: the farthest distance.
+*/
+float
+DifferentialRoadFinder::get_bend(float y0, float y1) const
+{
+    float angle = 0.0;
+
+    for (size_t i = 0; i < bends.size(); i++) {
+        if (bends[i].y >= y0 && bends[i].y < y1)
+            angle += bends[i].angle;
+    }
+    return fabsf(angle);
+}
+
+/* Return the constant to multiply the X component in camera coordinates to
+   obtain the X in world coordinates.
+   Parameters:
+     * y: y world coordinate of the scanline.
+*/
+float
+DifferentialRoadFinder::get_kx(float y) const
+{
+    float dc;
+
+    // The expression to compute the distance camera-projection plane (dc) is
+    // derived from the formula to compute the distance between a plane and
+    // a point.
+    // https://mathinsight.org/distance_point_plane
+    dc = fabsf(sin(-cam_params.cam_angle)*cam_params.cam_z
+        + cos(-cam_params.cam_angle)*y);
+    return tan(DEG_TO_RAD(cam_params.fovh/2.0)) * dc / (cam_params.width/2.0);
+}
+
+/* Convert a world x coordinate to screen.
+   Parameters:
+     * x: world x coordinate.
+     * index: index of the current scanline.
+*/
+float
+DifferentialRoadFinder::get_screen_x(float x, size_t index) const
+{
+    const ground_point_t *ground = scanline_params[index].ground;
+    size_t low = 0, high = cam_params.width, mid;
+
+    if (!ground)
+        return x / scanline_params[index].kx + cam_params.width/2;
+    // The x of the ground points increase along the row
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (ground[mid].x < x)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+/* Find the sections of the road in the features of the scanlines. Each
+   section depends on the previous one, so this is done sequentially.
+   Parameters:
+     * goal: output goal, the line of the farthest section that has one.
+   Return true if the goal was found.
+*/
+bool
+DifferentialRoadFinder::find_sections(glm::vec2& goal)
+{
+    road_section_t section, prev_section = {{-1, -1}, {-1, -1}, {-1, -1}};
+    bool goal_set = false;
+    size_t i;
+
+    // NOTE: The images are scanned top to bottom.
+    for (size_t k = 0; k < active_scanlines.size(); k++) {
+        i = active_scanlines[k];
+        if (find_road_section(features[i].color_segments,
+            features[i].nedges, i, prev_section, section))
+        {
+            sections.push_back(section);
+            // Update the goal
+            if (section.line[0] != FLT_MAX) {
+                goal = section.line;
+                goal_set = true;
+            }
+            // Update the previous section
+            prev_section = section;
+        }
+        // Draw the scanline
+        /*line(frame, Point(0, scanline_params[i].offset/frame.cols),
+            Point(frame.cols, scanline_params[i].offset/frame.cols),
+            Scalar(0, 0, 255));*/
+    }
+    return goal_set;
+}
+
 /* If start and end corresponds to a road section, generate it.
    Parameters:
      * start: start position of the new road section.
@@ -407,7 +708,14 @@ DifferentialRoadFinder::init_scanline_params(scanline_frame_t scanline_frame,
     float kv = tan(DEG_TO_RAD(cam_params.fovv/2.0)) / (cam_params.height/2.0);
     float ymin = cam_params.cam_z
         / tan(-cam_params.cam_angle + DEG_TO_RAD(cam_params.fovv/2.0));
-    float tan_phi, dc;
+    float tan_phi, y;
+
+    // With a calibrated camera, the nearest distance is the one of the
+    // center of the last row
+    if (ground_lut) {
+        ymin = ground_lut->get_row(cam_params.height - 1)
+            [cam_params.width/2].y;
+    }
 
     // Allocate the scanline params array
     scanline_params = new scanline_params_t[scanlines];
@@ -415,43 +723,274 @@ DifferentialRoadFinder::init_scanline_params(scanline_frame_t scanline_frame,
     for (size_t i = 0; i < scanlines; i++) {
         // Mode equidistant scanlines in screen coordinates
         if (scanline_frame == SL_SCREEN) {
-            // Compute the byte offset of the scanline
-            scanline_params[i].offset = row_offset * cam_params.width;
-
-            // Compute the y world coordinate corresponding to each scanline
-            tan_phi = kv * ((int)(cam_params.height/2) - row_offset);
-            scanline_params[i].y = cam_params.cam_z
-                * (1 + tan_cam_angle*tan_phi) / (tan_cam_angle - tan_phi);
+            set_row_params(row_offset, scanline_params[i]);
             row_offset -= cam_params.height/scanlines;
         // Mode equidistant scanlines in world coordinates
         } else {
             // Compute the y world coordinate corresponding to each scanline
-            scanline_params[i].y = ymin + scanline_distance * i;
-
-            // Compute the byte offset of the scanline
-            tan_phi = (tan_cam_angle*scanline_params[i].y - cam_params.cam_z)
-                / (cam_params.cam_z*tan_cam_angle + scanline_params[i].y);
-            row_offset = (int)(cam_params.height/2) - tan_phi / kv - 1;
-            scanline_params[i].offset = row_offset * cam_params.width;
+            y = ymin + scanline_distance * i;
+
+            // Compute the row of the scanline
+            if (ground_lut) {
+                row_offset = ground_lut->find_row(y);
+            } else {
+                tan_phi = (tan_cam_angle*y - cam_params.cam_z)
+                    / (cam_params.cam_z*tan_cam_angle + y);
+                row_offset = (int)(cam_params.height/2) - tan_phi / kv - 1;
+            }
 
-            // Stop if two scanlies are superposed
-            if (i > 0
-                && scanline_params[i].offset == scanline_params[i - 1].offset)
+            // Stop if two scanlies are superposed or out of the image
+            if (row_offset < 0 || (i > 0 && (size_t)row_offset
+                * cam_params.width == scanline_params[i - 1].offset))
             {
                 scanlines = i;
                 break;
             }
+            if (ground_lut) {
+                // The distance of the row, that is not exactly y
+                set_row_params(row_offset, scanline_params[i]);
+            } else {
+                scanline_params[i].offset = row_offset * cam_params.width;
+                scanline_params[i].y = y;
+                scanline_params[i].kx = get_kx(y);
+                scanline_params[i].ground = 0;
+            }
         }
+    }
+}
+
+/* Make every row between the first and the last configured scanlines a
+   scanline that can be scanned, for the scanline budget.
+*/
+void
+DifferentialRoadFinder::init_adaptive_scanlines()
+{
+    int first_row = scanline_params[0].offset / cam_params.width;
+    int last_row = scanline_params[scanlines - 1].offset / cam_params.width;
 
-        // Compute the constant to obtain the x world coordinates. The
-        // expression to compute the distance camera-projection plane (dc) is
-        // derived from the formula to compute the distance between a plane and
-        // a point.
-        // https://mathinsight.org/distance_point_plane
-        dc = fabsf(sin(-cam_params.cam_angle)*cam_params.cam_z
-            + cos(-cam_params.cam_angle)*scanline_params[i].y);
-        scanline_params[i].kx = tan(DEG_TO_RAD(cam_params.fovh/2.0)) * dc
-            / (cam_params.width/2.0);
+    // The configured scanlines are kept as the base ones
+    base_scanlines.resize(scanlines);
+    for (size_t i = 0; i < scanlines; i++) {
+        base_scanlines[i] = first_row
+            - scanline_params[i].offset / cam_params.width;
+    }
+    delete[] scanline_params;
+    scanlines = first_row - last_row + 1;
+    scanline_params = new scanline_params_t[scanlines];
+    for (size_t i = 0; i < scanlines; i++) {
+        set_row_params(first_row - i, scanline_params[i]);
     }
 }
 
+/* Predict the part of each scanline where the road is, from the road of the
+   previous frame and the motion of the robot since then. The robot is moved
+   as the virtual motors do, along an arc with the speed of the motors.
+   Parameters:
+     * timestamp: capture time of the current frame.
+   Return false if the road can't be tracked, and then the whole scanlines
+   are scanned.
+*/
+bool
+DifferentialRoadFinder::predict_windows(const struct timespec& timestamp)
+{
+    float s1, s2, dt, dist, angle, c, s, left, right, start, end;
+    int width = cam_params.width;
+    glm::vec2 t;
+
+    if (tracking_margin <= 0.0 || prev_sections.size() < 2) {
+        set_full_windows();
+        return false;
+    }
+
+    // Distance and angle moved since the previous frame
+    s1 = motors_speed - motors_turn;
+    s2 = motors_speed + motors_turn;
+    if (s1 > 1.0 || s2 > 1.0) {
+        c = s1 > s2 ? s1 : s2;
+        s1 /= c;
+        s2 /= c;
+    }
+    dt = timediff(prev_timestamp, timestamp);
+    dist = (s1 + s2) / 2.0 * max_speed * dt;
+    angle = (s2 - s1) * max_speed * dt / wheel_distance;
+
+    // Move the road the other way, the translation is the chord of the arc
+    c = cos(angle);
+    s = sin(angle);
+    t = glm::vec2(-sin(angle / 2.0), cos(angle / 2.0)) * dist;
+    predicted_left.resize(prev_sections.size());
+    predicted_right.resize(prev_sections.size());
+    for (size_t i = 0; i < prev_sections.size(); i++) {
+        glm::vec2 l = prev_sections[i].left - t;
+        glm::vec2 r = prev_sections[i].right - t;
+        predicted_left[i] = glm::vec2(l[0]*c + l[1]*s, -l[0]*s + l[1]*c);
+        predicted_right[i] = glm::vec2(r[0]*c + r[1]*s, -r[0]*s + r[1]*c);
+    }
+
+    // Scan the margin around the predicted road, or the whole scanline where
+    // there's no prediction
+    for (size_t i = 0; i < scanlines; i++) {
+        windows[i].start = 0;
+        windows[i].end = width;
+        if (!interpolate_x(predicted_left, scanline_params[i].y, left)
+            || !interpolate_x(predicted_right, scanline_params[i].y, right))
+        {
+            continue;
+        }
+        start = get_screen_x(left - tracking_margin, i);
+        end = get_screen_x(right + tracking_margin, i);
+        start = start < 0.0 ? 0.0 : floorf(start);
+        end = end > width ? width : ceilf(end);
+        if (end - start < MIN_WINDOW_PIXELS)
+            continue;
+        windows[i].start = start;
+        windows[i].end = end;
+        // The pixels of the YUYV frames are in pairs
+        if (cam_params.pixel_format == PIXFMT_YUYV) {
+            windows[i].start &= ~1;
+            windows[i].end = (windows[i].end + 1) & ~1;
+        }
+    }
+    return true;
+}
+
+/* Select the scanlines scanned in the current frame within the scanline
+   budget. It starts with one of every two configured scanlines, thinned
+   down to the nearest and the farthest if they don't fit in the budget, and
+   then the intervals between scanlines where the road of the previous frame
+   bends are split, the most bent and longest first.
+*/
+void
+DifferentialRoadFinder::select_scanlines()
+{
+    glm::vec2 c0, c1, c2;
+    road_bend_t bend;
+    size_t used = 0, cost, best, a, b, m;
+    float angle, priority, best_priority;
+
+    if (!scanline_budget)
+        return;
+    // Without a previous road, scan the configured scanlines
+    if (prev_sections.size() < 3) {
+        active_scanlines = base_scanlines;
+        return;
+    }
+
+    // 1) Find the bends of the previous road, from the directions of its
+    //    center before and after each section
+    bends.clear();
+    for (size_t i = 1; i + 1 < prev_sections.size(); i++) {
+        c0 = (prev_sections[i - 1].left + prev_sections[i - 1].right) * 0.5f;
+        c1 = (prev_sections[i].left + prev_sections[i].right) * 0.5f;
+        c2 = (prev_sections[i + 1].left + prev_sections[i + 1].right) * 0.5f;
+        angle = atan2(c1[0] - c0[0], c1[1] - c0[1])
+            - atan2(c2[0] - c1[0], c2[1] - c1[1]);
+        if (angle > M_PI)
+            angle -= 2 * M_PI;
+        else if (angle < -M_PI)
+            angle += 2 * M_PI;
+        bend.y = c1[1];
+        bend.angle = angle;
+        bends.push_back(bend);
+    }
+
+    // 2) Start with the nearest, the farthest and one of every two of the
+    //    configured scanlines
+    active_scanlines.clear();
+    for (size_t i = 0; i < base_scanlines.size(); i += 2) {
+        active_scanlines.push_back(base_scanlines[i]);
+    }
+    if (base_scanlines.size() % 2 == 0)
+        active_scanlines.push_back(base_scanlines.back());
+    for (size_t i = 0; i < active_scanlines.size(); i++) {
+        used += windows[active_scanlines[i]].end
+            - windows[active_scanlines[i]].start;
+    }
+    // Drop the interior scanline with the closest neighbours until they fit
+    // in the budget, keeping the nearest and the farthest
+    while (used > scanline_budget && active_scanlines.size() > 2) {
+        best = 1;
+        for (size_t i = 2; i + 1 < active_scanlines.size(); i++) {
+            if (active_scanlines[i + 1] - active_scanlines[i - 1]
+                < active_scanlines[best + 1] - active_scanlines[best - 1])
+            {
+                best = i;
+            }
+        }
+        m = active_scanlines[best];
+        used -= windows[m].end - windows[m].start;
+        active_scanlines.erase(active_scanlines.begin() + best);
+    }
+
+    // 3) Add a scanline in the middle of the interval with the highest bend
+    //    per distance, while the budget allows it
+    while (true) {
+        best = 0;
+        best_priority = 0.0;
+        for (size_t i = 1; i < active_scanlines.size(); i++) {
+            a = active_scanlines[i - 1];
+            b = active_scanlines[i];
+            if (b - a < 2)
+                continue;
+            angle = get_bend(scanline_params[a].y, scanline_params[b].y);
+            if (angle < MIN_BEND)
+                continue;
+            priority = angle * (scanline_params[b].y - scanline_params[a].y);
+            if (priority > best_priority) {
+                best_priority = priority;
+                best = i;
+            }
+        }
+        if (!best)
+            break;
+        m = (active_scanlines[best - 1] + active_scanlines[best]) / 2;
+        cost = windows[m].end - windows[m].start;
+        if (used + cost > scanline_budget)
+            break;
+        active_scanlines.insert(active_scanlines.begin() + best, m);
+        used += cost;
+    }
+}
+
+// Scan the whole scanlines
+void
+DifferentialRoadFinder::set_full_windows()
+{
+    for (size_t i = 0; i < scanlines; i++) {
+        windows[i].start = 0;
+        windows[i].end = cam_params.width;
+    }
+}
+
+/* Set the parameters of the scanline at a row of the image.
+   Parameters:
+     * row: the row of the image.
+     * params: output parameters of the scanline.
+*/
+void
+DifferentialRoadFinder::set_row_params(int row, scanline_params_t& params)
+{
+    float tan_cam_angle = tan(-cam_params.cam_angle);
+    float kv = tan(DEG_TO_RAD(cam_params.fovv/2.0)) / (cam_params.height/2.0);
+    float tan_phi;
+
+    // Compute the byte offset of the scanline
+    params.offset = row * cam_params.width;
+
+    // With a calibrated camera, the y world coordinate is the one of the
+    // center of the row, and kx the mean one
+    if (ground_lut) {
+        params.ground = ground_lut->get_row(row);
+        params.y = params.ground[cam_params.width/2].y;
+        params.kx = (params.ground[cam_params.width].x - params.ground[0].x)
+            / cam_params.width;
+        return;
+    }
+    params.ground = 0;
+
+    // Compute the y world coordinate corresponding to the scanline
+    tan_phi = kv * ((int)(cam_params.height/2) - row);
+    params.y = cam_params.cam_z
+        * (1 + tan_cam_angle*tan_phi) / (tan_cam_angle - tan_phi);
+    params.kx = get_kx(params.y);
+}
@@ -3,7 +3,14 @@
 #define DIFFERENTIALROADFINDER_HPP
 
 #include "camparams.hpp"
+#include "edgekernel.hpp"
+#include "groundlut.hpp"
 #include "roadfinder.hpp"
+#include "workerpool.hpp"
+
+// Originally this value was set to 16, but it can be too few depending on the
+// surroundings of the road.
+#define MAX_EDGES           32
 
 // Enumeration for the segment's colors
 typedef enum {COLOR_WHITE, COLOR_BLACK, COLOR_OTHER} color_t;
@@ -19,6 +26,10 @@ typedef struct scanline_params {
     // Constant to multiply the X component in camera coordinates to obtain
     // the X in world coordinates
     float kx;
+
+    // With a calibrated camera, ground points of the pixels of the
+    // scanline, used instead of kx (0 otherwise)
+    const ground_point_t *ground;
 } scanline_params_t;
 
 // Data type that represents a color segment
@@ -33,6 +44,32 @@ typedef struct {
     color_t color;
 } color_segment_t;
 
+// Features extracted from a scanline, before looking for the road section
+typedef struct {
+    // Number of edges (including the start and the end of the row)
+    size_t nedges;
+
+    // NOTE: Add 2 to the edges array in order to account for the start and
+    //       the end of the array.
+    int edges[MAX_EDGES + 2];
+
+    // NOTE: Add 1 to the color_segments array in order to add a sentinel.
+    color_segment_t color_segments[MAX_EDGES + 2];
+} scanline_features_t;
+
+// Part of a scanline that is scanned, in pixels from start to end - 1
+typedef struct {
+    int start;
+    int end;
+} scanline_window_t;
+
+// Change of direction of the road center at a distance (angle in radians,
+// positive to the left)
+typedef struct {
+    float y;
+    float angle;
+} road_bend_t;
+
 // Frame of reference for the scanlines mutual distance
 typedef enum {SL_SCREEN, SL_WORLD} scanline_frame_t;
 
@@ -43,6 +80,11 @@ class DifferentialRoadFinder: public RoadFinder {
         /* Constructor.
            Parameters:
              * cam_params: camera's parameters.
+             * calibration: path of the calibration of the camera, to
+                   convert the pixels to world coordinates with the lens
+                   distortion, or "" to use the field of view.
+             * ground_lut_file: path of the ground lookup table computed
+                   from the calibration.
              * scanlines: number of lines of the original image to process.
              * min_derivative: value to use to filter the values in the
                    derivative function.
@@ -53,21 +95,48 @@ class DifferentialRoadFinder: public RoadFinder {
                    equidistant in world coordinates.
              * scanline_distance: if using the SL_WORLD frame, distance between
                    the scanlines.
+             * scanline_budget: pixels of the scanlines scanned per frame,
+                   to add scanlines where the road bends and remove them
+                   where it's straight, or 0 to scan always the same
+                   scanlines.
              * wheel_distance: distance between wheels (in cm).
+             * edge_kernel: name of the kernel used to find the edges, or
+                   "auto" to use the fastest one.
+             * threads: number of threads used to process the scanlines (0
+                   to use one per CPU).
+             * tracking_margin: distance to both sides of the road of the
+                   previous frame that is scanned (in cm), or 0 to scan the
+                   whole scanlines always.
+             * max_speed: speed of the robot with the motors at max speed
+                   (in cm/s), to predict where the road moves.
+           Throws FollowException if no scanline is inside the image.
         */
         DifferentialRoadFinder(const cam_params_t& cam_params,
+            const string& calibration, const string& ground_lut_file,
             size_t scanlines, int min_derivative, int color_distance_threshold,
             scanline_frame_t scanline_frame, float scanline_distance,
-            float wheel_distance);
+            size_t scanline_budget, float wheel_distance,
+            const string& edge_kernel, size_t threads,
+            float tracking_margin, float max_speed);
 
         ~DifferentialRoadFinder();
 
         /* Find the road in the image.
            Parameters:
              * frame: image of the road.
+             * timestamp: capture time of the frame, kept in the road.
              * road: output parameter that contains the road found.
         */
-        virtual void find(Mat& frame, Road& road);
+        virtual void find(Mat& frame, const struct timespec& timestamp,
+            Road& road);
+
+        /* Give the command sent to the motors after the last road was
+           found, that moves the road in the next frame.
+           Parameters:
+             * speed: mean speed (0.0 is no movement and 1.0 is max speed).
+             * turn: difference of speed between the two wheels.
+        */
+        virtual void set_motors(float speed, float turn);
 
     private:
 
@@ -83,18 +152,70 @@ class DifferentialRoadFinder: public RoadFinder {
         // Threshold to identify white and black colors
         unsigned int color_distance_threshold;
 
-        // Destination images form some transformations
-        Mat gray_frame;
+        // Distance between colors, and the white and black references, in
+        // the color space of the frames (BGR or YUV)
+        unsigned int (*color_distance)(const Scalar& a, const Scalar& b);
+        Scalar white_color;
+        Scalar black_color;
 
         // Parameters related with each scanline
         scanline_params_t *scanline_params;
 
+        // Ground lookup table of the calibrated camera (0 if not calibrated)
+        GroundLut *ground_lut;
+
+        // Pixels of the scanlines scanned per frame, or 0 to scan always the
+        // same scanlines
+        size_t scanline_budget;
+
+        // Configured scanlines and scanlines scanned in the current frame,
+        // as indexes of scanline_params in increasing distance
+        vector<size_t> base_scanlines;
+        vector<size_t> active_scanlines;
+
+        // Bends of the road of the previous frame
+        vector<road_bend_t> bends;
+
         // Temporary list to keep the found road sections
         vector<road_section_t> sections;
 
         // Distance between wheels
         float wheel_distance;
 
+        // Kernel used to find the edges in the scanlines
+        edge_kernel_t edge_kernel;
+
+        // Features extracted from each scanline of the current frame
+        scanline_features_t *features;
+
+        // Threads that extract the features of the scanlines
+        WorkerPool *workers;
+
+        // Frame being processed by the workers
+        Mat *current_frame;
+
+        // Part of each scanline to scan in the current frame
+        scanline_window_t *windows;
+
+        // Distance to both sides of the predicted road that is scanned (0
+        // if the road isn't tracked) and speed of the robot at max speed
+        float tracking_margin;
+        float max_speed;
+
+        // Sections found in the previous frame, its number of scanned
+        // scanlines, its capture time, and the command given to the motors
+        // after it
+        vector<road_section_t> prev_sections;
+        size_t prev_scanlines;
+        struct timespec prev_timestamp;
+        float motors_speed;
+        float motors_turn;
+
+        // Left and right points of the previous sections, moved to where
+        // they are predicted in the current frame
+        vector<glm::vec2> predicted_left;
+        vector<glm::vec2> predicted_right;
+
         /* Add a security margin to both sides of the road to assure that the
            robot won't fall off the limits.
            Parameters:
@@ -102,26 +223,46 @@ class DifferentialRoadFinder: public RoadFinder {
         */
         void add_secure_dist(Road& road);
 
+        /* Extract the features of a subset of the scanlines of the current
+           frame. Each worker processes one of every nworkers scanlines.
+           Parameters:
+             * worker: index of the worker.
+             * nworkers: total number of workers.
+        */
+        void extract_features(size_t worker, size_t nworkers);
+
+        /* Worker task that calls extract_features.
+           Parameters:
+             * instance: the DifferentialRoadFinder instance.
+             * worker: index of the worker.
+             * nworkers: total number of workers.
+        */
+        static void extract_features_task(
+            void *instance, size_t worker, size_t nworkers);
+
         /* Convert the line of pixels in a sequence of color segments.
            Parameters:
              * row: pointer to the row in the image that contains the colored
-                    pixels.
+                    pixels (the Y plane for NV12).
+             * chroma: for NV12, pointer to the row of the UV plane that
+                    corresponds to row.
              * channels: number of color channels in the source image.
              * edges: the positions of the segments edges.
              * nedges: the number of edges in the edges array.
              * color_segments: the colors of each segment.
         */
-        void find_color_segments(uchar *row, size_t channels, int edges[],
-            size_t nedges, color_segment_t color_segments[]);
+        void find_color_segments(uchar *row, uchar *chroma, size_t channels,
+            int edges[], size_t nedges, color_segment_t color_segments[]);
 
         /* Find the road limits.
            Parameters:
              * row: pointer to the row in the image to analize.
-             * len: number of pixels in row.
-             * edges: contains the found edges positions.
+             * start: first pixel of row to analize.
+             * len: number of pixels to analize.
+             * edges: contains the found edges positions (in the row).
            Return the number of edges found.
         */
-        size_t find_edges(uchar *row, size_t len, int edges[]);
+        size_t find_edges(uchar *row, size_t start, size_t len, int edges[]);
 
         /* Find a section of the road.
            Parameters:
@@ -136,6 +277,14 @@ class DifferentialRoadFinder: public RoadFinder {
             size_t nsegments, size_t index, road_section_t &prev_section,
             road_section_t& section);
 
+        /* Find the sections of the road in the features of the scanlines.
+           Parameters:
+             * goal: output goal, the line of the farthest section that has
+                   one.
+           Return true if the goal was found.
+        */
+        bool find_sections(glm::vec2& goal);
+
         /* If start and end corresponds to a road section, generate it.
            Parameters:
              * start: start position of the new road section.
@@ -148,15 +297,39 @@ class DifferentialRoadFinder: public RoadFinder {
         bool generate_new_section(float start, float end, float line,
             int index, road_section_t& prev_section, road_section_t& section);
 
+        /* Return the change of direction of the road of the previous frame
+           between two distances (in radians).
+           Parameters:
+             * y0: the nearest distance.
+             * y1: the farthest distance.
+        */
+        float get_bend(float y0, float y1) const;
+
+        /* Return the constant to multiply the X component in camera
+           coordinates to obtain the X in world coordinates.
+           Parameters:
+             * y: y world coordinate of the scanline.
+        */
+        float get_kx(float y) const;
+
         /* Convert a screen x coordinate to world.
            Parameters:
              * x: screen x coordinate.
              * index: index of the current scanline.
         */
         inline float get_world_x(float x, size_t index) const {
+            if (scanline_params[index].ground)
+                return scanline_params[index].ground[(size_t)x].x;
             return (x - (int)cam_params.width/2) * scanline_params[index].kx;
         }
 
+        /* Convert a world x coordinate to screen.
+           Parameters:
+             * x: world x coordinate.
+             * index: index of the current scanline.
+        */
+        float get_screen_x(float x, size_t index) const;
+
         /* Initialize the parameters for each scanline
            Parameters:
              * scanline_frame: SL_SCREEN, to use scanlines equidistant in
@@ -168,6 +341,35 @@ class DifferentialRoadFinder: public RoadFinder {
         void init_scanline_params(
             scanline_frame_t scanline_frame, float scanline_distance);
 
+        /* Make every row between the first and the last configured
+           scanlines a scanline that can be scanned, for the scanline budget.
+        */
+        void init_adaptive_scanlines();
+
+        /* Predict the part of each scanline where the road is, from the
+           road of the previous frame and the motion of the robot since then.
+           Parameters:
+             * timestamp: capture time of the current frame.
+           Return false if the road can't be tracked.
+        */
+        bool predict_windows(const struct timespec& timestamp);
+
+        /* Select the scanlines scanned in the current frame within the
+           scanline budget, adding them where the road of the previous frame
+           bends.
+        */
+        void select_scanlines();
+
+        // Scan the whole scanlines
+        void set_full_windows();
+
+        /* Set the parameters of the scanline at a row of the image.
+           Parameters:
+             * row: the row of the image.
+             * params: output parameters of the scanline.
+        */
+        void set_row_params(int row, scanline_params_t& params);
+
 };
 
 #endif
@@ -26,29 +26,30 @@ DoubleTurnSegment::contains(const glm::vec3& point) const
         && length(am) >= SEGMENT_R1 && length(am) <= SEGMENT_R2;
 }
 
-/* Initialize the geometry.
+/* Return the distance from the projection of a point to the center line of
+   the road of this segment, the arc between the inner and outer radius.
    Parameters:
-     * first_vertex: index in the OpenGL Vertex Buffer for the first
-         vertex of this segment.
-     * first_index: index in the OpenGL Index Buffer for the first
-         index of this segment.
-     * context: OpenGL objects.
+     * point: the point.
 */
+float
+DoubleTurnSegment::get_center_distance(const glm::vec3& point) const
+{
+    glm::vec3 am(point - a);
+
+    am[2] = 0;
+    return fabs(length(am) - (SEGMENT_R1 + SEGMENT_R2)/2);
+}
+
+// Initialize the geometry: the bounding box and the shape used by contains
 void
-DoubleTurnSegment::init_geometry(size_t first_vertex, size_t first_index,
-    const gl_context_t& context)
+DoubleTurnSegment::init_geometry()
 {
     gl_vertex_t tr_vertices[DOUBLETURN_NUM_VERTICES];
-    GLushort tr_indices[DOUBLETURN_NUM_INDICES];
-
-    this->first_vertex = first_vertex;
-    this->first_index = first_index;
-    this->context = context;
 
-    fill_buffers(vertices, tr_vertices, indices, tr_indices);
+    transform_vertices(vertices, tr_vertices);
+    compute_bounding_box(tr_vertices, DOUBLETURN_NUM_VERTICES);
 
     // Precomputed variables used in the contains function
-    
     a = tr_vertices[0].position*2.0f - tr_vertices[1].position;
     a[2] = 0;
     ab = tr_vertices[1].position - a;
@@ -57,23 +58,39 @@ DoubleTurnSegment::init_geometry(size_t first_vertex, size_t first_index,
     ad[2] = 0;
 }
 
-// Render this segment
+/* Write the vertices and the indices of this segment in the buffers of the
+   track.
+   Parameters:
+     * first_vertex: index in the OpenGL Vertex Buffer for the first
+         vertex of this segment.
+     * first_index: index in the OpenGL Index Buffer for the first
+         index of this segment.
+     * context: OpenGL objects, with the buffers being built.
+*/
+void
+DoubleTurnSegment::fill_geometry(size_t first_vertex, size_t first_index,
+    const gl_context_t& context)
+{
+    fill_buffers(vertices, indices, first_vertex, first_index, context);
+}
+
+/* Add the draws of this segment: for each part, its texture, its primitive
+   and its range of the index buffer.
+   Parameters:
+     * draws: vector where to add the draws.
+*/
 void
-DoubleTurnSegment::render()
+DoubleTurnSegment::get_draws(vector<gl_draw_t>& draws) const
 {
-    // Draw the primitives
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    // Draw the road
-    glUniform1i(context.u_texture, ROAD_TEXTURE);
-    glDrawElements(GL_TRIANGLE_STRIP, NSEGMENTS * 2 + 2, GL_UNSIGNED_SHORT,
-        (void *)(first_index * sizeof(GLushort)));
-    // Draw the left side
-    glUniform1i(context.u_texture, WOOD_TEXTURE);
-    glDrawElements(GL_TRIANGLE_STRIP, NSEGMENTS * 2 + 2, GL_UNSIGNED_SHORT,
-        (void *)((first_index + NSEGMENTS * 2 + 2) * sizeof(GLushort)));
-    // Draw the right side
-    glUniform1i(context.u_texture, WOOD_TEXTURE);
-    glDrawElements(GL_TRIANGLE_STRIP, NSEGMENTS * 2 + 2, GL_UNSIGNED_SHORT,
-        (void *)((first_index + NSEGMENTS * 4 + 4) * sizeof(GLushort)));
+    gl_draw_t road = {ROAD_TEXTURE, GL_TRIANGLE_STRIP, NSEGMENTS * 2 + 2,
+        (GLsizei)first_index};
+    gl_draw_t left = {WOOD_TEXTURE, GL_TRIANGLE_STRIP, NSEGMENTS * 2 + 2,
+        (GLsizei)first_index + NSEGMENTS * 2 + 2};
+    gl_draw_t right = {WOOD_TEXTURE, GL_TRIANGLE_STRIP, NSEGMENTS * 2 + 2,
+        (GLsizei)first_index + NSEGMENTS * 4 + 4};
+
+    draws.push_back(road);
+    draws.push_back(left);
+    draws.push_back(right);
 }
 
@@ -0,0 +1,323 @@
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__arm__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#include "edgekernel.hpp"
+#include "followexception.hpp"
+
+// Maximum value of a derivative in 8 bit lanes
+#define MAX_DERIVATIVE  255
+
+// State of the search of local maximums, kept between blocks of pixels
+typedef struct {
+    // Value and position of the current local maximum (0 if there's none)
+    unsigned int localmax;
+    size_t localmax_pos;
+
+    // Number of edges found
+    size_t num;
+} edge_state_t;
+
+/* Compute the threshold to use with the 8 bit absolute derivatives.
+   The derivatives equal to 0 are never taken into account by localmax, so
+   the threshold is at least 1.
+   Parameters:
+     * min_derivative: derivatives lower than this value are ignored.
+*/
+static inline unsigned int
+edge_threshold(int min_derivative)
+{
+    return (min_derivative < 1) ? 1 : min_derivative;
+}
+
+/* Process the absolute derivative of one pixel.
+   Parameters:
+     * value: the filtered absolute derivative (0 if it was filtered out).
+     * pos: position of the pixel in the row.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+     * st: state of the search.
+   Return true if the maximum number of edges has been reached.
+*/
+static inline bool
+edge_step(unsigned int value, size_t pos, size_t max_edges, int *edges,
+    edge_state_t& st)
+{
+    if (value) {
+        if (value > st.localmax) {
+            st.localmax = value;
+            st.localmax_pos = pos;
+        }
+    } else if (st.localmax_pos) {
+        edges[st.num++] = st.localmax_pos;
+        if (st.num >= max_edges) {
+            return true;
+        }
+        st.localmax = 0;
+        st.localmax_pos = 0;
+    }
+    return false;
+}
+
+/* Process a block of filtered absolute derivatives.
+   Parameters:
+     * values: the filtered absolute derivatives.
+     * n: number of values in the block.
+     * pos: position of the first value in the row.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+     * st: state of the search.
+   Return true if the maximum number of edges has been reached.
+*/
+static inline bool
+edge_block(const unsigned char *values, size_t n, size_t pos,
+    size_t max_edges, int *edges, edge_state_t& st)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (edge_step(values[i], pos + i, max_edges, edges, st)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Process the tail of the row that doesn't fill a whole SIMD block.
+   Parameters:
+     * row: the row of gray pixels.
+     * start: position of the first pixel to process (at least 1).
+     * len: number of pixels in row.
+     * threshold: derivatives lower than this value are ignored.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+     * st: state of the search.
+*/
+static inline void
+edge_tail(const unsigned char *row, size_t start, size_t len,
+    unsigned int threshold, size_t max_edges, int *edges, edge_state_t& st)
+{
+    unsigned int d;
+
+    for (size_t i = start; i < len; i++) {
+        d = (row[i] > row[i - 1]) ? row[i] - row[i - 1] : row[i - 1] - row[i];
+        if (edge_step(
+            (d >= threshold) ? d : 0, i, max_edges, edges, st))
+        {
+            return;
+        }
+    }
+}
+
+/* Portable kernel, used when no SIMD instructions are available.
+   Parameters:
+     * row: the row of gray pixels.
+     * len: number of pixels in row.
+     * min_derivative: derivatives lower than this value are ignored.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+   Return the number of edges found.
+*/
+size_t
+edgekernel::scalar(const unsigned char *row, size_t len, int min_derivative,
+    size_t max_edges, int *edges)
+{
+    unsigned int threshold = edge_threshold(min_derivative);
+    edge_state_t st = {0, 0, 0};
+
+    if (!max_edges || threshold > MAX_DERIVATIVE) {
+        return 0;
+    }
+    // The derivative of the first pixel is always 0
+    edge_tail(row, 1, len, threshold, max_edges, edges, st);
+    return st.num;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* Kernel that uses the SSE2 instructions.
+   Parameters:
+     * row: the row of gray pixels.
+     * len: number of pixels in row.
+     * min_derivative: derivatives lower than this value are ignored.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+   Return the number of edges found.
+*/
+__attribute__((target("sse2")))
+size_t
+edgekernel::sse2(const unsigned char *row, size_t len, int min_derivative,
+    size_t max_edges, int *edges)
+{
+    unsigned int threshold = edge_threshold(min_derivative);
+    edge_state_t st = {0, 0, 0};
+    unsigned char values[16];
+    __m128i a, b, d, active, vthreshold;
+    size_t i;
+
+    if (!max_edges || threshold > MAX_DERIVATIVE) {
+        return 0;
+    }
+    vthreshold = _mm_set1_epi8((char)threshold);
+    for (i = 1; i + 16 <= len; i += 16) {
+        // Absolute derivative, as the saturated difference in both senses
+        a = _mm_loadu_si128((const __m128i *)(row + i));
+        b = _mm_loadu_si128((const __m128i *)(row + i - 1));
+        d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        // Filter out the derivatives lower than the threshold
+        active = _mm_cmpeq_epi8(_mm_max_epu8(d, vthreshold), d);
+        if (!_mm_movemask_epi8(active)) {
+            // No edges in this block, only close the current maximum
+            if (edge_step(0, i, max_edges, edges, st)) {
+                return st.num;
+            }
+            continue;
+        }
+        _mm_storeu_si128((__m128i *)values, _mm_and_si128(d, active));
+        if (edge_block(values, 16, i, max_edges, edges, st)) {
+            return st.num;
+        }
+    }
+    edge_tail(row, i, len, threshold, max_edges, edges, st);
+    return st.num;
+}
+
+/* Kernel that uses the AVX2 instructions.
+   Parameters:
+     * row: the row of gray pixels.
+     * len: number of pixels in row.
+     * min_derivative: derivatives lower than this value are ignored.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+   Return the number of edges found.
+*/
+__attribute__((target("avx2")))
+size_t
+edgekernel::avx2(const unsigned char *row, size_t len, int min_derivative,
+    size_t max_edges, int *edges)
+{
+    unsigned int threshold = edge_threshold(min_derivative);
+    edge_state_t st = {0, 0, 0};
+    unsigned char values[32];
+    __m256i a, b, d, active, vthreshold;
+    size_t i;
+
+    if (!max_edges || threshold > MAX_DERIVATIVE) {
+        return 0;
+    }
+    vthreshold = _mm256_set1_epi8((char)threshold);
+    for (i = 1; i + 32 <= len; i += 32) {
+        // Absolute derivative, as the saturated difference in both senses
+        a = _mm256_loadu_si256((const __m256i *)(row + i));
+        b = _mm256_loadu_si256((const __m256i *)(row + i - 1));
+        d = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+        // Filter out the derivatives lower than the threshold
+        active = _mm256_cmpeq_epi8(_mm256_max_epu8(d, vthreshold), d);
+        if (!_mm256_movemask_epi8(active)) {
+            // No edges in this block, only close the current maximum
+            if (edge_step(0, i, max_edges, edges, st)) {
+                return st.num;
+            }
+            continue;
+        }
+        _mm256_storeu_si256((__m256i *)values, _mm256_and_si256(d, active));
+        if (edge_block(values, 32, i, max_edges, edges, st)) {
+            return st.num;
+        }
+    }
+    edge_tail(row, i, len, threshold, max_edges, edges, st);
+    return st.num;
+}
+#endif
+
+#if defined(__ARM_NEON)
+/* Kernel that uses the NEON instructions.
+   Parameters:
+     * row: the row of gray pixels.
+     * len: number of pixels in row.
+     * min_derivative: derivatives lower than this value are ignored.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+   Return the number of edges found.
+*/
+size_t
+edgekernel::neon(const unsigned char *row, size_t len, int min_derivative,
+    size_t max_edges, int *edges)
+{
+    unsigned int threshold = edge_threshold(min_derivative);
+    edge_state_t st = {0, 0, 0};
+    unsigned char values[16];
+    uint8x16_t d, filtered, vthreshold;
+    uint64x2_t any;
+    size_t i;
+
+    if (!max_edges || threshold > MAX_DERIVATIVE) {
+        return 0;
+    }
+    vthreshold = vdupq_n_u8(threshold);
+    for (i = 1; i + 16 <= len; i += 16) {
+        // Absolute derivative and filter out the lower than the threshold
+        d = vabdq_u8(vld1q_u8(row + i), vld1q_u8(row + i - 1));
+        filtered = vandq_u8(d, vcgeq_u8(d, vthreshold));
+        any = vreinterpretq_u64_u8(filtered);
+        if (!(vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1))) {
+            // No edges in this block, only close the current maximum
+            if (edge_step(0, i, max_edges, edges, st)) {
+                return st.num;
+            }
+            continue;
+        }
+        vst1q_u8(values, filtered);
+        if (edge_block(values, 16, i, max_edges, edges, st)) {
+            return st.num;
+        }
+    }
+    edge_tail(row, i, len, threshold, max_edges, edges, st);
+    return st.num;
+}
+#endif
+
+/* Return an edge kernel given its name.
+   Parameters:
+     * name: name of the kernel ("scalar", "sse2", "avx2" or "neon"), or
+         "auto" to select the fastest one supported by this CPU.
+   Throws FollowException if the kernel is unknown or the CPU doesn't support
+   it.
+*/
+edge_kernel_t
+edgekernel::get(const string& name)
+{
+    bool is_auto = (name == "auto");
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if ((is_auto || name == "avx2") && __builtin_cpu_supports("avx2")) {
+        return avx2;
+    }
+    if ((is_auto || name == "sse2") && __builtin_cpu_supports("sse2")) {
+        return sse2;
+    }
+#endif
+#if defined(__ARM_NEON)
+#if defined(__arm__)
+    if ((is_auto || name == "neon") && (getauxval(AT_HWCAP) & HWCAP_NEON)) {
+        return neon;
+    }
+#else
+    if (is_auto || name == "neon") {
+        return neon;
+    }
+#endif
+#endif
+    if (is_auto || name == "scalar") {
+        return scalar;
+    }
+    throw FollowException(
+        "edge kernel '" + name + "' not supported by this CPU");
+}
+
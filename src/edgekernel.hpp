@@ -0,0 +1,63 @@
+/* edgekernel.hpp
+   Kernels that find the edges in a row of gray pixels. Each kernel gives the
+   same result as applying utilities::derivative, utilities::abs,
+   utilities::filterlt and utilities::localmax one after the other, but does
+   it in a single pass over the row, using 8 bit lanes and the SIMD
+   instructions of the CPU when they are available.
+*/
+
+#ifndef EDGEKERNEL_HPP
+#define EDGEKERNEL_HPP
+
+#include <string>
+#include <sys/types.h>
+
+using namespace std;
+
+/* Type of an edge kernel.
+   Parameters:
+     * row: the row of gray pixels.
+     * len: number of pixels in row.
+     * min_derivative: derivatives lower than this value are ignored.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+   Return the number of edges found.
+*/
+typedef size_t (*edge_kernel_t)(const unsigned char *row, size_t len,
+    int min_derivative, size_t max_edges, int *edges);
+
+namespace edgekernel {
+
+    // Portable kernel, used when no SIMD instructions are available
+    size_t scalar(const unsigned char *row, size_t len, int min_derivative,
+        size_t max_edges, int *edges);
+
+#if defined(__x86_64__) || defined(__i386__)
+    // Kernel that uses the SSE2 instructions
+    size_t sse2(const unsigned char *row, size_t len, int min_derivative,
+        size_t max_edges, int *edges);
+
+    // Kernel that uses the AVX2 instructions
+    size_t avx2(const unsigned char *row, size_t len, int min_derivative,
+        size_t max_edges, int *edges);
+#endif
+
+#if defined(__ARM_NEON)
+    // Kernel that uses the NEON instructions
+    size_t neon(const unsigned char *row, size_t len, int min_derivative,
+        size_t max_edges, int *edges);
+#endif
+
+    /* Return an edge kernel given its name.
+       Parameters:
+         * name: name of the kernel ("scalar", "sse2", "avx2" or "neon"), or
+             "auto" to select the fastest one supported by this CPU.
+       Throws FollowException if the kernel is unknown or the CPU doesn't
+       support it.
+    */
+    edge_kernel_t get(const string& name);
+
+}
+
+#endif
+
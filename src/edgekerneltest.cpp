@@ -0,0 +1,132 @@
+/* edgekerneltest.cpp
+   Checks that every edge kernel supported by the CPU finds the same edges
+   as the chain of utilities::derivative, utilities::abs, utilities::filterlt
+   and utilities::localmax that they replace.
+*/
+
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "edgekernel.hpp"
+#include "followexception.hpp"
+#include "utilities.hpp"
+
+// Maximum number of edges asked to the kernels
+#define MAX_EDGES   32
+
+// Number of random rows of each length
+#define ROWS        50
+
+using namespace utilities;
+
+// The kernels to check
+const char *kernels[] = {"scalar", "sse2", "avx2", "neon"};
+
+// Lengths of the rows, around the widths of the SIMD registers and the
+// usual widths of the frames
+const size_t lengths[] = {0, 1, 2, 3, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+    100, 320, 640, 3280};
+
+// Thresholds of the derivative, including the limits of the 8 bit lanes
+const int min_derivatives[] = {0, 1, 30, 127, 128, 255, 256};
+
+// Maximum number of edges, to check that the kernels stop at it
+const size_t max_edges[] = {0, 1, 4, MAX_EDGES};
+
+/* Find the edges of a row with the chain of the utilities.
+   Parameters:
+     * row: the row of gray pixels.
+     * min_derivative: derivatives lower than this value are ignored.
+     * max_edges: maximum number of edges to find.
+     * edges: output positions of the edges found.
+   Return the number of edges found.
+*/
+size_t
+reference(vector<unsigned char>& row, int min_derivative, size_t max_edges,
+    int *edges)
+{
+    vector<int> aux(row.size() + 1);
+
+    if (row.empty())
+        return 0;
+    derivative(&row[0], row.size(), &aux[0]);
+    utilities::abs(&aux[0], row.size(), &aux[0]);
+    filterlt(&aux[0], row.size(), min_derivative, &aux[0]);
+    return localmax(&aux[0], row.size(), max_edges, edges);
+}
+
+/* Fill a row with random pixels: either noise, or flat colors with steps
+   between them and a little noise, like the scanlines of the road.
+   Parameters:
+     * row: the row to fill.
+     * seed: state of the random numbers.
+*/
+void
+fill_row(vector<unsigned char>& row, unsigned int& seed)
+{
+    int value = rand_r(&seed) % 256, noise;
+    bool steps = rand_r(&seed) % 2;
+
+    for (size_t i = 0; i < row.size(); i++) {
+        if (!steps) {
+            row[i] = rand_r(&seed) % 256;
+            continue;
+        }
+        if (rand_r(&seed) % 16 == 0)
+            value = rand_r(&seed) % 256;
+        noise = value + rand_r(&seed) % 9 - 4;
+        row[i] = noise < 0 ? 0 : (noise > 255 ? 255 : noise);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    vector<unsigned char> row;
+    int expected[MAX_EDGES], edges[MAX_EDGES];
+    size_t nexpected, nedges;
+    unsigned int seed = 1;
+    edge_kernel_t kernel;
+    int failures = 0;
+
+    for (size_t k = 0; k < sizeof(kernels)/sizeof(kernels[0]); k++) {
+        try {
+            kernel = edgekernel::get(kernels[k]);
+        } catch (FollowException& e) {
+            // Not supported by this CPU
+            continue;
+        }
+        for (size_t l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+            row.resize(lengths[l]);
+            for (size_t r = 0; r < ROWS; r++) {
+                fill_row(row, seed);
+                for (size_t d = 0;
+                    d < sizeof(min_derivatives)/sizeof(min_derivatives[0]);
+                    d++)
+                {
+                    for (size_t m = 0;
+                        m < sizeof(max_edges)/sizeof(max_edges[0]); m++)
+                    {
+                        nexpected = reference(row, min_derivatives[d],
+                            max_edges[m], expected);
+                        nedges = kernel(row.empty() ? 0 : &row[0],
+                            row.size(), min_derivatives[d], max_edges[m],
+                            edges);
+                        if (nedges != nexpected || memcmp(edges, expected,
+                            nedges * sizeof(int)))
+                        {
+                            warnx("%s: wrong edges in a row of %zu pixels "
+                                "with min_derivative %d and max_edges %zu",
+                                kernels[k], row.size(), min_derivatives[d],
+                                max_edges[m]);
+                            failures++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "filebufferring.hpp"
+#include "followexception.hpp"
+#include "utilities.hpp"
+
+/* Constructor.
+   Parameters:
+     * file: path of the file of raw frames.
+     * cam_params: camera's parameters (size and pixel format).
+   Throws FollowException if the file can't be mapped or doesn't contain any
+   frame.
+*/
+FileBufferRing::FileBufferRing(
+        const string& file, const cam_params_t& cam_params):
+    data(0), length(0), size(frame_size(cam_params)), nframes(0), next(0)
+{
+    struct stat st;
+    void *addr;
+    int fd;
+
+    if ((fd = open(file.c_str(), O_RDONLY)) < 0) {
+        throw FollowException("cannot open " + file + ": " + strerror(errno));
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw FollowException("cannot stat " + file + ": " + strerror(errno));
+    }
+    length = st.st_size;
+    nframes = length / size;
+    if (!nframes) {
+        close(fd);
+        throw FollowException(file + " doesn't contain any frame");
+    }
+    // The mapping is private and writable, so the frames can be drawn on
+    // without modifying the file
+    addr = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw FollowException("cannot map " + file + ": " + strerror(errno));
+    }
+    data = (unsigned char *)addr;
+}
+
+FileBufferRing::~FileBufferRing()
+{
+    if (data)
+        munmap(data, length);
+}
+
+// Return the number of buffers of the ring
+size_t
+FileBufferRing::get_size() const
+{
+    return nframes;
+}
+
+/* Return the memory of a buffer.
+   Parameters:
+     * index: index of the buffer.
+*/
+unsigned char *
+FileBufferRing::get_buffer(size_t index) const
+{
+    return data + index * size;
+}
+
+/* Take the next frame of the file.
+   Parameters:
+     * timestamp: output capture time of the frame (the current time).
+   Return the index of the buffer.
+*/
+size_t
+FileBufferRing::dequeue(struct timespec& timestamp)
+{
+    size_t index = next;
+
+    utilities::timenow(timestamp);
+    next = (next + 1) % nframes;
+    return index;
+}
+
+/* Give a buffer back to the ring (nothing to do for a file).
+   Parameters:
+     * index: index of the buffer.
+*/
+void
+FileBufferRing::enqueue(size_t index)
+{}
+
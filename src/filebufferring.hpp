@@ -0,0 +1,72 @@
+/* filebufferring.hpp
+   A ring of buffers backed by a file of raw frames, one after the other,
+   with the size and pixel format of the camera. The file is mapped in
+   memory and the frames are returned in order, starting again when the end
+   is reached. Useful to test the V4L2 camera without a device.
+*/
+
+#ifndef FILEBUFFERRING_HPP
+#define FILEBUFFERRING_HPP
+
+#include <string>
+
+#include "bufferring.hpp"
+#include "camparams.hpp"
+
+using namespace std;
+
+class FileBufferRing: public BufferRing {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * file: path of the file of raw frames.
+             * cam_params: camera's parameters (size and pixel format).
+           Throws FollowException if the file can't be mapped or doesn't
+           contain any frame.
+        */
+        FileBufferRing(const string& file, const cam_params_t& cam_params);
+
+        virtual ~FileBufferRing();
+
+        // Return the number of buffers of the ring
+        virtual size_t get_size() const;
+
+        /* Return the memory of a buffer.
+           Parameters:
+             * index: index of the buffer.
+        */
+        virtual unsigned char *get_buffer(size_t index) const;
+
+        /* Take the next frame of the file.
+           Parameters:
+             * timestamp: output capture time of the frame (the current
+                 time).
+           Return the index of the buffer.
+        */
+        virtual size_t dequeue(struct timespec& timestamp);
+
+        /* Give a buffer back to the ring (nothing to do for a file).
+           Parameters:
+             * index: index of the buffer.
+        */
+        virtual void enqueue(size_t index);
+
+    private:
+
+        // The mapped file and its length
+        unsigned char *data;
+        size_t length;
+
+        // Size of each frame and number of frames in the file
+        size_t size;
+        size_t nframes;
+
+        // Index of the next frame to return
+        size_t next;
+
+};
+
+#endif
+
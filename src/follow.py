@@ -13,6 +13,10 @@ EVT_STOPPED = 12
 EVT_MOVED = 13
 EVT_DATA = 14
 EVT_INFO = 15
+EVT_STATS = 17
+
+# Names of the stages in the stats event, in the order they are sent
+STAGES = ('frame_wait', 'road', 'path', 'motors', 'telemetry', 'latency')
 
 # Private constants
 # Simple commands to send (the whole stream of bytes is the constant)
@@ -22,6 +26,7 @@ _CMD_UNSUBSCRIBE = b'\x03'
 _CMD_START = b'\x04'
 _CMD_STOP = b'\x05'
 _CMD_INFO = b'\x07'
+_CMD_STATS = b'\x10'
 
 # Move command code
 _CMD_MOVE = 6
@@ -180,6 +185,33 @@ class InfoEvent(Event):
         (self.wheel_axis_offset, self.wheel_distance, self.wheel_diameter,
             self.front_wheel_offset) = struct.unpack('>xffff', bytes)
 
+class StatsEvent(Event):
+    '''A stats event, sent with the timing statistics of the main loop.
+
+    Attributes:
+      * stages: dictionary that maps the name of each stage (see STAGES) to a
+          tuple (count, p50, p99, max), where count is the number of times
+          recorded and the rest are the median, the 99th percentile and the
+          maximum time, in seconds.
+
+    Constructor parameters:
+      * bytes: message bytes.
+    '''
+
+    _CODE = EVT_STATS
+    _LEN = None
+
+    def __init__(self, bytes):
+        Event.__init__(self, bytes)
+        num_stages = bytes[1]
+        if len(bytes) != 2 + num_stages*16:
+            raise ValueError('wrong message size (code {})'.format(self._CODE))
+        values = struct.unpack('>xx{}I'.format(num_stages*4), bytes)
+        self.stages = {}
+        for i in range(min(num_stages, len(STAGES))):
+            count, p50, p99, max_ = values[i*4:i*4 + 4]
+            self.stages[STAGES[i]] = (count, p50*1e-6, p99*1e-6, max_*1e-6)
+
 class Follower(object):
     '''Implements the communication with a follower robot.
 
@@ -196,6 +228,8 @@ class Follower(object):
         MovedEvent,
         DataEvent,
         InfoEvent,
+        None,
+        StatsEvent,
     ]
 
     def __init__(self, addr):
@@ -235,6 +269,13 @@ class Follower(object):
         '''
         self.sock.send(_CMD_INFO)
 
+    def get_stats(self):
+        '''Send a stats query command.
+
+        This requests for the timing statistics of the main loop.
+        '''
+        self.sock.send(_CMD_STATS)
+
     def move(self, speed, turn):
         '''Send a move command to the line follower robot.
 
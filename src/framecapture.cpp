@@ -1,67 +1,68 @@
 
 #include <err.h>
-#include <fstream>
 #include <pthread.h>
-#include <sstream>
 
 #include "followexception.hpp"
 #include "framecapture.hpp"
 #include "realcamera.hpp"
+#include "trackfile.hpp"
+#include "v4l2camera.hpp"
 #include "virtualcamera.hpp"
 
-const segment_id_t FrameCapture::segments_ids[] = {
-    {SEGMENT_STRAIGHT, "Straight"},
-    {SEGMENT_TURNLEFT, "TurnLeft"},
-    {SEGMENT_TURNRIGHT, "TurnRight"},
-    {SEGMENT_DASHED1, "Dashed1"},
-    {SEGMENT_DASHED2, "Dashed2"},
-    {SEGMENT_ZIGZAG, "ZigZag"},
-    {SEGMENT_WIDENARROW, "WideNarrow"},
-    {SEGMENT_NARROW, "Narrow"},
-    {SEGMENT_NARROWWIDE, "NarrowWide"},
-    {SEGMENT_VCROSSROAD, "VCrossroad"},
-    {SEGMENT_ACROSSROAD, "ACrossroad"},
-    {SEGMENT_DOUBLETURNLEFT, "DoubleTurnLeft"},
-    {SEGMENT_DOUBLETURNRIGHT, "DoubleTurnRight"}
-};
+// Buffers of the V4L2 camera that aren't in the slots of the ring: the one
+// of the camera and the one being filled by the driver
+#define MIN_FREE_BUFFERS    2
 
 FrameCapture::FrameCapture():
-    camera(0)
+    camera(0), ring(0), last_frame(0), recorder(0)
 {}
 
 /* Constructor.
    Parameters:
      * cam_params: camera parameters.
-     * camera_type: type of camera (as for now, "real" or "virtual").
+     * camera_type: type of camera ("real", "v4l2", "virtual" or "replay").
      * track_file: for the virtual camera, the file that contains the track
          description.
+     * headless: for the virtual camera, render without an X server.
+     * time_step: for the virtual camera, time that the simulated clock
+         advances with each frame (in s), or 0 to use the real time.
+     * stream_radius: for the virtual camera, distance from the camera to
+         the segments of the track kept in the buffers (in cm), or 0 to keep
+         the whole track.
+     * device: for the V4L2 camera, the device or the file of raw frames.
+     * nbuffers: for the V4L2 camera, the number of buffers.
+     * replay_file: for the replay camera, the capture file.
+     * replay_mode: for the replay camera, the pace of the frames.
+     * depth: number of frames of the ring between the capture thread and
+         the caller.
+     * policy: policy to choose the next frame from the ring.
 */
 FrameCapture::FrameCapture(const cam_params_t& cam_params,
-        const string& camera_type, const string& track_file):
+        const string& camera_type, const string& track_file, bool headless,
+        float time_step, float stream_radius, const string& device,
+        size_t nbuffers, const string& replay_file, replay_mode_t replay_mode,
+        size_t depth, frame_policy_t policy):
     cam_params(cam_params), camera_type(camera_type), track_file(track_file),
-    camera(0), cond_req(PTHREAD_COND_INITIALIZER),
-    cond_avail(PTHREAD_COND_INITIALIZER), mutex_req(PTHREAD_MUTEX_INITIALIZER),
-    mutex_avail(PTHREAD_MUTEX_INITIALIZER), frame_req(false),
-    frame_avail(false)
+    headless(headless), time_step(time_step), stream_radius(stream_radius),
+    device(device),
+    nbuffers(nbuffers), replay_file(replay_file), replay_mode(replay_mode),
+    depth(depth), policy(policy),
+    camera(0), ring(0), last_frame(0), recorder(0)
 {}
 
 FrameCapture::~FrameCapture()
 {
-    if (camera) {
-        pthread_cancel(thread);
+    // Write the pending frames
+    if (recorder)
+        delete recorder;
+    if (ring) {
+        // Stop the thread
+        ring->close();
         pthread_join(thread, 0);
-        delete camera;
+        delete ring;
     }
-}
-
-// Fetch the next frame
-void
-FrameCapture::fetch()
-{
-    pthread_mutex_lock(&mutex_req);
-    frame_req = true;
-    pthread_mutex_unlock(&mutex_req);
-    pthread_cond_signal(&cond_req);
+    if (camera)
+        delete camera;
 }
 
 // Return the camera instance
@@ -71,26 +72,68 @@ FrameCapture::get_camera() const
     return camera;
 }
 
-// Start the working thread
+// Start the working thread (or, with FRAME_SYNC, only create the camera)
 void
 FrameCapture::start()
 {
+    // The frames are fetched in the caller thread, that is the one that
+    // must own the camera (and its OpenGL context)
+    if (policy == FRAME_SYNC) {
+        init_camera();
+        return;
+    }
+
+    // The ring is created here and not in the constructor, because the
+    // object is copied before starting it
+    ring = new FrameRing(depth, policy, give_back, this);
+
     // Create the thread
     pthread_create(&thread, 0, thread_main, this);
-    pthread_detach(thread);
 }
 
-// Return the next frame.
+/* Return the next frame, according to the policy. The frame is valid until
+   the next call to next.
+   Parameters:
+     * timestamp: output capture time of the frame (from the monotonic
+         clock, or the simulated clock of the virtual camera).
+   Throws FollowException if the capture thread has stopped.
+*/
 Mat&
-FrameCapture::next()
+FrameCapture::next(struct timespec& timestamp)
 {
-    pthread_mutex_lock(&mutex_avail);
-    if (!frame_avail) {
-        pthread_cond_wait(&cond_avail, &mutex_avail);
+    if (policy == FRAME_SYNC) {
+        camera->fetch();
+        last_frame = &camera->next();
+        timestamp = camera->get_timestamp();
+    } else if (!(last_frame = ring->read(timestamp))) {
+        throw FollowException("the capture of frames has stopped");
     }
-    frame_avail = false;
-    pthread_mutex_unlock(&mutex_avail);
-    return camera->next();
+    last_timestamp = timestamp;
+    return *last_frame;
+}
+
+/* Record the frame returned by the last call to next, if recording.
+   Parameters:
+     * speed: speed given to the motors for the frame.
+     * turn: turn given to the motors for the frame.
+*/
+void
+FrameCapture::record(float speed, float turn)
+{
+    if (recorder && last_frame)
+        recorder->record(*last_frame, last_timestamp, speed, turn);
+}
+
+/* Start recording the frames to a capture file.
+   Parameters:
+     * file: path of the capture file.
+     * max_frames: maximum number of frames to record.
+   Throws FollowException if the file can't be created.
+*/
+void
+FrameCapture::start_recording(const string& file, size_t max_frames)
+{
+    recorder = new Recorder(file, cam_params, max_frames);
 }
 
 // PRIVATE FUNCTIONS
@@ -102,105 +145,80 @@ FrameCapture::init_camera()
     vector<segment_t> segments;
 
     try {
-        // Create the virtual or real camera
+        // Create the virtual, V4L2, replay or real camera
         if (camera_type == "virtual") {
             // Create the virtual camera
             // Load the track
-            load_track_file(track_file, segments);
+            trackfile::load(track_file, segments);
 
             // Instantiate the camera
-            camera = new VirtualCamera(segments, cam_params);
+            camera = new VirtualCamera(segments, cam_params, headless,
+                time_step, stream_radius);
+        } else if (camera_type == "v4l2") {
+            // Create the camera managed directly through V4L2. The slots of
+            // the ring can hold a buffer each, and then the camera needs
+            // one and the driver another one to fill.
+            if (ring && nbuffers < ring->get_depth() + MIN_FREE_BUFFERS)
+                nbuffers = ring->get_depth() + MIN_FREE_BUFFERS;
+            camera = new V4L2Camera(cam_params, device, nbuffers);
+        } else if (camera_type == "replay") {
+            // Create the camera that replays a capture file
+            camera = new ReplayCamera(replay_file, replay_mode);
         } else {
             // Create the real camera
-            camera = new RealCamera();
+            camera = new RealCamera(cam_params);
         }
     } catch (FollowException& e) {
         errx(1, "cannot create FrameCapture object: %s", e.what());
     }
 }
 
-// Load a track file (for the virtual camera)
-void
-FrameCapture::load_track_file(
-    const string& track_file, vector<segment_t>& segments)
-{
-    string line;
-    size_t linenum = 1, sep;
-    ifstream f(track_file);
-    segment_t s;
-
-    if (f.fail()) {
-        err(1, "cannot open file %s", track_file.c_str());
-    } else {
-        while (getline(f, line)) {
-            // Ignore comments
-            if (line[0] == '#') continue;
-            // Get the elements of the line
-            stringstream ss(line);
-            string stype, sinput, soutput;
-            ss >> stype >> sinput >> soutput;
-            // Get the type of segment
-            s.type = SEGMENT_NULL;
-            for (size_t i = 0; i < sizeof(segments_ids)/sizeof(segment_id_t);
-                i++)
-            {
-                if (stype == segments_ids[i].str_id) {
-                    s.type = segments_ids[i].type;
-                }
-            }
-            if (s.type == SEGMENT_NULL) {
-                errx(1, "wrong track segment '%s' (line %zd)",
-                    line.c_str(), linenum);
-            }
-            // Get the input
-            s.input = (sinput != "") ? atoi(sinput.c_str()) : 0;
-            // Get the output
-            if (soutput != "") {
-                sep = soutput.find(':');
-                if (sep != soutput.npos) {
-                    s.prev = atoi(soutput.substr(0, sep).c_str());
-                    s.output = atoi(soutput.substr(sep + 1).c_str());
-                } else {
-                    s.prev = atoi(soutput.c_str());
-                    s.output = 0;
-                }
-            } else {
-                s.prev = -1;
-                s.output = 0;
-            }
-            segments.push_back(s);
-            linenum++;
-        }
-    }
-}
-
 // Run the tasks of this thread
 void
 FrameCapture::run()
 {
+    Mat *frame;
+    ssize_t buffer;
+
     // Initialize the camera
     init_camera();
 
-    while (1) {
-        // Wait until there's a request to capture a frame
-        pthread_mutex_lock(&mutex_req);
-        if (!frame_req) {
-            pthread_cond_wait(&cond_req, &mutex_req);
+    // Capture frames continuously, without waiting for requests. If the
+    // camera fails, the ring is closed, so the caller doesn't wait forever.
+    while (!ring->is_closed()) {
+        try {
+            camera->fetch();
+        } catch (FollowException& e) {
+            warnx("cannot capture frames: %s", e.what());
+            ring->close();
+            break;
         }
-        frame_req = false;
-        pthread_mutex_unlock(&mutex_req);
-
-        // Capture the frame
-        camera->fetch();
 
-        // Notify that a new frame is available
-        pthread_mutex_lock(&mutex_avail);
-        frame_avail = true;
-        pthread_mutex_unlock(&mutex_avail);
-        pthread_cond_signal(&cond_avail);
+        // Put the frame in a slot of the ring. The buffer of the frame is
+        // lent to the slot when the camera can, and it's given back when the
+        // slot is reused. Otherwise the camera reuses its buffers, so the
+        // frame is copied.
+        if (!(frame = ring->begin_write()))
+            break;
+        if ((buffer = camera->lend()) >= 0)
+            *frame = camera->next();
+        else
+            camera->next().copyTo(*frame);
+        ring->end_write(camera->get_timestamp(), buffer);
     }
 }
 
+/* Give back a buffer lent by the camera to a slot of the ring.
+   Parameters:
+     * instance: instance of the FrameCapture object.
+     * buffer: index of the buffer.
+*/
+void
+FrameCapture::give_back(void *instance, ssize_t buffer)
+{
+    ((FrameCapture *)instance)->camera->give_back(buffer);
+}
+
 /* Thread main routine.
    Parameters:
      * instance: instance of the FrameCapture object.
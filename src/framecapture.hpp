@@ -6,17 +6,12 @@
 
 #include "camera.hpp"
 #include "camparams.hpp"
-#include "virtualtrack.hpp"
+#include "framering.hpp"
+#include "recorder.hpp"
+#include "replaycamera.hpp"
 
 using namespace cv;
 
-// Type that relates the string identifier of a segment type with its
-// enumeration
-typedef struct {
-    segment_type_t type;
-    const char *str_id;
-} segment_id_t;
-
 class FrameCapture {
 
     public:
@@ -26,26 +21,65 @@ class FrameCapture {
         /* Constructor.
            Parameters:
              * cam_params: camera parameters.
-             * camera_type: type of camera (as for now, "real" or "virtual").
+             * camera_type: type of camera ("real", "v4l2", "virtual" or
+                 "replay").
              * track_file: for the virtual camera, the file that contains the
                  track description.
+             * headless: for the virtual camera, render without an X server.
+             * time_step: for the virtual camera, time that the simulated
+                 clock advances with each frame (in s), or 0 to use the real
+                 time.
+             * stream_radius: for the virtual camera, distance from the
+                 camera to the segments of the track kept in the buffers (in
+                 cm), or 0 to keep the whole track.
+             * device: for the V4L2 camera, the device or the file of raw
+                 frames.
+             * nbuffers: for the V4L2 camera, the number of buffers.
+             * replay_file: for the replay camera, the capture file.
+             * replay_mode: for the replay camera, the pace of the frames.
+             * depth: number of frames of the ring between the capture thread
+                 and the caller.
+             * policy: policy to choose the next frame from the ring.
         */
         FrameCapture(const cam_params_t& cam_params, const string& camera_type,
-            const string& track_file);
+            const string& track_file, bool headless, float time_step,
+            float stream_radius, const string& device, size_t nbuffers,
+            const string& replay_file, replay_mode_t replay_mode,
+            size_t depth, frame_policy_t policy);
 
         ~FrameCapture();
 
-        // Fetch the next frame
-        void fetch();
-
         // Return the camera instance
         Camera *get_camera() const;
 
-        // Start the working thread
+        // Start the working thread (or, with FRAME_SYNC, only create the
+        // camera)
         void start();
 
-        // Return the next frame
-        Mat& next();
+        /* Return the next frame, according to the policy. The frame is valid
+           until the next call to next.
+           Parameters:
+             * timestamp: output capture time of the frame (from the
+                 monotonic clock, or the simulated clock of the virtual
+                 camera).
+           Throws FollowException if the capture thread has stopped.
+        */
+        Mat& next(struct timespec& timestamp);
+
+        /* Record the frame returned by the last call to next, if recording.
+           Parameters:
+             * speed: speed given to the motors for the frame.
+             * turn: turn given to the motors for the frame.
+        */
+        void record(float speed, float turn);
+
+        /* Start recording the frames to a capture file.
+           Parameters:
+             * file: path of the capture file.
+             * max_frames: maximum number of frames to record.
+           Throws FollowException if the file can't be created.
+        */
+        void start_recording(const string& file, size_t max_frames);
 
     private:
 
@@ -53,33 +87,45 @@ class FrameCapture {
         cam_params_t cam_params;
         string camera_type;
         string track_file;
+        bool headless;
+        float time_step;
+        float stream_radius;
+        string device;
+        size_t nbuffers;
+        string replay_file;
+        replay_mode_t replay_mode;
+
+        // Attributes of the ring of frames
+        size_t depth;
+        frame_policy_t policy;
 
         // Component to obtain the camera frame
         Camera *camera;
 
-        // Thread attributes
-        pthread_t thread;
-        pthread_cond_t cond_req;
-        pthread_cond_t cond_avail;
-        pthread_mutex_t mutex_req;
-        pthread_mutex_t mutex_avail;
+        // Ring of frames between the thread and the caller (0 with
+        // FRAME_SYNC, there's no thread then)
+        FrameRing *ring;
 
-        // true if a new frame has been requested, false otherwise.
-        bool frame_req;
+        // Last frame returned by next and its capture time
+        Mat *last_frame;
+        struct timespec last_timestamp;
 
-        // true if a new frame is available, false otherwise.
-        bool frame_avail;
+        // Recorder of the frames (0 if not recording)
+        Recorder *recorder;
 
-        // Relates segment strings IDs with their enumerations
-        static const segment_id_t segments_ids[];
+        // Thread attributes
+        pthread_t thread;
+
+        /* Give back a buffer lent by the camera to a slot of the ring.
+           Parameters:
+             * instance: instance of the FrameCapture object.
+             * buffer: index of the buffer.
+        */
+        static void give_back(void *instance, ssize_t buffer);
 
         // Initialize the camera
         void init_camera();
 
-        // Load a track file (for the virtual camera)
-        void load_track_file(
-            const string& track_file, vector<segment_t>& segments);
-
         // Run the tasks of this thread
         void run();
 
@@ -0,0 +1,237 @@
+
+#include <sched.h>
+#include <time.h>
+
+#include "framering.hpp"
+
+// Attempts that spin and that yield the CPU before starting to sleep
+#define SPIN_ATTEMPTS   64
+#define YIELD_ATTEMPTS  128
+
+// Time to sleep while waiting (in ns)
+#define SLEEP_NS        100000
+
+/* Constructor.
+   Parameters:
+     * depth: number of slots (at least 2).
+     * policy: policy to choose the frame given to the consumer.
+     * give_back: function to give back the buffers lent by the camera (0 if
+         they are never lent).
+     * owner: object passed to give_back.
+*/
+FrameRing::FrameRing(size_t depth, frame_policy_t policy,
+        give_back_t give_back, void *owner):
+    depth((depth < 2) ? 2 : depth), policy(policy), give_back(give_back),
+    owner(owner), seq(0), read_seq(0), writing(-1), reading(-1),
+    closed(false)
+{
+    slots = new frame_slot_t[this->depth];
+    for (size_t i = 0; i < this->depth; i++) {
+        slots[i].state.store(SLOT_FREE);
+        slots[i].seq.store(0);
+        slots[i].buffer = -1;
+    }
+}
+
+FrameRing::~FrameRing()
+{
+    // The producer has stopped, give back the buffers still in the slots
+    for (size_t i = 0; i < depth; i++) {
+        release(i);
+    }
+    delete[] slots;
+}
+
+/* Take a slot to write a new frame in it. With FRAME_LATEST it never waits,
+   with FRAME_FIFO it waits until a slot is free.
+   Return the frame of the slot, or 0 if the ring has been closed.
+*/
+Mat *
+FrameRing::begin_write()
+{
+    unsigned int attempt = 0;
+    ssize_t index;
+
+    while (!closed.load(memory_order_relaxed)) {
+        // Take a free slot
+        index = find(SLOT_FREE, false);
+        if (index >= 0 && transition(index, SLOT_FREE, SLOT_WRITING)) {
+            writing = index;
+            return &slots[index].frame;
+        }
+        // With the latest policy, overwrite the oldest frame not read yet.
+        // There's always one, because the consumer only holds one slot.
+        if (policy == FRAME_LATEST) {
+            index = find(SLOT_READY, false);
+            if (index >= 0 && transition(index, SLOT_READY, SLOT_WRITING)) {
+                release(index);
+                writing = index;
+                return &slots[index].frame;
+            }
+        } else {
+            backoff(attempt);
+        }
+    }
+    return 0;
+}
+
+/* Publish the frame written in the slot taken with begin_write.
+   Parameters:
+     * timestamp: capture time of the frame.
+     * buffer: buffer lent by the camera that the frame wraps, or -1 if the
+         frame was copied in the slot.
+*/
+void
+FrameRing::end_write(const struct timespec& timestamp, ssize_t buffer)
+{
+    slots[writing].timestamp = timestamp;
+    slots[writing].buffer = buffer;
+    slots[writing].seq.store(++seq, memory_order_relaxed);
+    slots[writing].state.store(SLOT_READY, memory_order_release);
+    writing = -1;
+}
+
+/* Give back the frame previously read and wait for the next one, according
+   to the policy.
+   Parameters:
+     * timestamp: output capture time of the frame.
+   Return the frame, that is valid until the next call to read, or 0 if the
+   ring has been closed and there are no more frames to read.
+   With the latest policy the older frames are not dropped here, they are
+   skipped and the producer overwrites them when it runs out of free slots.
+*/
+Mat *
+FrameRing::read(struct timespec& timestamp)
+{
+    unsigned int attempt = 0;
+    ssize_t index;
+    bool was_closed;
+
+    // Give back the previous frame, and its buffer to the camera
+    if (reading >= 0) {
+        release(reading);
+        slots[reading].state.store(SLOT_FREE, memory_order_release);
+        reading = -1;
+    }
+    // Take the newest or the oldest frame ready that hasn't been read yet.
+    // The producer can take the same slot in the meanwhile, in that case try
+    // again. The frames written before the ring was closed are still given,
+    // so the closed flag is read before looking for them.
+    while (1) {
+        was_closed = closed.load(memory_order_acquire);
+        index = find(SLOT_READY, policy == FRAME_LATEST);
+        if (index >= 0
+            && slots[index].seq.load(memory_order_relaxed) > read_seq)
+        {
+            if (transition(index, SLOT_READY, SLOT_READING))
+                break;
+        } else if (was_closed) {
+            return 0;
+        } else {
+            backoff(attempt);
+        }
+    }
+    reading = index;
+    read_seq = slots[index].seq.load(memory_order_relaxed);
+    timestamp = slots[index].timestamp;
+    return &slots[index].frame;
+}
+
+// Close the ring, so that the producer stops
+void
+FrameRing::close()
+{
+    closed.store(true);
+}
+
+// Return true if the ring has been closed
+bool
+FrameRing::is_closed() const
+{
+    return closed.load(memory_order_relaxed);
+}
+
+// Return the number of slots
+size_t
+FrameRing::get_depth() const
+{
+    return depth;
+}
+
+// PRIVATE FUNCTIONS
+
+/* Find a slot in the given state with the lowest or highest sequence number.
+   Parameters:
+     * state: state of the slot.
+     * newest: true to find the highest sequence number, false to find the
+         lowest.
+   Return the index of the slot, or -1 if there's none.
+*/
+ssize_t
+FrameRing::find(slot_state_t state, bool newest) const
+{
+    ssize_t index = -1;
+    uint64_t best = 0, s;
+
+    for (size_t i = 0; i < depth; i++) {
+        if (slots[i].state.load(memory_order_relaxed) != state)
+            continue;
+        s = slots[i].seq.load(memory_order_relaxed);
+        if (index < 0 || (newest ? s > best : s < best)) {
+            index = i;
+            best = s;
+        }
+    }
+    return index;
+}
+
+/* Give back the buffer lent by the camera that the frame of a slot wraps,
+   if any. The frame is emptied, so a copy is never written in the buffer.
+   Parameters:
+     * index: index of the slot.
+*/
+void
+FrameRing::release(size_t index)
+{
+    if (slots[index].buffer < 0)
+        return;
+    slots[index].frame.release();
+    give_back(owner, slots[index].buffer);
+    slots[index].buffer = -1;
+}
+
+/* Try to change the state of a slot.
+   Parameters:
+     * index: index of the slot.
+     * from: expected current state.
+     * to: new state.
+   Return true if the state has been changed.
+*/
+bool
+FrameRing::transition(size_t index, slot_state_t from, slot_state_t to)
+{
+    int expected = from;
+
+    return slots[index].state.compare_exchange_strong(expected, to,
+        memory_order_acq_rel, memory_order_relaxed);
+}
+
+/* Wait a little, longer as the number of attempts grows.
+   Parameters:
+     * attempt: number of attempts so far (it is incremented).
+*/
+void
+FrameRing::backoff(unsigned int& attempt)
+{
+    struct timespec t = {0, SLEEP_NS};
+
+    if (attempt < SPIN_ATTEMPTS) {
+        // Just try again
+    } else if (attempt < YIELD_ATTEMPTS) {
+        sched_yield();
+    } else {
+        nanosleep(&t, 0);
+    }
+    attempt++;
+}
+
@@ -0,0 +1,174 @@
+/* framering.hpp
+   A lock-free ring of frames between a single producer (the capture thread)
+   and a single consumer (the main loop). Each slot has its own state, that
+   is changed with atomic operations, so neither side ever blocks the other.
+   The frames can wrap buffers lent by the camera instead of copies, they
+   are given back through a function when their slots are reused.
+*/
+
+#ifndef FRAMERING_HPP
+#define FRAMERING_HPP
+
+#include <atomic>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Policy to choose the frame given to the consumer
+typedef enum {
+    // The newest frame, the older ones are dropped
+    FRAME_LATEST,
+    // The oldest frame, the producer waits if the ring is full
+    FRAME_FIFO,
+    // No ring: each frame is fetched from the camera by the consumer when
+    // it asks for it (only for FrameCapture)
+    FRAME_SYNC
+} frame_policy_t;
+
+/* Function that gives back a buffer lent by the camera.
+   Parameters:
+     * owner: the object given to the ring with the function.
+     * buffer: index of the buffer.
+*/
+typedef void (*give_back_t)(void *owner, ssize_t buffer);
+
+// States of a slot of the ring
+typedef enum {
+    SLOT_FREE,
+    SLOT_WRITING,
+    SLOT_READY,
+    SLOT_READING
+} slot_state_t;
+
+// A slot of the ring
+typedef struct {
+    // State of the slot (a slot_state_t)
+    atomic<int> state;
+
+    // Sequence number of the frame (increases with each frame written)
+    atomic<uint64_t> seq;
+
+    // The frame and its capture time
+    Mat frame;
+    struct timespec timestamp;
+
+    // Buffer lent by the camera that the frame wraps (-1 if the frame is a
+    // copy)
+    ssize_t buffer;
+} frame_slot_t;
+
+class FrameRing {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * depth: number of slots (at least 2).
+             * policy: policy to choose the frame given to the consumer.
+             * give_back: function to give back the buffers lent by the
+                 camera (0 if they are never lent).
+             * owner: object passed to give_back.
+        */
+        FrameRing(size_t depth, frame_policy_t policy,
+            give_back_t give_back = 0, void *owner = 0);
+
+        ~FrameRing();
+
+        /* Take a slot to write a new frame in it. With FRAME_LATEST it never
+           waits, with FRAME_FIFO it waits until a slot is free.
+           Return the frame of the slot, or 0 if the ring has been closed.
+        */
+        Mat *begin_write();
+
+        /* Publish the frame written in the slot taken with begin_write.
+           Parameters:
+             * timestamp: capture time of the frame.
+             * buffer: buffer lent by the camera that the frame wraps, or -1
+                 if the frame was copied in the slot.
+        */
+        void end_write(const struct timespec& timestamp, ssize_t buffer = -1);
+
+        /* Give back the frame previously read and wait for the next one,
+           according to the policy.
+           Parameters:
+             * timestamp: output capture time of the frame.
+           Return the frame, that is valid until the next call to read, or 0
+           if the ring has been closed and there are no more frames to read.
+        */
+        Mat *read(struct timespec& timestamp);
+
+        // Close the ring, so that the producer stops
+        void close();
+
+        // Return true if the ring has been closed
+        bool is_closed() const;
+
+        // Return the number of slots
+        size_t get_depth() const;
+
+    private:
+
+        // The slots of the ring
+        frame_slot_t *slots;
+        size_t depth;
+
+        // Policy to choose the frame given to the consumer
+        frame_policy_t policy;
+
+        // Function to give back the buffers lent by the camera, and its
+        // owner
+        give_back_t give_back;
+        void *owner;
+
+        // Sequence numbers of the last frames written and read
+        uint64_t seq;
+        uint64_t read_seq;
+
+        // Slots being written and read (-1 if there's none)
+        ssize_t writing;
+        ssize_t reading;
+
+        // true when the ring has been closed
+        atomic<bool> closed;
+
+        /* Find a slot in the given state with the lowest or highest sequence
+           number.
+           Parameters:
+             * state: state of the slot.
+             * newest: true to find the highest sequence number, false to
+                 find the lowest.
+           Return the index of the slot, or -1 if there's none.
+        */
+        ssize_t find(slot_state_t state, bool newest) const;
+
+        /* Give back the buffer lent by the camera that the frame of a slot
+           wraps, if any.
+           Parameters:
+             * index: index of the slot.
+        */
+        void release(size_t index);
+
+        /* Try to change the state of a slot.
+           Parameters:
+             * index: index of the slot.
+             * from: expected current state.
+             * to: new state.
+           Return true if the state has been changed.
+        */
+        bool transition(size_t index, slot_state_t from, slot_state_t to);
+
+        /* Wait a little, longer as the number of attempts grows.
+           Parameters:
+             * attempt: number of attempts so far (it is incremented).
+        */
+        static void backoff(unsigned int& attempt);
+
+};
+
+#endif
+
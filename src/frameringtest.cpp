@@ -0,0 +1,195 @@
+/* frameringtest.cpp
+   Checks the frame ring with a producer thread and the main thread as the
+   consumer: the FIFO policy gives every frame in order, also the ones left
+   when the ring is closed, the latest policy gives newer frames each time,
+   the lent buffers are given back once, and close wakes up both sides.
+*/
+
+#include <atomic>
+#include <err.h>
+#include <pthread.h>
+#include <time.h>
+#include <vector>
+
+#include "framering.hpp"
+#include "testcheck.hpp"
+
+// Frames written by the producer
+#define NFRAMES     10000
+
+// Slots of the rings
+#define DEPTH       3
+
+// Time that the consumer takes with some frames, so the ring fills (in ns)
+#define SLOW_NS     20000
+
+// A producer thread and the ring it writes to
+typedef struct {
+    FrameRing *ring;
+    // Number of frames to write, and number written so far
+    long nframes;
+    atomic<long> written;
+    // Lend a buffer with each frame, its number
+    bool lend;
+} producer_t;
+
+// Number of times that each buffer has been given back
+vector<int> given_back;
+
+/* Give back a buffer lent to the ring.
+   Parameters:
+     * owner: unused.
+     * buffer: number of the frame that lent it.
+*/
+void
+give_back(void *owner, ssize_t buffer)
+{
+    given_back[buffer]++;
+}
+
+// Write the frames, numbered in their timestamps, and close the ring
+void *
+produce(void *arg)
+{
+    producer_t *producer = (producer_t *)arg;
+    struct timespec t = {0, 0};
+
+    for (long i = 0; i < producer->nframes; i++) {
+        if (!producer->ring->begin_write())
+            return 0;
+        t.tv_nsec = i;
+        producer->ring->end_write(t, producer->lend ? i : -1);
+        producer->written++;
+    }
+    producer->ring->close();
+    return 0;
+}
+
+// Wait a little
+void
+wait_a_little()
+{
+    struct timespec t = {0, SLOW_NS};
+
+    nanosleep(&t, 0);
+}
+
+/* Run a producer and read its frames until the ring is closed.
+   Parameters:
+     * policy: policy of the ring.
+     * lend: lend a buffer with each frame.
+     * frames: output numbers of the frames read.
+*/
+void
+run(frame_policy_t policy, bool lend, vector<long>& frames)
+{
+    struct timespec t;
+    producer_t producer;
+    pthread_t thread;
+    long n = 0;
+
+    given_back.assign(NFRAMES, 0);
+    frames.clear();
+    producer.ring = new FrameRing(DEPTH, policy, lend ? give_back : 0, 0);
+    producer.nframes = NFRAMES;
+    producer.written = 0;
+    producer.lend = lend;
+    pthread_create(&thread, 0, produce, &producer);
+    while (producer.ring->read(t)) {
+        frames.push_back(t.tv_nsec);
+        // Be slow from time to time, the ring is full when it's closed
+        if (++n % 1000 < 10 || n > NFRAMES - 10)
+            wait_a_little();
+    }
+    pthread_join(thread, 0);
+    delete producer.ring;
+}
+
+// Check the FIFO policy
+void
+check_fifo()
+{
+    vector<long> frames;
+
+    run(FRAME_FIFO, false, frames);
+    CHECK(frames.size() == NFRAMES, "fifo: %zu frames read of %d",
+        frames.size(), NFRAMES);
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (frames[i] != (long)i) {
+            CHECK(false, "fifo: frame %ld read in place of %zu", frames[i], i);
+            break;
+        }
+    }
+}
+
+// Check the latest policy, with lent buffers
+void
+check_latest()
+{
+    vector<long> frames;
+
+    run(FRAME_LATEST, true, frames);
+    CHECK(!frames.empty() && frames.back() == NFRAMES - 1,
+        "latest: the last frame written wasn't read");
+    for (size_t i = 1; i < frames.size(); i++) {
+        if (frames[i] <= frames[i - 1]) {
+            CHECK(false, "latest: frame %ld read after %ld", frames[i],
+                frames[i - 1]);
+            break;
+        }
+    }
+    for (size_t i = 0; i < given_back.size(); i++) {
+        if (given_back[i] != 1) {
+            CHECK(false, "latest: buffer %zu given back %d times", i,
+                given_back[i]);
+            break;
+        }
+    }
+}
+
+// Close a ring after a while
+void *
+close_later(void *arg)
+{
+    wait_a_little();
+    ((FrameRing *)arg)->close();
+    return 0;
+}
+
+// Check that close stops a consumer waiting for frames and a producer
+// waiting for a free slot
+void
+check_close()
+{
+    struct timespec t;
+    producer_t producer;
+    pthread_t thread;
+    FrameRing empty(DEPTH, FRAME_FIFO), full(DEPTH, FRAME_FIFO);
+
+    // The consumer waits in an empty ring
+    pthread_create(&thread, 0, close_later, &empty);
+    CHECK(!empty.read(t), "close: frame read from an empty ring");
+    pthread_join(thread, 0);
+
+    // The producer waits in a full ring, that is closed without reading it
+    producer.ring = &full;
+    producer.nframes = NFRAMES;
+    producer.written = 0;
+    producer.lend = false;
+    pthread_create(&thread, 0, produce, &producer);
+    while (producer.written < DEPTH)
+        wait_a_little();
+    full.close();
+    pthread_join(thread, 0);
+    CHECK(producer.written == DEPTH, "close: %ld frames written in %d slots",
+        producer.written.load(), DEPTH);
+}
+
+int
+main(int argc, char **argv)
+{
+    check_fifo();
+    check_latest();
+    check_close();
+    return failures ? 1 : 0;
+}
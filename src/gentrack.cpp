@@ -0,0 +1,86 @@
+
+#include <err.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "followexception.hpp"
+#include "trackfile.hpp"
+
+#define OPTSTRING   "s:h"
+
+// Seed of the random numbers
+unsigned int seed = 1;
+
+// Number of segments of the track
+long nsegments = 0;
+
+// Track file to write
+const char *track_file = 0;
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: follow-gentrack [options ...] SEGMENTS TRACK\n"
+           "Writes the track file TRACK with a random track of SEGMENTS\n"
+           "segments of all the types, which doesn't cross itself.\n"
+           "Options:\n"
+           "  -h, --help                    Show this message and exit.\n"
+           "  -s=SEED, --seed=SEED          Seed of the random numbers, the\n"
+           "                                same seed gives the same\n"
+           "                                track.\n");
+    exit(0);
+}
+
+// Parse the arguments
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"seed", required_argument, 0, 's'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 's':
+                seed = strtoul(optarg, 0, 10);
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+
+    if (optind != argc - 2)
+        errx(1, "missing number of segments or track file");
+    nsegments = atol(argv[optind]);
+    track_file = argv[optind + 1];
+    if (nsegments <= 0)
+        errx(1, "invalid number of segments");
+}
+
+int
+main(int argc, char **argv)
+{
+    vector<segment_t> segments;
+
+    parse_args(argc, argv);
+    try {
+        trackfile::generate(nsegments, seed, segments);
+        trackfile::save(track_file, segments);
+    } catch (FollowException& e) {
+        errx(1, "%s", e.what());
+    }
+
+    return 0;
+}
+
@@ -26,6 +26,15 @@ typedef struct {
     glm::vec2 texcoord;
 } gl_vertex_t;
 
+// A draw of a part of the geometry: its texture, its primitive and its
+// range of the index buffer
+typedef struct {
+    GLint texture;
+    GLenum mode;
+    GLsizei count;
+    GLsizei first;
+} gl_draw_t;
+
 typedef struct {
     GLuint program;
     GLuint vertex_buffer;
@@ -33,6 +42,11 @@ typedef struct {
     GLint u_mvprojection;
     GLint u_texture;
     GLuint tex_index[NUM_TEXTURES];
+    // Vertices and indices of the room and the segments in the buffers, to
+    // build the buffers from them (only while the geometry is initialized,
+    // 0 after, and 0 when the segments only compute their bounding boxes)
+    gl_vertex_t *vertices;
+    GLuint *indices;
 } gl_context_t;
 
 #endif
@@ -0,0 +1,250 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "followexception.hpp"
+#include "groundlut.hpp"
+
+// Minimum sine of the angle of the ray of a pixel below the horizontal, the
+// pixels over it are given the point of the ground at this angle
+#define MIN_RAY_SIN     1e-3
+
+using namespace cv;
+
+/* Constructor. The table is computed and written to the file if it doesn't
+   exist or was computed with other parameters.
+   Parameters:
+     * file: path of the table.
+     * calibration: path of the calibration of the camera, as written by
+           OpenCV (camera_matrix, distortion_coefficients and optionally
+           image_width and image_height, to scale the camera matrix to
+           another size).
+     * cam_params: camera's parameters.
+   Throws FollowException if the calibration can't be read or the table
+   can't be written or mapped.
+*/
+GroundLut::GroundLut(const string& file, const string& calibration,
+    const cam_params_t& cam_params):
+    data(0), length(0), header(0), points(0)
+{
+    ground_lut_header_t params;
+
+    read_calibration(calibration, cam_params, params);
+    if (map(file, params))
+        return;
+    // The processes of a sweep can build the same table at the same time,
+    // if another one wrote it first, it's used
+    try {
+        build(file, params);
+    } catch (FollowException&) {
+        if (map(file, params))
+            return;
+        throw;
+    }
+    if (!map(file, params))
+        throw FollowException(file + " is not a valid ground table");
+}
+
+GroundLut::~GroundLut()
+{
+    if (data)
+        munmap(data, length);
+}
+
+/* Return the lowest row of the image whose center is at a distance of at
+   least y, or -1 if there's none.
+   Parameters:
+     * y: the distance.
+*/
+int
+GroundLut::find_row(float y) const
+{
+    for (int row = header->height - 1; row >= 0; row--) {
+        if (get_row(row)[header->width / 2].y >= y)
+            return row;
+    }
+    return -1;
+}
+
+// PRIVATE FUNCTIONS
+
+/* Compute the table and write it to a file. It's written to a temporary
+   file with a unique name that is renamed at the end, so a process never
+   maps it half written, even if several of them build it at once.
+   Parameters:
+     * file: path of the table.
+     * params: the parameters of the table.
+*/
+void
+GroundLut::build(const string& file, const ground_lut_header_t& params)
+{
+    vector<Point2f> pixels, normalized;
+    vector<ground_point_t> ground;
+    Mat camera_matrix(3, 3, CV_64FC1, (void *)params.camera_matrix);
+    Mat distortion;
+    float s = sin(-params.cam_angle), c = cos(-params.cam_angle);
+    float den, t;
+    string tmp = file + ".XXXXXX";
+    FILE *f;
+    int fd, e;
+
+    if (params.ncoeffs) {
+        distortion = Mat(1, params.ncoeffs, CV_64FC1,
+            (void *)params.distortion);
+    }
+
+    // 1) Undistort the left side of each pixel of each row, with the
+    //    coordinates of OpenCV, where the center of the first pixel is 0
+    pixels.reserve((size_t)(params.width + 1) * params.height);
+    for (uint32_t v = 0; v < params.height; v++) {
+        for (uint32_t u = 0; u <= params.width; u++) {
+            pixels.push_back(Point2f(u - 0.5f, v));
+        }
+    }
+    undistortPoints(pixels, normalized, camera_matrix, distortion);
+
+    // 2) Intersect the ray of each pixel with the ground. The camera looks
+    //    down by -cam_angle, with x to the right and y down in the image.
+    ground.resize(normalized.size());
+    for (size_t i = 0; i < normalized.size(); i++) {
+        den = s + normalized[i].y * c;
+        if (den < MIN_RAY_SIN)
+            den = MIN_RAY_SIN;
+        t = params.cam_z / den;
+        ground[i].x = t * normalized[i].x;
+        ground[i].y = t * (c - normalized[i].y * s);
+    }
+
+    // 3) Write the table
+    if ((fd = mkstemp(&tmp[0])) < 0)
+        throw FollowException("cannot create " + tmp + ": " + strerror(errno));
+    // mkstemp creates it only readable by the user
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (!(f = fdopen(fd, "w"))) {
+        e = errno;
+        close(fd);
+        unlink(tmp.c_str());
+        throw FollowException("cannot open " + tmp + ": " + strerror(e));
+    }
+    fwrite(&params, sizeof(params), 1, f);
+    fwrite(&ground[0], sizeof(ground_point_t), ground.size(), f);
+    if (ferror(f) || fclose(f) != 0) {
+        unlink(tmp.c_str());
+        throw FollowException("cannot write " + tmp);
+    }
+    if (rename(tmp.c_str(), file.c_str()) < 0) {
+        unlink(tmp.c_str());
+        throw FollowException("cannot rename " + tmp + ": " + strerror(errno));
+    }
+}
+
+/* Map the table from a file.
+   Parameters:
+     * file: path of the table.
+     * params: the parameters the table must have been computed with.
+   Return false if the file doesn't exist or has other parameters.
+*/
+bool
+GroundLut::map(const string& file, const ground_lut_header_t& params)
+{
+    struct stat st;
+    void *addr;
+    int fd;
+
+    if ((fd = open(file.c_str(), O_RDONLY)) < 0) {
+        if (errno == ENOENT)
+            return false;
+        throw FollowException("cannot open " + file + ": " + strerror(errno));
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw FollowException("cannot stat " + file + ": " + strerror(errno));
+    }
+    // The whole header is compared, it's written zeroed
+    if ((size_t)st.st_size != sizeof(params) + sizeof(ground_point_t)
+        * (params.width + 1) * params.height)
+    {
+        close(fd);
+        return false;
+    }
+    length = st.st_size;
+    addr = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw FollowException("cannot map " + file + ": " + strerror(errno));
+    }
+    if (memcmp(addr, &params, sizeof(params)) != 0) {
+        munmap(addr, length);
+        return false;
+    }
+    data = (unsigned char *)addr;
+    header = (const ground_lut_header_t *)data;
+    points = (const ground_point_t *)(header + 1);
+    return true;
+}
+
+/* Read the calibration of the camera.
+   Parameters:
+     * calibration: path of the calibration.
+     * cam_params: camera's parameters.
+     * params: output parameters of the table.
+*/
+void
+GroundLut::read_calibration(const string& calibration,
+    const cam_params_t& cam_params, ground_lut_header_t& params)
+{
+    FileStorage fs(calibration, FileStorage::READ);
+    Mat camera_matrix, distortion;
+    int width = 0, height = 0;
+    double scale[3] = {1.0, 1.0, 1.0};
+
+    if (!fs.isOpened())
+        throw FollowException("cannot open " + calibration);
+    fs["camera_matrix"] >> camera_matrix;
+    fs["distortion_coefficients"] >> distortion;
+    if (camera_matrix.rows != 3 || camera_matrix.cols != 3
+        || camera_matrix.type() != CV_64FC1
+        || (!distortion.empty() && (distortion.type() != CV_64FC1
+        || distortion.total() > GROUND_LUT_MAX_COEFFS)))
+    {
+        throw FollowException(calibration + " is not a camera calibration");
+    }
+    if (!fs["image_width"].empty())
+        fs["image_width"] >> width;
+    if (!fs["image_height"].empty())
+        fs["image_height"] >> height;
+    // The camera matrix is scaled if it was calibrated with another size
+    if (width > 0 && height > 0) {
+        scale[0] = (double)cam_params.width / width;
+        scale[1] = (double)cam_params.height / height;
+    }
+
+    // Zeroed, to compare the whole header with the one of the file
+    memset(&params, 0, sizeof(params));
+    memcpy(params.magic, GROUND_LUT_MAGIC, GROUND_LUT_MAGIC_SIZE);
+    params.version = GROUND_LUT_VERSION;
+    params.width = cam_params.width;
+    params.height = cam_params.height;
+    params.cam_z = cam_params.cam_z;
+    params.cam_angle = cam_params.cam_angle;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            params.camera_matrix[i * 3 + j] = scale[i]
+                * camera_matrix.at<double>(i, j);
+        }
+    }
+    params.ncoeffs = distortion.total();
+    for (uint32_t i = 0; i < params.ncoeffs; i++) {
+        params.distortion[i] = distortion.ptr<double>()[i];
+    }
+}
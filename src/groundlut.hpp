@@ -0,0 +1,133 @@
+/* groundlut.hpp
+   Lookup table from the pixels of the camera to the points of the ground,
+   with the lens distortion of a calibrated camera. It's computed once from
+   the calibration file and the camera parameters, and kept in a file that
+   is mapped read only in the next runs, while they don't change. The file
+   has a fixed header, with the parameters it was computed with, followed by
+   the ground points of each row of the image, from the top one. Each row
+   has width + 1 points, for the left side of each pixel and the right side
+   of the last one. All the values are in the byte order of the machine that
+   wrote the file.
+*/
+
+#ifndef GROUNDLUT_HPP
+#define GROUNDLUT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "camparams.hpp"
+
+using namespace std;
+
+// Magic string at the start of the file and version of the layout
+#define GROUND_LUT_MAGIC        "FOLLOWGL"
+#define GROUND_LUT_MAGIC_SIZE   8
+#define GROUND_LUT_VERSION      1
+
+// Maximum number of distortion coefficients (the ones of OpenCV)
+#define GROUND_LUT_MAX_COEFFS   14
+
+// Header of the file
+typedef struct {
+    char magic[GROUND_LUT_MAGIC_SIZE];
+    uint32_t version;
+
+    // Size of the image
+    uint32_t width;
+    uint32_t height;
+
+    // Number of distortion coefficients
+    uint32_t ncoeffs;
+
+    // Height and angle of the camera (as in cam_params_t)
+    float cam_z;
+    float cam_angle;
+
+    // Camera matrix, for the size of the image, and distortion coefficients
+    double camera_matrix[9];
+    double distortion[GROUND_LUT_MAX_COEFFS];
+} ground_lut_header_t;
+
+// Point of the ground (in cm, x to the right and y forward of the robot)
+typedef struct {
+    float x;
+    float y;
+} ground_point_t;
+
+// A ground lookup table mapped in memory
+class GroundLut {
+
+    public:
+
+        /* Constructor. The table is computed and written to the file if it
+           doesn't exist or was computed with other parameters.
+           Parameters:
+             * file: path of the table.
+             * calibration: path of the calibration of the camera, as
+                   written by OpenCV (camera_matrix, distortion_coefficients
+                   and optionally image_width and image_height, to scale the
+                   camera matrix to another size).
+             * cam_params: camera's parameters.
+           Throws FollowException if the calibration can't be read or the
+           table can't be written or mapped.
+        */
+        GroundLut(const string& file, const string& calibration,
+            const cam_params_t& cam_params);
+
+        // Destructor
+        ~GroundLut();
+
+        /* Return the lowest row of the image whose center is at a distance
+           of at least y, or -1 if there's none.
+           Parameters:
+             * y: the distance.
+        */
+        int find_row(float y) const;
+
+        /* Return the ground points of a row of the image.
+           Parameters:
+             * row: the row.
+        */
+        inline const ground_point_t *get_row(size_t row) const {
+            return points + row * (header->width + 1);
+        }
+
+    private:
+
+        // The mapped file
+        unsigned char *data;
+        size_t length;
+
+        // The header and the points
+        const ground_lut_header_t *header;
+        const ground_point_t *points;
+
+        /* Compute the table and write it to a file.
+           Parameters:
+             * file: path of the table.
+             * params: the parameters of the table.
+        */
+        static void build(const string& file,
+            const ground_lut_header_t& params);
+
+        /* Map the table from a file.
+           Parameters:
+             * file: path of the table.
+             * params: the parameters the table must have been computed with.
+           Return false if the file doesn't exist or has other parameters.
+        */
+        bool map(const string& file, const ground_lut_header_t& params);
+
+        /* Read the calibration of the camera.
+           Parameters:
+             * calibration: path of the calibration.
+             * cam_params: camera's parameters.
+             * params: output parameters of the table.
+        */
+        static void read_calibration(const string& calibration,
+            const cam_params_t& cam_params, ground_lut_header_t& params);
+};
+
+#endif
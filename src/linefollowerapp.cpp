@@ -4,35 +4,18 @@
 #include <math.h>
 #include "opencv2/opencv.hpp"
 
-#include "differentialroadfinder.hpp"
+#include "followexception.hpp"
 #include "gpiomotors.hpp"
 #include "linefollowerapp.hpp"
+#include "pipeline.hpp"
 #include "realcamera.hpp"
-#include "ssfapathfinder.hpp"
+#include "replaycamera.hpp"
 #include "utilities.hpp"
 #include "virtualcamera.hpp"
 #include "virtualmotors.hpp"
 
-// Default options
-#define DEFAULT_CAMERA                      "real"
-#define DEFAULT_CAMERA_WIDTH                "640"
-#define DEFAULT_CAMERA_HEIGHT               "480"
-#define DEFAULT_MOTORS                      "real"
-#define DEFAULT_REAL_MOTORS_TYPE            "gpio"
-#define DEFAULT_ROAD_FINDER                 "differential"
-#define DEFAULT_SCANLINES                   "16"
-#define DEFAULT_MIN_DERIVATIVE              "30"
-#define DEFAULT_COLOR_DISTANCE_THRESHOLD    "1200"
-#define DEFAULT_SCANLINES_FRAME             "world"
-#define DEFAULT_PATH_FINDER                 "SSFA"
-#define DEFAULT_PORT                        "10101"
-#define DEFAULT_INACTIVITY_TIMEOUT          "300"
-
 #define NS_PER_SECOND   1000000000
 
-#define MIN_CAMANGLE    -90.0
-#define MAX_CAMANGLE    0.0
-
 #define ROAD_SCALE  4
 #define X_TO_SCR(x) (x * ROAD_SCALE + cam_params.width/2)
 #define Y_TO_SCR(y) (cam_params.height - y * ROAD_SCALE)
@@ -48,21 +31,31 @@
 #define KEY_DOWN    65364
 
 // TODO: Choose the camera when there's more than one
-// TODO: Set real camera resolution
 // TODO: By default read the options from the default configuration file
 
 using namespace utilities;
 
-LineFollowerApp::LineFollowerApp(const char *options_file):
+LineFollowerApp::LineFollowerApp(const char *options_file,
+        const char *record_file):
     virtual_motors(0), real_motors(0), stop_req(false), following(false),
-    speed(0.0), turn(0.0), has_display(getenv("DISPLAY") != NULL)
+    speed(0.0), turn(0.0), motors_speed(0.0), motors_turn(0.0),
+    has_display(getenv("DISPLAY") != NULL)
 {
     map<string, string> defaults;
 
-    set_default_options(defaults);
+    pipeline::set_default_options(defaults);
     options = Options(options_file, defaults);
     command = Command(options);
+    command.set_stats(&stats);
     create_frame_capture();
+    if (record_file) {
+        try {
+            capture.start_recording(record_file,
+                options.get_int("RecordMaxFrames"));
+        } catch (FollowException& e) {
+            errx(1, "cannot record the frames: %s", e.what());
+        }
+    }
     create_motors();
     create_road_finder();
     create_path_finder();
@@ -87,11 +80,9 @@ LineFollowerApp::run()
     if (has_display)
         namedWindow("frame", 1);
 
-    // Fetch the first frame
-    capture.fetch();
-
     while (!stop_req) {
-        inputs(frame);
+        if (!inputs(frame))
+            break;
         processing(frame);
         outputs(frame);
     }
@@ -103,21 +94,15 @@ LineFollowerApp::run()
 void
 LineFollowerApp::create_frame_capture()
 {
-    string camera_type, track_file;
-    float cam_angle;
+    string camera_type, track_file, renderer, replay_file, replay_mode;
+    string frame_policy;
+    bool headless = false;
+    float time_step = 0.0, stream_radius = 0.0;
+    replay_mode_t mode = REPLAY_REALTIME;
+    frame_policy_t policy;
 
     // Load the camera parameters
-    cam_params.width = options.get_int("CameraWidth");
-    cam_params.height = options.get_int("CameraHeight");
-    cam_params.fovh = options.get_float("CameraFovh");
-    cam_params.fovv = options.get_float("CameraFovv");
-    cam_params.cam_z = options.get_float("CameraZ");
-    cam_angle = options.get_float("CameraAngle");
-    if (cam_angle > MAX_CAMANGLE || cam_angle < MIN_CAMANGLE) {
-        errx(1, "camera angle must be between %.1f and %.1f degrees",
-            MIN_CAMANGLE, MAX_CAMANGLE);
-    }
-    cam_params.cam_angle = cam_angle * M_PI / 180.0;
+    pipeline::get_cam_params(options, cam_params);
 
     // Get the camera type and, if virtual, the track file
     camera_type = options.get_string("Camera");
@@ -127,9 +112,69 @@ LineFollowerApp::create_frame_capture()
         } catch (out_of_range) {
             errx(1, "track file not specified");
         }
+        renderer = options.get_string("VirtualRenderer");
+        if (renderer == "headless") {
+            headless = true;
+        } else if (renderer != "x11") {
+            errx(1, "unknown virtual renderer '%s'", renderer.c_str());
+        }
+        // Simulate the time, if a time step is given
+        time_step = options.get_float("SimulationTimeStep") / 1000.0;
+        if (time_step < 0.0)
+            errx(1, "wrong simulation time step");
+        stream_radius = options.get_float("TrackStreamRadius");
+        if (stream_radius < 0.0)
+            errx(1, "wrong track stream radius");
+        // The virtual camera always renders BGRA frames
+        if (cam_params.pixel_format != PIXFMT_BGR) {
+            warnx("camera format ignored with the virtual camera");
+            cam_params.pixel_format = PIXFMT_BGR;
+        }
     }
 
-    capture = FrameCapture(cam_params, camera_type, track_file);
+    // If replay, get the capture file, that gives the frames size and format
+    if (camera_type == "replay") {
+        try {
+            replay_file = options.get_string("ReplayFile");
+        } catch (out_of_range) {
+            errx(1, "replay file not specified");
+        }
+        try {
+            ReplayCamera::get_cam_params(replay_file, cam_params);
+        } catch (FollowException& e) {
+            errx(1, "cannot replay: %s", e.what());
+        }
+        replay_mode = options.get_string("ReplayMode");
+        if (replay_mode == "fast") {
+            mode = REPLAY_FAST;
+        } else if (replay_mode != "realtime") {
+            errx(1, "unknown replay mode '%s'", replay_mode.c_str());
+        }
+    }
+
+    // Get the policy to give the frames to the main loop
+    frame_policy = options.get_string("FramePolicy");
+    if (frame_policy == "latest") {
+        policy = FRAME_LATEST;
+    } else if (frame_policy == "fifo") {
+        policy = FRAME_FIFO;
+    } else if (frame_policy == "sync") {
+        policy = FRAME_SYNC;
+    } else {
+        errx(1, "unknown frame policy '%s'", frame_policy.c_str());
+    }
+    // A fast replay gives all the frames, to get the same result each time
+    if (camera_type == "replay" && mode == REPLAY_FAST)
+        policy = FRAME_FIFO;
+    // A simulation renders each frame when the previous one has been
+    // processed and the motors have moved, so it's the same each time
+    if (time_step > 0.0)
+        policy = FRAME_SYNC;
+
+    capture = FrameCapture(cam_params, camera_type, track_file, headless,
+        time_step, stream_radius, options.get_string("V4L2Device"),
+        options.get_int("V4L2Buffers"), replay_file, mode,
+        options.get_int("FrameQueueDepth"), policy);
     capture.start();
 }
 
@@ -139,13 +184,14 @@ LineFollowerApp::create_motors()
 {
     string motors_types = options.get_string("Motors");
     string real_motors_type;
-    float max_speed, kp, ki, kd;
+    float max_speed, kp, ki, kd, period;
 
     // Read the parameters for the motors pilots
     max_speed = options.get_float("MaxSpeed");
     kp = options.get_float("Kp");
     ki = options.get_float("Ki");
     kd = options.get_float("Kd");
+    period = options.get_float("PIDPeriod") / 1000.0;
 
     if (motors_types == "virtual" || motors_types == "both") {
         // The type of camera must be virtual to use virtual motors
@@ -163,7 +209,7 @@ LineFollowerApp::create_motors()
                     options.get_float("WheelDiameter"));
                 // Create the virtual motors pilot
                 virtual_motors_pilot = Pilot(
-                    virtual_motors, max_speed, kp, ki, kd);
+                    virtual_motors, max_speed, kp, ki, kd, period);
             } catch (exception &e) {
                 warnx("cannot create virtual motors: %s", e.what());
             }
@@ -186,7 +232,8 @@ LineFollowerApp::create_motors()
                     options.get_float("WheelDistance"));
             }
             // Create the real motors pilot
-            real_motors_pilot = Pilot(real_motors, max_speed, kp, ki, kd);
+            real_motors_pilot = Pilot(
+                real_motors, max_speed, kp, ki, kd, period);
         } catch (exception &e) {
             warnx("cannot create real motors: %s", e.what());
         }
@@ -197,32 +244,14 @@ LineFollowerApp::create_motors()
 void
 LineFollowerApp::create_path_finder()
 {
-    string path_finder_type = options.get_string("PathFinder");
-    if (path_finder_type == "SSFA") {
-        path_finder = new SSFAPathFinder();
-    } else {
-        errx(1, "unknown path finder type");
-    }
+    path_finder = pipeline::create_path_finder(options);
 }
 
 // Create the road finder instance
 void
 LineFollowerApp::create_road_finder()
 {
-    scanline_frame_t frame;
-
-    string road_finder_type = options.get_string("RoadFinder");
-    if (road_finder_type == "differential") {
-        frame = (options.get_string("ScanLinesFrame") == "screen") ? SL_SCREEN
-            : SL_WORLD;
-        road_finder = new DifferentialRoadFinder(cam_params,
-            options.get_int("ScanLines"), options.get_int("MinDerivative"),
-            options.get_int("ColorDistanceThreshold"), frame,
-            options.get_float("ScanLinesDistance"),
-            options.get_float("WheelDistance"));
-    } else {
-        errx(1, "unknown road finder type");
-    }
+    road_finder = pipeline::create_road_finder(options, cam_params);
 }
 
 // Draw the path
@@ -268,14 +297,23 @@ LineFollowerApp::draw_road(Mat& frame)
 /* Get the inputs: camera frame.
    Parameters:
      * frame: variable where to write the next camera frame.
+   Return false if there are no more frames.
 */
-void
+bool
 LineFollowerApp::inputs(Mat& frame)
 {
     msg_t cmd;
-
-    frame = capture.next();
-    capture.fetch();
+    struct timespec t0, t1;
+
+    timenow(t0);
+    try {
+        frame = capture.next(timestamp);
+    } catch (FollowException& e) {
+        warnx("%s", e.what());
+        return false;
+    }
+    timenow(t1);
+    stats.add(STAGE_FRAME_WAIT, timediff(t0, t1));
     while (command.get_command(cmd)) {
         switch (cmd.type) {
             case CMD_START: start_motors(); break;
@@ -288,6 +326,7 @@ LineFollowerApp::inputs(Mat& frame)
             default: break;
         }
     }
+    return true;
 }
 
 // Move the motors, either in autonomous or in manual mode.
@@ -297,6 +336,8 @@ LineFollowerApp::move_motors()
     msg_t evt;
     bool moved = false;
 
+    motors_speed = 0.0;
+    motors_turn = 0.0;
     if (following) {
         // Autonomous mode, let pilot do its thing.
         // The input to the pilot is the angle between the current direction
@@ -305,9 +346,20 @@ LineFollowerApp::move_motors()
         // TODO: See why point 0 and point 1 are the same
         glm::vec2 v = glm::normalize(path[2] - path[0]);
         if (virtual_motors)
-            virtual_motors_pilot.set_angle(-v[0]);
+            virtual_motors_pilot.set_angle(-v[0], road.get_timestamp());
         if (real_motors)
-            real_motors_pilot.set_angle(-v[0]);
+            real_motors_pilot.set_angle(-v[0], road.get_timestamp());
+        // Record the glass-to-motor latency and the command given (of the
+        // real motors, if any)
+        if (real_motors) {
+            stats.add(STAGE_LATENCY, real_motors_pilot.get_latency());
+            motors_speed = real_motors_pilot.get_speed();
+            motors_turn = real_motors_pilot.get_turn();
+        } else if (virtual_motors) {
+            stats.add(STAGE_LATENCY, virtual_motors_pilot.get_latency());
+            motors_speed = virtual_motors_pilot.get_speed();
+            motors_turn = virtual_motors_pilot.get_turn();
+        }
     } else {
         // Manual mode, move the motors the given amount in the command and
         // send back an event of confirmation
@@ -320,6 +372,8 @@ LineFollowerApp::move_motors()
             moved = true;
         }
         if (moved) {
+            motors_speed = speed;
+            motors_turn = turn;
             evt.type = EVT_MOVED;
             evt.speed = speed;
             evt.turn = turn;
@@ -335,20 +389,44 @@ LineFollowerApp::move_motors()
 void
 LineFollowerApp::outputs(Mat& frame)
 {
+    struct timespec t0, t1, t2;
+
+    timenow(t0);
+    move_motors();
+    // The road finder predicts the road of the next frame with the motion
+    road_finder->set_motors(motors_speed, motors_turn);
+    timenow(t1);
+    // Send the road and path to the possible subscriptors
+    command.send_data(road, path);
+    timenow(t2);
+    stats.add(STAGE_MOTORS, timediff(t0, t1));
+    stats.add(STAGE_TELEMETRY, timediff(t1, t2));
+
+    // Record the frame before it's drawn on
+    capture.record(motors_speed, motors_turn);
+
     if (has_display) {
-        draw_road(frame);
-        draw_path(frame);
+        // The YUV frames are only converted to be shown
+        switch (cam_params.pixel_format) {
+            case PIXFMT_YUYV:
+                cvtColor(frame, display_frame, COLOR_YUV2BGR_YUYV);
+                break;
+            case PIXFMT_NV12:
+                cvtColor(frame, display_frame, COLOR_YUV2BGR_NV12);
+                break;
+            default:
+                display_frame = frame;
+                break;
+        }
+        draw_road(display_frame);
+        draw_path(display_frame);
         // This is necessary to show the window
         cv::waitKey(1);
-        imshow("frame", frame);
+        imshow("frame", display_frame);
     }
 
     // Print the fps
     //printfps(1);
-
-    move_motors();
-    // Send the road and path to the possible subscriptors
-    command.send_data(road, path);
 }
 
 /* Process the current frame.
@@ -358,30 +436,15 @@ LineFollowerApp::outputs(Mat& frame)
 void
 LineFollowerApp::processing(Mat& frame)
 {
-    road_finder->find(frame, road);
-    path_finder->find(road, path);
-}
+    struct timespec t0, t1, t2;
 
-/* Set the default options.
-   Parameters:
-     * defaults: map where to put the default options.
-*/
-void
-LineFollowerApp::set_default_options(map<string, string>& defaults)
-{
-    defaults["Camera"] = DEFAULT_CAMERA;
-    defaults["CameraWidth"] = DEFAULT_CAMERA_WIDTH;
-    defaults["CameraHeight"] = DEFAULT_CAMERA_HEIGHT;
-    defaults["Motors"] = DEFAULT_MOTORS;
-    defaults["RealMotorsType"] = DEFAULT_REAL_MOTORS_TYPE;
-    defaults["RoadFinder"] = DEFAULT_ROAD_FINDER;
-    defaults["ScanLines"] = DEFAULT_SCANLINES;
-    defaults["MinDerivative"] = DEFAULT_MIN_DERIVATIVE;
-    defaults["ColorDistanceThreshold"] = DEFAULT_COLOR_DISTANCE_THRESHOLD;
-    defaults["ScanLinesFrame"] = DEFAULT_SCANLINES_FRAME;
-    defaults["PathFinder"] = DEFAULT_PATH_FINDER;
-    defaults["Port"] = DEFAULT_PORT;
-    defaults["InactivityTimeout"] = DEFAULT_INACTIVITY_TIMEOUT;
+    timenow(t0);
+    road_finder->find(frame, timestamp, road);
+    timenow(t1);
+    path_finder->find(road, path);
+    timenow(t2);
+    stats.add(STAGE_ROAD, timediff(t0, t1));
+    stats.add(STAGE_PATH, timediff(t1, t2));
 }
 
 // Start the motors (switch to autonomous mode)
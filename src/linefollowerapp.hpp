@@ -15,6 +15,7 @@
 #include "pilot.hpp"
 #include "road.hpp"
 #include "roadfinder.hpp"
+#include "stats.hpp"
 #include "virtualtrack.hpp"
 
 using namespace cv;
@@ -27,8 +28,10 @@ class LineFollowerApp {
         /* Constructor.
            Parameters:
              * config: name of the configuration file.
+             * record_file: capture file where to record the frames (0 to
+                 not record them).
         */
-        LineFollowerApp(const char *options_file);
+        LineFollowerApp(const char *options_file, const char *record_file);
 
         ~LineFollowerApp();
 
@@ -76,9 +79,22 @@ class LineFollowerApp {
         float speed;
         float turn;
 
+        // Command given to the motors for the current frame
+        float motors_speed;
+        float motors_turn;
+
         // Flag that tells if there's display or not
         bool has_display;
 
+        // Frame shown in the display (converted to BGR if necessary)
+        Mat display_frame;
+
+        // Capture time of the current frame
+        struct timespec timestamp;
+
+        // Timing statistics of the stages of the main loop
+        Stats stats;
+
         // PRIVATE METHODS
 
         // Create the frame capture instance
@@ -99,8 +115,9 @@ class LineFollowerApp {
         // Draw the road
         void draw_road(Mat& frame);
 
-        // Get the inputs: camera frame
-        void inputs(Mat& frame);
+        // Get the inputs: camera frame. Return false if there are no more
+        // frames.
+        bool inputs(Mat& frame);
 
         // Move the motors, either in autonomous or in manual mode.
         void move_motors();
@@ -114,12 +131,6 @@ class LineFollowerApp {
         // Process the current frame
         void processing(Mat& frame);
 
-        /* Set the default options.
-           Parameters:
-             * defaults: map where to put the default options.
-        */
-        void set_default_options(map<string, string>& defaults);
-
         // Start the motors (switch to autonomous mode)
         void start_motors();
 
@@ -6,7 +6,7 @@
 
 #include "linefollowerapp.hpp"
 
-#define OPTSTRING   "c:dhv"
+#define OPTSTRING   "c:dhr:v"
 
 // TODO: Daemonize
 // TODO: Capture signals to exit gracefully
@@ -16,6 +16,9 @@
 // Configuration file
 const char *config_file = 0;
 
+// Capture file where to record the frames
+const char *record_file = 0;
+
 // Daemonize or not this process
 bool is_daemon = false;
 
@@ -28,7 +31,8 @@ print_help()
            "  -h, --help                    Show this message and exit.\n"
            "  -v, --version                 Show version information\n."
            "  -c=CONFIG, --config=CONFIG    Give the configuration file.\n"
-           "  -d, --daemonize               Daemonize this process.\n\n"
+           "  -d, --daemonize               Daemonize this process.\n"
+           "  -r=FILE, --record=FILE        Record the frames to FILE.\n\n"
 
            "Antonio Serrano Hernandez (toni.serranoh@gmail.com)\n");
     exit(0);
@@ -52,6 +56,7 @@ parse_args(int argc, char **argv)
         {"version", no_argument, 0, 'v'},
         {"config", required_argument, 0, 'c'},
         {"daemonize", no_argument, 0, 'd'},
+        {"record", required_argument, 0, 'r'},
         {0, 0, 0, 0}
     };
     int o;
@@ -66,6 +71,9 @@ parse_args(int argc, char **argv)
             case 'c':
                 config_file = optarg;
                 break;
+            case 'r':
+                record_file = optarg;
+                break;
             case 'd':
                 is_daemon = true;
             case '?':
@@ -93,7 +101,7 @@ main(int argc, char **argv)
     if (is_daemon) {
         daemonize();
     }
-    LineFollowerApp a(config_file);
+    LineFollowerApp a(config_file, record_file);
     a.run();
     return 0;
 }
@@ -0,0 +1,174 @@
+
+#include <err.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "assetpack.hpp"
+
+#define OPTSTRING   "h"
+
+// An asset to write to the pack
+typedef struct {
+    asset_entry_t entry;
+    vector<unsigned char> data;
+} asset_t;
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: follow-mkpack [options ...] PACK FILE[=WIDTHxHEIGHT] ...\n"
+           "Writes the asset pack PACK with the given files. The files with\n"
+           "a size are RGB textures, and their mip levels are added when\n"
+           "both sides are powers of two. The other files, like the shaders,\n"
+           "are added as they are.\n"
+           "Options:\n"
+           "  -h, --help                    Show this message and exit.\n");
+    exit(0);
+}
+
+// Parse the arguments
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+
+    if (optind > argc - 2)
+        errx(1, "missing pack or files");
+}
+
+/* Read a file.
+   Parameters:
+     * file: path of the file.
+     * data: returned contents.
+*/
+void
+read_file(const char *file, vector<unsigned char>& data)
+{
+    unsigned char buf[BUFSIZ];
+    FILE *f;
+    size_t r;
+
+    if (!(f = fopen(file, "r")))
+        err(1, "cannot open %s", file);
+    data.clear();
+    while ((r = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + r);
+    }
+    if (ferror(f))
+        err(1, "cannot read %s", file);
+    fclose(f);
+}
+
+/* Load an asset.
+   Parameters:
+     * arg: the file, with its size if it's a texture (FILE=WIDTHxHEIGHT).
+     * asset: returned asset.
+*/
+void
+load_asset(const char *arg, asset_t& asset)
+{
+    string file(arg);
+    size_t sep = file.find('=');
+    unsigned int w, h;
+    char c;
+
+    memset(&asset.entry, 0, sizeof(asset.entry));
+    if (sep != string::npos) {
+        if (sscanf(file.c_str() + sep + 1, "%ux%u%c", &w, &h, &c) != 2
+            || !w || !h)
+        {
+            errx(1, "invalid size in %s", arg);
+        }
+        file.erase(sep);
+    }
+    read_file(file.c_str(), asset.data);
+
+    string name = basename((char *)file.c_str());
+    if (name.size() >= ASSET_NAME_SIZE)
+        errx(1, "name too long: %s", name.c_str());
+    strcpy(asset.entry.name, name.c_str());
+
+    if (sep == string::npos) {
+        // The null byte at the end, to use the shaders as strings
+        asset.data.push_back(0);
+    } else {
+        if (asset.data.size() != (size_t)w * h * 3)
+            errx(1, "%s is not a %ux%u RGB texture", file.c_str(), w, h);
+        asset.entry.width = w;
+        asset.entry.height = h;
+        asset.entry.levels = AssetPack::add_levels(asset.data, w, h);
+    }
+    asset.entry.size = asset.data.size();
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *pack_file;
+    vector<asset_t> assets;
+    asset_header_t header;
+    uint64_t offset;
+    size_t pad;
+    FILE *f;
+    static const unsigned char zeros[ASSET_ALIGNMENT] = {0};
+
+    parse_args(argc, argv);
+    pack_file = argv[optind];
+    assets.resize(argc - optind - 1);
+    for (size_t i = 0; i < assets.size(); i++) {
+        load_asset(argv[optind + 1 + i], assets[i]);
+    }
+
+    // The data of the assets after the header and the entries, aligned
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_MAGIC, ASSET_MAGIC_SIZE);
+    header.version = ASSET_VERSION;
+    header.nassets = assets.size();
+    offset = sizeof(header) + assets.size() * sizeof(asset_entry_t);
+    for (size_t i = 0; i < assets.size(); i++) {
+        if (offset % ASSET_ALIGNMENT)
+            offset += ASSET_ALIGNMENT - offset % ASSET_ALIGNMENT;
+        assets[i].entry.offset = offset;
+        offset += assets[i].entry.size;
+    }
+
+    if (!(f = fopen(pack_file, "w")))
+        err(1, "cannot create %s", pack_file);
+    offset = sizeof(header) + assets.size() * sizeof(asset_entry_t);
+    fwrite(&header, sizeof(header), 1, f);
+    for (size_t i = 0; i < assets.size(); i++) {
+        fwrite(&assets[i].entry, sizeof(asset_entry_t), 1, f);
+    }
+    for (size_t i = 0; i < assets.size(); i++) {
+        pad = assets[i].entry.offset - offset;
+        fwrite(zeros, 1, pad, f);
+        fwrite(&assets[i].data[0], 1, assets[i].data.size(), f);
+        offset = assets[i].entry.offset + assets[i].entry.size;
+    }
+    if (ferror(f) || fclose(f) != 0)
+        err(1, "cannot write %s", pack_file);
+
+    return 0;
+}
+
@@ -1,5 +1,6 @@
 
 #include "motors.hpp"
+#include "utilities.hpp"
 
 /* Constructor.
    Params:
@@ -12,6 +13,17 @@ Motors::Motors(float wheel_distance):
 Motors::~Motors()
 {}
 
+/* Get the current time of the clock the motors move with (the monotonic
+   clock, the one used for the frames timestamps).
+   Parameters:
+     * t: the output current time.
+*/
+void
+Motors::get_time(struct timespec& t)
+{
+    utilities::timenow(t);
+}
+
 /* Make sure that the speeds are no greater than 1.0.
    At exit, the speeds s1 and s2 ar less or equal than 1.0 and their
    ratio is the same as at the input.
@@ -2,6 +2,8 @@
 #ifndef MOTORS_HPP
 #define MOTORS_HPP
 
+#include <time.h>
+
 class Motors {
 
     public:
@@ -14,6 +16,13 @@ class Motors {
 
         virtual ~Motors();
 
+        /* Get the current time of the clock the motors move with (the
+           monotonic clock, the one used for the frames timestamps).
+           Parameters:
+             * t: the output current time.
+        */
+        virtual void get_time(struct timespec& t);
+
         /* Move the motors by an arc.
            Parameters:
              * speed: mean speed (0.0 is no movement and 1.0 is max speed).
@@ -64,3 +64,15 @@ Options::get_string(const string& option) const
     }
 }
 
+/* Set the value of an option, replacing the one of the file or the default
+   one.
+   Parameters:
+     * option: name of the option.
+     * value: the new value.
+*/
+void
+Options::set(const string& option, const string& value)
+{
+    options[option] = value;
+}
+
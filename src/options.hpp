@@ -28,6 +28,14 @@ class Options {
         // Get the value of an option as string
         const string& get_string(const string& option) const;
 
+        /* Set the value of an option, replacing the one of the file or the
+           default one.
+           Parameters:
+             * option: name of the option.
+             * value: the new value.
+        */
+        void set(const string& option, const string& value);
+
     private:
 
         map<string, string> options;
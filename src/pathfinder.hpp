@@ -13,6 +13,8 @@ class PathFinder {
 
     public:
 
+        virtual ~PathFinder() {}
+
         /* Find an optimal path along the road.
            Parameters:
              * road: the road where to find the path.
@@ -3,6 +3,15 @@
 
 #include <stdio.h>
 
+#include "utilities.hpp"
+
+// Limits of the time between frames, relative to the period. They avoid
+// huge corrections after a stall or with two frames too close.
+#define MIN_DT  0.1
+#define MAX_DT  10.0
+
+using namespace utilities;
+
 Pilot::Pilot()
 {}
 
@@ -13,29 +22,77 @@ Pilot::Pilot()
      * kp: PID proportional constant.
      * ki: PID integrative constant.
      * kd: PID derivative constant.
+     * period: time between frames for which the PID constants are adjusted
+         (in s).
 */
-Pilot::Pilot(Motors *motors, float max_speed, float kp, float ki, float kd):
+Pilot::Pilot(Motors *motors, float max_speed, float kp, float ki, float kd,
+        float period):
     motors(motors), max_speed(max_speed), kp(kp), ki(ki), kd(kd),
-    sum_angle(0.0), prev_angle(0.0)
-{}
+    period(period), sum_angle(0.0), prev_angle(0.0), latency(0.0),
+    speed(0.0), turn(0.0)
+{
+    prev_timestamp.tv_sec = 0;
+    prev_timestamp.tv_nsec = 0;
+}
+
+// Return the time from the capture of the last frame until the motors were
+// moved (in s)
+float
+Pilot::get_latency() const
+{
+    return latency;
+}
+
+// Return the speed given to the motors the last time
+float
+Pilot::get_speed() const
+{
+    return speed;
+}
+
+// Return the turn given to the motors the last time
+float
+Pilot::get_turn() const
+{
+    return turn;
+}
 
 /* Set the new angle that the vehicle must turn.
    Parameters:
      * angle: the angle to turn.
+     * timestamp: capture time of the frame where the angle was found.
 */
 void
-Pilot::set_angle(float angle)
+Pilot::set_angle(float angle, const struct timespec& timestamp)
 {
-    float turn;
+    float dt = 1.0;
+    struct timespec now;
+
+    // Time elapsed since the previous frame, relative to the period. With
+    // frames arriving at the period the PID behaves as if dt were ignored.
+    if (prev_timestamp.tv_sec || prev_timestamp.tv_nsec) {
+        dt = timediff(prev_timestamp, timestamp) / period;
+        if (dt < MIN_DT)
+            dt = MIN_DT;
+        else if (dt > MAX_DT)
+            dt = MAX_DT;
+    }
 
     // Calculate the turn value to use for the motors (PID formula)
-    turn = kp*angle + ki*sum_angle + kd*(angle - prev_angle);
+    turn = kp*angle + ki*sum_angle + kd*(angle - prev_angle)/dt;
 
     // Give the order to the motors
-    motors->move(max_speed, turn);
+    speed = max_speed;
+    motors->move(speed, turn);
+
+    // Measure the time since the frame was captured, in the clock of the
+    // motors, that is the clock of the frames
+    motors->get_time(now);
+    latency = timediff(timestamp, now);
 
     // Update the PID state
-    sum_angle += angle;
+    sum_angle += angle*dt;
     prev_angle = angle;
+    prev_timestamp = timestamp;
 }
 
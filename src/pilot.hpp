@@ -2,6 +2,8 @@
 #ifndef PILOT_HPP
 #define PILOT_HPP
 
+#include <time.h>
+
 #include "motors.hpp"
 
 class Pilot {
@@ -17,14 +19,29 @@ class Pilot {
              * kp: PID proportional constant.
              * ki: PID integrative constant.
              * kd: PID derivative constant.
+             * period: time between frames for which the PID constants are
+                 adjusted (in s).
         */
-        Pilot(Motors *motors, float max_speed, float kp, float ki, float kd);
+        Pilot(Motors *motors, float max_speed, float kp, float ki, float kd,
+            float period);
+
+        // Return the time from the capture of the last frame until the
+        // motors were moved (in s)
+        float get_latency() const;
+
+        // Return the speed given to the motors the last time
+        float get_speed() const;
+
+        // Return the turn given to the motors the last time
+        float get_turn() const;
 
         /* Set the new angle that the vehicle must turn.
            Parameters:
              * angle: the angle to turn.
+             * timestamp: capture time of the frame where the angle was
+                 found.
         */
-        void set_angle(float angle);
+        void set_angle(float angle, const struct timespec& timestamp);
 
     private:
 
@@ -39,9 +56,20 @@ class Pilot {
         float ki;
         float kd;
 
+        // Time between frames for which the PID constants are adjusted
+        float period;
+
         // State of the PID algorithm
         float sum_angle;
         float prev_angle;
+        struct timespec prev_timestamp;
+
+        // Time from the capture of the last frame until the motors were moved
+        float latency;
+
+        // Last speed and turn given to the motors
+        float speed;
+        float turn;
 
 };
 
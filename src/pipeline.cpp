@@ -0,0 +1,195 @@
+
+#include <err.h>
+#include <math.h>
+
+#include "differentialroadfinder.hpp"
+#include "followexception.hpp"
+#include "pipeline.hpp"
+#include "ssfapathfinder.hpp"
+
+// Default options
+#define DEFAULT_CAMERA                      "real"
+#define DEFAULT_CAMERA_WIDTH                "640"
+#define DEFAULT_CAMERA_HEIGHT               "480"
+#define DEFAULT_CAMERA_FORMAT               "bgr"
+#define DEFAULT_CAMERA_CALIBRATION          ""
+#define DEFAULT_GROUND_LUT_FILE             "ground.lut"
+#define DEFAULT_VIRTUAL_RENDERER            "x11"
+#define DEFAULT_SIMULATION_TIME_STEP        "0"
+#define DEFAULT_TRACK_STREAM_RADIUS         "0"
+#define DEFAULT_V4L2_DEVICE                 "/dev/video0"
+#define DEFAULT_V4L2_BUFFERS                "4"
+#define DEFAULT_FRAME_QUEUE_DEPTH           "3"
+#define DEFAULT_FRAME_POLICY                "latest"
+#define DEFAULT_RECORD_MAX_FRAMES           "18000"
+#define DEFAULT_REPLAY_MODE                 "realtime"
+#define DEFAULT_MOTORS                      "real"
+#define DEFAULT_REAL_MOTORS_TYPE            "gpio"
+#define DEFAULT_ROAD_FINDER                 "differential"
+#define DEFAULT_SCANLINES                   "16"
+#define DEFAULT_MIN_DERIVATIVE              "30"
+#define DEFAULT_COLOR_DISTANCE_THRESHOLD    "1200"
+#define DEFAULT_SCANLINES_FRAME             "world"
+#define DEFAULT_SCANLINES_BUDGET            "0"
+#define DEFAULT_EDGE_KERNEL                 "auto"
+#define DEFAULT_ROAD_FINDER_THREADS         "1"
+#define DEFAULT_ROAD_TRACKING_MARGIN        "0"
+#define DEFAULT_ROAD_TRACKING_SPEED         "0"
+#define DEFAULT_PATH_FINDER                 "SSFA"
+#define DEFAULT_PID_PERIOD                  "33"
+#define DEFAULT_PORT                        "10101"
+#define DEFAULT_INACTIVITY_TIMEOUT          "300"
+
+#define MIN_CAMANGLE    -90.0
+#define MAX_CAMANGLE    0.0
+
+#define S_PER_MIN       60
+
+/* Create the path finder given in the options.
+   Parameters:
+     * options: options of the application.
+   Exits with an error message if the path finder is unknown.
+*/
+PathFinder *
+pipeline::create_path_finder(const Options& options)
+{
+    string path_finder_type = options.get_string("PathFinder");
+    if (path_finder_type == "SSFA") {
+        return new SSFAPathFinder();
+    }
+    errx(1, "unknown path finder type");
+}
+
+/* Create the road finder given in the options.
+   Parameters:
+     * options: options of the application.
+     * cam_params: camera parameters.
+   Exits with an error message if the road finder is unknown or cannot be
+   created.
+*/
+RoadFinder *
+pipeline::create_road_finder(const Options& options,
+    const cam_params_t& cam_params)
+{
+    scanline_frame_t frame;
+    float tracking_margin, max_speed = 0.0;
+    string motors;
+    int threads;
+
+    string road_finder_type = options.get_string("RoadFinder");
+    if (road_finder_type == "differential") {
+        frame = (options.get_string("ScanLinesFrame") == "screen") ? SL_SCREEN
+            : SL_WORLD;
+        try {
+            threads = options.get_int("RoadFinderThreads");
+            if (threads < 0)
+                errx(1, "the road finder threads can't be negative");
+            // The road is tracked with the speed of the robot at max speed,
+            // the one of the virtual motors if they move the camera
+            tracking_margin = options.get_float("RoadTrackingMargin");
+            motors = options.get_string("Motors");
+            if (tracking_margin > 0.0) {
+                max_speed = options.get_float("RoadTrackingSpeed");
+                if (max_speed <= 0.0
+                    && options.get_string("Camera") == "virtual"
+                    && (motors == "virtual" || motors == "both"))
+                {
+                    max_speed = options.get_float("VirtualMotorsRpm") * M_PI
+                        * options.get_float("WheelDiameter") / S_PER_MIN;
+                } else if (max_speed <= 0.0) {
+                    errx(1, "RoadTrackingSpeed is needed to track the road "
+                        "without virtual motors");
+                }
+            }
+            return new DifferentialRoadFinder(cam_params,
+                options.get_string("CameraCalibration"),
+                options.get_string("GroundLutFile"),
+                options.get_int("ScanLines"), options.get_int("MinDerivative"),
+                options.get_int("ColorDistanceThreshold"), frame,
+                options.get_float("ScanLinesDistance"),
+                options.get_int("ScanLinesBudget"),
+                options.get_float("WheelDistance"),
+                options.get_string("EdgeKernel"), threads, tracking_margin,
+                max_speed);
+        } catch (FollowException& e) {
+            errx(1, "cannot create road finder: %s", e.what());
+        }
+    }
+    errx(1, "unknown road finder type");
+}
+
+/* Load the camera parameters from the options.
+   Parameters:
+     * options: options of the application.
+     * cam_params: output camera parameters.
+   Exits with an error message if any of the parameters is invalid.
+*/
+void
+pipeline::get_cam_params(const Options& options, cam_params_t& cam_params)
+{
+    string camera_format;
+    float cam_angle;
+
+    cam_params.width = options.get_int("CameraWidth");
+    cam_params.height = options.get_int("CameraHeight");
+    cam_params.fovh = options.get_float("CameraFovh");
+    cam_params.fovv = options.get_float("CameraFovv");
+    cam_params.cam_z = options.get_float("CameraZ");
+    cam_angle = options.get_float("CameraAngle");
+    if (cam_angle > MAX_CAMANGLE || cam_angle < MIN_CAMANGLE) {
+        errx(1, "camera angle must be between %.1f and %.1f degrees",
+            MIN_CAMANGLE, MAX_CAMANGLE);
+    }
+    cam_params.cam_angle = cam_angle * M_PI / 180.0;
+    camera_format = options.get_string("CameraFormat");
+    if (camera_format == "bgr") {
+        cam_params.pixel_format = PIXFMT_BGR;
+    } else if (camera_format == "yuyv") {
+        cam_params.pixel_format = PIXFMT_YUYV;
+    } else if (camera_format == "nv12") {
+        cam_params.pixel_format = PIXFMT_NV12;
+    } else {
+        errx(1, "unknown camera format '%s'", camera_format.c_str());
+    }
+}
+
+/* Set the default options.
+   Parameters:
+     * defaults: map where to put the default options.
+*/
+void
+pipeline::set_default_options(map<string, string>& defaults)
+{
+    defaults["Camera"] = DEFAULT_CAMERA;
+    defaults["CameraWidth"] = DEFAULT_CAMERA_WIDTH;
+    defaults["CameraHeight"] = DEFAULT_CAMERA_HEIGHT;
+    defaults["CameraFormat"] = DEFAULT_CAMERA_FORMAT;
+    defaults["CameraCalibration"] = DEFAULT_CAMERA_CALIBRATION;
+    defaults["GroundLutFile"] = DEFAULT_GROUND_LUT_FILE;
+    defaults["VirtualRenderer"] = DEFAULT_VIRTUAL_RENDERER;
+    defaults["SimulationTimeStep"] = DEFAULT_SIMULATION_TIME_STEP;
+    defaults["TrackStreamRadius"] = DEFAULT_TRACK_STREAM_RADIUS;
+    defaults["V4L2Device"] = DEFAULT_V4L2_DEVICE;
+    defaults["V4L2Buffers"] = DEFAULT_V4L2_BUFFERS;
+    defaults["FrameQueueDepth"] = DEFAULT_FRAME_QUEUE_DEPTH;
+    defaults["FramePolicy"] = DEFAULT_FRAME_POLICY;
+    defaults["RecordMaxFrames"] = DEFAULT_RECORD_MAX_FRAMES;
+    defaults["ReplayMode"] = DEFAULT_REPLAY_MODE;
+    defaults["Motors"] = DEFAULT_MOTORS;
+    defaults["RealMotorsType"] = DEFAULT_REAL_MOTORS_TYPE;
+    defaults["RoadFinder"] = DEFAULT_ROAD_FINDER;
+    defaults["ScanLines"] = DEFAULT_SCANLINES;
+    defaults["MinDerivative"] = DEFAULT_MIN_DERIVATIVE;
+    defaults["ColorDistanceThreshold"] = DEFAULT_COLOR_DISTANCE_THRESHOLD;
+    defaults["ScanLinesFrame"] = DEFAULT_SCANLINES_FRAME;
+    defaults["ScanLinesBudget"] = DEFAULT_SCANLINES_BUDGET;
+    defaults["EdgeKernel"] = DEFAULT_EDGE_KERNEL;
+    defaults["RoadFinderThreads"] = DEFAULT_ROAD_FINDER_THREADS;
+    defaults["RoadTrackingMargin"] = DEFAULT_ROAD_TRACKING_MARGIN;
+    defaults["RoadTrackingSpeed"] = DEFAULT_ROAD_TRACKING_SPEED;
+    defaults["PathFinder"] = DEFAULT_PATH_FINDER;
+    defaults["PIDPeriod"] = DEFAULT_PID_PERIOD;
+    defaults["Port"] = DEFAULT_PORT;
+    defaults["InactivityTimeout"] = DEFAULT_INACTIVITY_TIMEOUT;
+}
+
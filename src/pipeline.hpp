@@ -0,0 +1,56 @@
+/* pipeline.hpp
+   Functions that build the vision pipeline (camera parameters, road finder
+   and path finder) from the options, shared by the line follower and by the
+   tools that run the pipeline offline.
+*/
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <map>
+#include <string>
+
+#include "camparams.hpp"
+#include "options.hpp"
+#include "pathfinder.hpp"
+#include "roadfinder.hpp"
+
+using namespace std;
+
+namespace pipeline {
+
+    /* Create the path finder given in the options.
+       Parameters:
+         * options: options of the application.
+       Exits with an error message if the path finder is unknown.
+    */
+    PathFinder *create_path_finder(const Options& options);
+
+    /* Create the road finder given in the options.
+       Parameters:
+         * options: options of the application.
+         * cam_params: camera parameters.
+       Exits with an error message if the road finder is unknown or cannot be
+       created.
+    */
+    RoadFinder *create_road_finder(const Options& options,
+        const cam_params_t& cam_params);
+
+    /* Load the camera parameters from the options.
+       Parameters:
+         * options: options of the application.
+         * cam_params: output camera parameters.
+       Exits with an error message if any of the parameters is invalid.
+    */
+    void get_cam_params(const Options& options, cam_params_t& cam_params);
+
+    /* Set the default options.
+       Parameters:
+         * defaults: map where to put the default options.
+    */
+    void set_default_options(map<string, string>& defaults);
+
+}
+
+#endif
+
@@ -1,21 +1,59 @@
 
+#include <string.h>
+
 #include "realcamera.hpp"
+#include "utilities.hpp"
 
 // TODO: Use FollowException
 
-RealCamera::RealCamera():
-    c(0)
+/* Constructor.
+   Parameters:
+     * cam_params: camera's parameters. The resolution and the pixel format
+         are requested to the camera. With PIXFMT_YUYV or PIXFMT_NV12 the
+         frames are the raw buffers of the camera, without any color
+         conversion.
+*/
+RealCamera::RealCamera(const cam_params_t& cam_params):
+    c(0), pixel_format(cam_params.pixel_format)
 {
     size_t h, w;
 
     if(!c.isOpened())
         throw CAM_OPEN_ERROR;
 
+    // Request the resolution and, for the raw formats, the pixel format
+    c.set(CV_CAP_PROP_FRAME_WIDTH, cam_params.width);
+    c.set(CV_CAP_PROP_FRAME_HEIGHT, cam_params.height);
+    if (pixel_format != PIXFMT_BGR) {
+        if (!c.set(CV_CAP_PROP_FOURCC, (pixel_format == PIXFMT_YUYV)
+            ? CV_FOURCC('Y', 'U', 'Y', 'V') : CV_FOURCC('N', 'V', '1', '2')))
+        {
+            throw CAM_FORMAT_ERROR;
+        }
+        // Don't let OpenCV convert the frames to BGR
+        if (!c.set(CV_CAP_PROP_CONVERT_RGB, 0))
+            throw CAM_FORMAT_ERROR;
+    }
+
     // Create the front and back frames
     h = get_height();
     w = get_width();
-    front_buffer = Mat(h, w, CV_8UC3);
-    back_buffer = Mat(h, w, CV_8UC3);
+    switch (pixel_format) {
+        case PIXFMT_YUYV:
+            // Two bytes per pixel
+            front_buffer = Mat(h, w, CV_8UC2);
+            back_buffer = Mat(h, w, CV_8UC2);
+            break;
+        case PIXFMT_NV12:
+            // The Y plane followed by the half height UV plane
+            front_buffer = Mat(h + h/2, w, CV_8UC1);
+            back_buffer = Mat(h + h/2, w, CV_8UC1);
+            break;
+        default:
+            front_buffer = Mat(h, w, CV_8UC3);
+            back_buffer = Mat(h, w, CV_8UC3);
+            break;
+    }
     set_buffers(front_buffer, back_buffer);
 }
 
@@ -26,14 +64,33 @@ void
 RealCamera::fetch()
 {
     Mat aux;
+    struct timespec timestamp;
 
     if (!c.grab())
         throw CAM_GRAB_ERROR;
-    if (!c.retrieve(back_buffer))
-        throw CAM_RETRIEVE_ERROR;
+    // The frame has just been captured
+    utilities::timenow(timestamp);
+    if (pixel_format == PIXFMT_BGR) {
+        if (!c.retrieve(back_buffer))
+            throw CAM_RETRIEVE_ERROR;
+    } else {
+        // The raw buffer belongs to the capture object and is only valid
+        // until the next grab, so it is copied (but not converted) to the
+        // back frame
+        if (!c.retrieve(raw_buffer))
+            throw CAM_RETRIEVE_ERROR;
+        if (raw_buffer.total() * raw_buffer.elemSize()
+            != back_buffer.total() * back_buffer.elemSize())
+        {
+            throw CAM_FORMAT_ERROR;
+        }
+        memcpy(back_buffer.data, raw_buffer.data,
+            back_buffer.total() * back_buffer.elemSize());
+    }
 
     // Swap the frames
     swap_buffers();
+    set_timestamp(timestamp);
     aux = front_buffer;
     front_buffer = back_buffer;
     back_buffer = aux;
@@ -9,6 +9,7 @@
 #include "opencv2/opencv.hpp"
 
 #include "camera.hpp"
+#include "camparams.hpp"
 
 using namespace cv;
 
@@ -17,14 +18,22 @@ typedef enum {
     CAM_OK,
     CAM_OPEN_ERROR,
     CAM_GRAB_ERROR,
-    CAM_RETRIEVE_ERROR
+    CAM_RETRIEVE_ERROR,
+    CAM_FORMAT_ERROR
 } cam_error_t;
 
 class RealCamera: public Camera {
 
     public:
 
-        RealCamera();
+        /* Constructor.
+           Parameters:
+             * cam_params: camera's parameters. The resolution and the pixel
+                 format are requested to the camera. With PIXFMT_YUYV or
+                 PIXFMT_NV12 the frames are the raw buffers of the camera,
+                 without any color conversion.
+        */
+        RealCamera(const cam_params_t& cam_params);
         virtual ~RealCamera();
 
         // Fetch the next frame
@@ -41,10 +50,16 @@ class RealCamera: public Camera {
         // OpenCV capture object
         VideoCapture c;
 
+        // Layout of the pixels of the frames
+        pixel_format_t pixel_format;
+
         // The front and back frames
         Mat front_buffer;
         Mat back_buffer;
 
+        // Raw buffer retrieved from the camera (only for YUYV and NV12)
+        Mat raw_buffer;
+
 };
 
 #endif
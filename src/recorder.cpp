@@ -0,0 +1,295 @@
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "followexception.hpp"
+#include "recorder.hpp"
+
+/* Round a size up to a multiple of the page size.
+   Parameters:
+     * size: the size to round.
+*/
+static uint64_t
+page_align(uint64_t size)
+{
+    uint64_t page = sysconf(_SC_PAGESIZE);
+
+    return (size + page - 1) / page * page;
+}
+
+/* Constructor.
+   Parameters:
+     * file: path of the capture file, that is overwritten.
+     * cam_params: camera parameters.
+     * max_frames: maximum number of frames to record.
+   Throws FollowException if the file can't be created.
+*/
+Recorder::Recorder(const string& file, const cam_params_t& cam_params,
+        size_t max_frames):
+    file(file), fd(-1), length(0), header(0), index(0), chunk(0),
+    chunk_offset(0), rows(0), cols(0), type(0), frame_size(0),
+    record_size(0), head(0), count(0), closing(false), seq(0), failed(false)
+{
+    void *addr;
+
+    if ((fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        throw FollowException("cannot create " + file + ": "
+            + strerror(errno));
+    }
+
+    // The header and the index are mapped for the whole recording
+    length = page_align(
+        CAPTURE_HEADER_SIZE + max_frames * sizeof(capture_index_t));
+    if (ftruncate(fd, length) < 0) {
+        close(fd);
+        throw FollowException("cannot grow " + file + ": " + strerror(errno));
+    }
+    addr = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        throw FollowException("cannot map " + file + ": " + strerror(errno));
+    }
+    header = (capture_header_t *)addr;
+    index = (capture_index_t *)((unsigned char *)addr + CAPTURE_HEADER_SIZE);
+    memcpy(header->magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+    header->version = CAPTURE_VERSION;
+    header->width = cam_params.width;
+    header->height = cam_params.height;
+    header->pixel_format = cam_params.pixel_format;
+    header->index_offset = CAPTURE_HEADER_SIZE;
+    header->data_offset = length;
+    header->max_frames = max_frames;
+
+    for (size_t i = 0; i < RECORDER_DEPTH; i++) {
+        slots[i].data = 0;
+    }
+    pthread_mutex_init(&mutex, 0);
+    pthread_cond_init(&cond, 0);
+    pthread_create(&thread, 0, thread_main, this);
+}
+
+// Write the pending frames and close the file
+Recorder::~Recorder()
+{
+    // Stop the thread once the queue is empty
+    pthread_mutex_lock(&mutex);
+    closing = true;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, 0);
+    header->dropped = seq - header->nframes;
+
+    // Remove the space of the last chunk that wasn't used
+    if (chunk)
+        munmap(chunk, RECORDER_CHUNK * record_size);
+    if (ftruncate(fd, header->data_offset + header->nframes * record_size)
+        < 0)
+    {
+        warn("cannot truncate %s", file.c_str());
+    }
+    munmap(header, header->data_offset);
+    close(fd);
+
+    for (size_t i = 0; i < RECORDER_DEPTH; i++) {
+        delete[] slots[i].data;
+    }
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+/* Queue a frame to be recorded. All the frames must have the same size and
+   type.
+   Parameters:
+     * frame: the frame.
+     * timestamp: capture time of the frame.
+     * speed: speed given to the motors for this frame.
+     * turn: turn given to the motors for this frame.
+*/
+void
+Recorder::record(const Mat& frame, const struct timespec& timestamp,
+    float speed, float turn)
+{
+    recorder_slot_t *slot;
+    size_t row_size;
+
+    if (!frame_size)
+        init_frames(frame);
+
+    // Take a free slot, or drop the frame if there's none
+    pthread_mutex_lock(&mutex);
+    if (count == RECORDER_DEPTH || frame.rows != rows || frame.cols != cols
+        || frame.type() != type)
+    {
+        seq++;
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+    slot = &slots[(head + count) % RECORDER_DEPTH];
+    slot->record.seq = seq++;
+    pthread_mutex_unlock(&mutex);
+
+    // The slot isn't in the queue yet, so it's filled without the lock
+    slot->record.tv_sec = timestamp.tv_sec;
+    slot->record.tv_nsec = timestamp.tv_nsec;
+    slot->record.speed = speed;
+    slot->record.turn = turn;
+    if (frame.isContinuous()) {
+        memcpy(slot->data, frame.data, frame_size);
+    } else {
+        row_size = frame.cols * frame.elemSize();
+        for (int i = 0; i < frame.rows; i++) {
+            memcpy(slot->data + i * row_size, frame.ptr(i), row_size);
+        }
+    }
+
+    pthread_mutex_lock(&mutex);
+    count++;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+// PRIVATE FUNCTIONS
+
+/* Set the size and type of the frames and allocate the queue.
+   Parameters:
+     * frame: the first frame.
+*/
+void
+Recorder::init_frames(const Mat& frame)
+{
+    rows = frame.rows;
+    cols = frame.cols;
+    type = frame.type();
+    frame_size = frame.total() * frame.elemSize();
+    record_size = page_align(sizeof(capture_record_t) + frame_size);
+    for (size_t i = 0; i < RECORDER_DEPTH; i++) {
+        slots[i].data = new unsigned char[frame_size];
+    }
+}
+
+/* Map the chunk of records that starts at the given offset, growing the
+   file if necessary.
+   Parameters:
+     * offset: offset of the chunk in the file.
+   Return false on error.
+*/
+bool
+Recorder::map_chunk(uint64_t offset)
+{
+    uint64_t chunk_size = RECORDER_CHUNK * record_size;
+    void *addr;
+
+    // Start writing back the previous chunk before releasing it
+    if (chunk) {
+        msync(chunk, chunk_size, MS_ASYNC);
+        munmap(chunk, chunk_size);
+        chunk = 0;
+    }
+    if (offset + chunk_size > length) {
+        if (ftruncate(fd, offset + chunk_size) < 0) {
+            warn("cannot grow %s", file.c_str());
+            return false;
+        }
+        length = offset + chunk_size;
+    }
+    addr = mmap(0, chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+        offset);
+    if (addr == MAP_FAILED) {
+        warn("cannot map %s", file.c_str());
+        return false;
+    }
+    chunk = (unsigned char *)addr;
+    chunk_offset = offset;
+    return true;
+}
+
+// Run the tasks of this thread
+void
+Recorder::run()
+{
+    recorder_slot_t *slot;
+
+    while (true) {
+        pthread_mutex_lock(&mutex);
+        while (!count && !closing) {
+            pthread_cond_wait(&cond, &mutex);
+        }
+        if (!count) {
+            pthread_mutex_unlock(&mutex);
+            break;
+        }
+        slot = &slots[head];
+        pthread_mutex_unlock(&mutex);
+
+        write(*slot);
+
+        pthread_mutex_lock(&mutex);
+        head = (head + 1) % RECORDER_DEPTH;
+        count--;
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+/* Thread main routine.
+   Parameters:
+     * instance: instance of the Recorder object.
+*/
+void *
+Recorder::thread_main(void *instance)
+{
+    ((Recorder *)instance)->run();
+    return 0;
+}
+
+/* Append a frame of the queue to the file.
+   Parameters:
+     * slot: the frame and its record header.
+*/
+void
+Recorder::write(const recorder_slot_t& slot)
+{
+    uint64_t n = header->nframes, offset;
+    unsigned char *record;
+
+    if (!failed && n == header->max_frames) {
+        warnx("%s is full, no more frames are recorded", file.c_str());
+        failed = true;
+    }
+    if (failed) {
+        header->dropped = slot.record.seq + 1 - n;
+        return;
+    }
+
+    // The frame size is known with the first frame
+    if (!n) {
+        header->rows = rows;
+        header->cols = cols;
+        header->type = type;
+        header->frame_size = frame_size;
+        header->record_size = record_size;
+    }
+
+    offset = header->data_offset + n * record_size;
+    if (!chunk || offset >= chunk_offset + RECORDER_CHUNK * record_size) {
+        if (!map_chunk(offset)) {
+            failed = true;
+            header->dropped = slot.record.seq + 1 - n;
+            return;
+        }
+    }
+    record = chunk + (offset - chunk_offset);
+    memcpy(record, &slot.record, sizeof(capture_record_t));
+    memcpy(record + sizeof(capture_record_t), slot.data, frame_size);
+
+    // The frame is counted once the record and its index entry are written
+    index[n].tv_sec = slot.record.tv_sec;
+    index[n].tv_nsec = slot.record.tv_nsec;
+    index[n].offset = offset;
+    header->dropped = slot.record.seq - n;
+    header->nframes = n + 1;
+}
+
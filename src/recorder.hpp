@@ -0,0 +1,139 @@
+/* recorder.hpp
+   Records the frames, with their capture time and the command given to the
+   motors, to a capture file (see capturefile.hpp). The caller only copies
+   each frame to a small queue; a background thread appends them to the
+   file through a memory mapping, so the main loop never waits for the disk.
+   If the queue is full the frame is dropped.
+*/
+
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+
+#include "opencv2/opencv.hpp"
+
+#include "camparams.hpp"
+#include "capturefile.hpp"
+
+// Number of frames of the queue between the caller and the thread
+#define RECORDER_DEPTH  4
+
+// Number of records mapped at once by the thread
+#define RECORDER_CHUNK  16
+
+using namespace cv;
+using namespace std;
+
+// A frame waiting in the queue
+typedef struct {
+    capture_record_t record;
+    unsigned char *data;
+} recorder_slot_t;
+
+class Recorder {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * file: path of the capture file, that is overwritten.
+             * cam_params: camera parameters.
+             * max_frames: maximum number of frames to record.
+           Throws FollowException if the file can't be created.
+        */
+        Recorder(const string& file, const cam_params_t& cam_params,
+            size_t max_frames);
+
+        // Write the pending frames and close the file
+        ~Recorder();
+
+        /* Queue a frame to be recorded. All the frames must have the same
+           size and type.
+           Parameters:
+             * frame: the frame.
+             * timestamp: capture time of the frame.
+             * speed: speed given to the motors for this frame.
+             * turn: turn given to the motors for this frame.
+        */
+        void record(const Mat& frame, const struct timespec& timestamp,
+            float speed, float turn);
+
+    private:
+
+        // Path of the file, for the error messages
+        string file;
+
+        // File descriptor of the capture file and its current length
+        int fd;
+        uint64_t length;
+
+        // Mapped header and index
+        capture_header_t *header;
+        capture_index_t *index;
+
+        // Mapped records (chunk of RECORDER_CHUNK records)
+        unsigned char *chunk;
+        uint64_t chunk_offset;
+
+        // Size and type of the frames, known with the first one
+        int rows;
+        int cols;
+        int type;
+        size_t frame_size;
+        uint64_t record_size;
+
+        // Queue of frames (protected by mutex)
+        recorder_slot_t slots[RECORDER_DEPTH];
+        size_t head;
+        size_t count;
+        bool closing;
+
+        // Number of frames given to record, including the dropped ones
+        uint64_t seq;
+
+        // True if the file can't be written anymore
+        bool failed;
+
+        // Thread attributes
+        pthread_t thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        /* Set the size and type of the frames and allocate the queue.
+           Parameters:
+             * frame: the first frame.
+        */
+        void init_frames(const Mat& frame);
+
+        /* Map the chunk of records that starts at the given offset, growing
+           the file if necessary.
+           Parameters:
+             * offset: offset of the chunk in the file.
+           Return false on error.
+        */
+        bool map_chunk(uint64_t offset);
+
+        // Run the tasks of this thread
+        void run();
+
+        /* Thread main routine.
+           Parameters:
+             * instance: instance of the Recorder object.
+        */
+        static void *thread_main(void *instance);
+
+        /* Append a frame of the queue to the file.
+           Parameters:
+             * slot: the frame and its record header.
+        */
+        void write(const recorder_slot_t& slot);
+
+};
+
+#endif
+
@@ -0,0 +1,218 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "followexception.hpp"
+#include "replaycamera.hpp"
+#include "utilities.hpp"
+
+#define NS_PER_SECOND   1000000000
+
+/* Constructor.
+   Parameters:
+     * file: path of the capture file.
+     * mode: pace of the frames.
+   Throws FollowException if the file can't be mapped or isn't a valid
+   capture file.
+*/
+ReplayCamera::ReplayCamera(const string& file, replay_mode_t mode):
+    data(0), length(0), header(0), index(0), mode(mode), next_frame(0)
+{
+    struct stat st;
+    void *addr;
+    int fd;
+
+    if ((fd = open(file.c_str(), O_RDONLY)) < 0) {
+        throw FollowException("cannot open " + file + ": " + strerror(errno));
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw FollowException("cannot stat " + file + ": " + strerror(errno));
+    }
+    length = st.st_size;
+    if (length < CAPTURE_HEADER_SIZE) {
+        close(fd);
+        throw FollowException(file + " is not a capture file");
+    }
+    // The mapping is private and writable, so the frames can be drawn on
+    // without modifying the file
+    addr = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw FollowException("cannot map " + file + ": " + strerror(errno));
+    }
+    data = (unsigned char *)addr;
+    header = (const capture_header_t *)data;
+
+    // Check that every frame is inside the mapping, as they are used in
+    // place
+    try {
+        check_header(*header, file);
+        if (header->record_size > length
+            || (uint64_t)header->rows * header->cols > length
+            || (uint64_t)header->rows * header->cols
+            * CV_ELEM_SIZE(header->type) + sizeof(capture_record_t)
+            > header->record_size)
+        {
+            throw FollowException(file + " has an invalid frame size");
+        }
+        if (header->nframes > length / sizeof(capture_index_t)
+            || header->index_offset > length
+            || header->nframes * sizeof(capture_index_t)
+            > length - header->index_offset)
+        {
+            throw FollowException(file + " is truncated");
+        }
+        index = (const capture_index_t *)(data + header->index_offset);
+        for (uint64_t i = 0; i < header->nframes; i++) {
+            if (index[i].offset > length - header->record_size) {
+                throw FollowException(file + " is truncated");
+            }
+        }
+    } catch (FollowException&) {
+        munmap(data, length);
+        throw;
+    }
+}
+
+ReplayCamera::~ReplayCamera()
+{
+    if (data)
+        munmap(data, length);
+}
+
+// Fetch the next frame
+void
+ReplayCamera::fetch()
+{
+    const capture_index_t& entry = index[next_frame];
+    struct timespec timestamp;
+    int64_t ns;
+
+    // The frames keep the time between them that they had when they were
+    // recorded, starting from the first one given (again when the file
+    // starts again)
+    if (!next_frame)
+        utilities::timenow(start);
+    ns = (entry.tv_sec - index[0].tv_sec) * NS_PER_SECOND
+        + (entry.tv_nsec - index[0].tv_nsec) + start.tv_nsec;
+    timestamp.tv_sec = start.tv_sec + ns / NS_PER_SECOND;
+    timestamp.tv_nsec = ns % NS_PER_SECOND;
+    if (mode == REPLAY_REALTIME) {
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &timestamp, 0)
+            == EINTR);
+    }
+
+    // Only the headers are assigned, the frames are not copied
+    back_buffer = front_buffer;
+    front_buffer = Mat(header->rows, header->cols, header->type,
+        data + entry.offset + sizeof(capture_record_t));
+    set_buffers(front_buffer,
+        back_buffer.empty() ? front_buffer : back_buffer);
+    set_timestamp(timestamp);
+    next_frame = (next_frame + 1) % header->nframes;
+}
+
+/* Lend the frame returned by next. The frames are in the mapped file, so
+   they are always valid and nothing is given back.
+   Return the index of the frame in the file.
+*/
+ssize_t
+ReplayCamera::lend()
+{
+    return (next_frame + header->nframes - 1) % header->nframes;
+}
+
+// Return frame's height
+size_t
+ReplayCamera::get_height()
+{
+    return header->height;
+}
+
+// Return frame's width
+size_t
+ReplayCamera::get_width()
+{
+    return header->width;
+}
+
+/* Set the size and pixel format of the camera parameters to the ones of a
+   capture file.
+   Parameters:
+     * file: path of the capture file.
+     * cam_params: camera parameters to update.
+   Throws FollowException if the file isn't a valid capture file.
+*/
+void
+ReplayCamera::get_cam_params(const string& file, cam_params_t& cam_params)
+{
+    capture_header_t header;
+    ssize_t n;
+    int fd;
+
+    if ((fd = open(file.c_str(), O_RDONLY)) < 0) {
+        throw FollowException("cannot open " + file + ": " + strerror(errno));
+    }
+    n = read(fd, &header, sizeof(header));
+    close(fd);
+    if (n != sizeof(header)) {
+        throw FollowException(file + " is not a capture file");
+    }
+    check_header(header, file);
+    cam_params.width = header.width;
+    cam_params.height = header.height;
+    cam_params.pixel_format = (pixel_format_t)header.pixel_format;
+}
+
+// PRIVATE FUNCTIONS
+
+/* Check that a header is the one of a valid capture file, with frames of
+   the size and the pixel format of the camera.
+   Parameters:
+     * header: the header.
+     * file: path of the file, for the error messages.
+   Throws FollowException if it isn't valid.
+*/
+void
+ReplayCamera::check_header(const capture_header_t& header, const string& file)
+{
+    bool valid;
+
+    if (memcmp(header.magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE)) {
+        throw FollowException(file + " is not a capture file");
+    }
+    if (header.version != CAPTURE_VERSION) {
+        throw FollowException(file + " has an unsupported version");
+    }
+    if (!header.nframes) {
+        throw FollowException(file + " doesn't contain any frame");
+    }
+    // The road finder finds the scanlines in the frames with the size and
+    // the pixel format of the camera, so the frames must have them
+    switch (header.pixel_format) {
+        case PIXFMT_BGR:
+            valid = header.rows == header.height
+                && header.cols == header.width && header.type == CV_8UC3;
+            break;
+        case PIXFMT_YUYV:
+            valid = header.rows == header.height
+                && header.cols == header.width && header.type == CV_8UC2;
+            break;
+        case PIXFMT_NV12:
+            valid = header.rows == header.height * 3 / 2
+                && header.cols == header.width && header.type == CV_8UC1;
+            break;
+        default:
+            throw FollowException(file + " has an unknown pixel format");
+    }
+    if (!valid) {
+        throw FollowException(file
+            + " has frames that don't match the camera size and format");
+    }
+}
+
@@ -0,0 +1,108 @@
+/* replaycamera.hpp
+   Represents a camera that replays the frames of a capture file written by
+   the recorder. The file is mapped in memory and the frames are used in
+   place, starting again when the end is reached. They can be given at the
+   pace they were recorded or as fast as they are asked for.
+*/
+
+#ifndef REPLAYCAMERA_HPP
+#define REPLAYCAMERA_HPP
+
+#include <string>
+#include <time.h>
+
+#include "opencv2/opencv.hpp"
+
+#include "camera.hpp"
+#include "camparams.hpp"
+#include "capturefile.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Pace of the replayed frames
+typedef enum {
+    // Each frame is given at the time it was recorded
+    REPLAY_REALTIME,
+    // Each frame is given as soon as it's asked for
+    REPLAY_FAST
+} replay_mode_t;
+
+class ReplayCamera: public Camera {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * file: path of the capture file.
+             * mode: pace of the frames.
+           Throws FollowException if the file can't be mapped or isn't a
+           valid capture file.
+        */
+        ReplayCamera(const string& file, replay_mode_t mode);
+
+        virtual ~ReplayCamera();
+
+        // Fetch the next frame
+        virtual void fetch();
+
+        /* Lend the frame returned by next. The frames are in the mapped
+           file, so they are always valid and nothing is given back.
+           Return the index of the frame in the file.
+        */
+        virtual ssize_t lend();
+
+        // Return frame's height
+        virtual size_t get_height();
+
+        // Return frame's width
+        virtual size_t get_width();
+
+        /* Set the size and pixel format of the camera parameters to the ones
+           of a capture file.
+           Parameters:
+             * file: path of the capture file.
+             * cam_params: camera parameters to update.
+           Throws FollowException if the file isn't a valid capture file.
+        */
+        static void get_cam_params(const string& file,
+            cam_params_t& cam_params);
+
+    private:
+
+        // The mapped file and its length
+        unsigned char *data;
+        size_t length;
+
+        // Header and index of the file
+        const capture_header_t *header;
+        const capture_index_t *index;
+
+        // Pace of the frames
+        replay_mode_t mode;
+
+        // Index of the next frame to give
+        size_t next_frame;
+
+        // Time when the first frame was given, the rest are given relative
+        // to it
+        struct timespec start;
+
+        // Headers of the front and back frames, over the mapped file
+        Mat front_buffer;
+        Mat back_buffer;
+
+        /* Check that a header is the one of a valid capture file, with
+           frames of the size and the pixel format of the camera.
+           Parameters:
+             * header: the header.
+             * file: path of the file, for the error messages.
+           Throws FollowException if it isn't valid.
+        */
+        static void check_header(const capture_header_t& header,
+            const string& file);
+
+};
+
+#endif
+
@@ -2,7 +2,10 @@
 #include "road.hpp"
 
 Road::Road()
-{}
+{
+    timestamp.tv_sec = 0;
+    timestamp.tv_nsec = 0;
+}
 
 Road::~Road()
 {}
@@ -48,6 +51,13 @@ Road::get_size() const
     return sections.size();
 }
 
+// Return the capture time of the frame where the road was found.
+const struct timespec&
+Road::get_timestamp() const
+{
+    return timestamp;
+}
+
 /* Set the goal position.
    Parameters:
      * goal: the new goal position.
@@ -58,3 +68,13 @@ Road::set_goal(const glm::vec2& goal)
     this->goal = goal;
 }
 
+/* Set the capture time of the frame where the road was found.
+   Parameters:
+     * timestamp: the capture time.
+*/
+void
+Road::set_timestamp(const struct timespec& timestamp)
+{
+    this->timestamp = timestamp;
+}
+
@@ -4,6 +4,7 @@
 
 #include <glm/vec2.hpp>
 #include <sys/types.h>
+#include <time.h>
 #include <vector>
 
 using namespace std;
@@ -47,12 +48,21 @@ class Road {
         // Return the number of sections.
         size_t get_size() const;
 
+        // Return the capture time of the frame where the road was found.
+        const struct timespec& get_timestamp() const;
+
         /* Set the goal position.
            Parameters:
              * goal: the new goal position.
         */
         void set_goal(const glm::vec2& goal);
 
+        /* Set the capture time of the frame where the road was found.
+           Parameters:
+             * timestamp: the capture time.
+        */
+        void set_timestamp(const struct timespec& timestamp);
+
     private:
 
         // The sequence of sections
@@ -61,6 +71,9 @@ class Road {
         // The goal
         glm::vec2 goal;
 
+        // Capture time of the frame where the road was found
+        struct timespec timestamp;
+
 };
 
 #endif
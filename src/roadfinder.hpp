@@ -12,7 +12,25 @@ class RoadFinder {
 
     public:
 
-        virtual void find(Mat& frame, Road& road) = 0;
+        virtual ~RoadFinder() {}
+
+        /* Find the road in the image.
+           Parameters:
+             * frame: image of the road.
+             * timestamp: capture time of the frame, kept in the road.
+             * road: output parameter that contains the road found.
+        */
+        virtual void find(Mat& frame, const struct timespec& timestamp,
+            Road& road) = 0;
+
+        /* Give the command sent to the motors after the last road was
+           found, that moves the road in the next frame. It's ignored by the
+           road finders that don't track the road.
+           Parameters:
+             * speed: mean speed (0.0 is no movement and 1.0 is max speed).
+             * turn: difference of speed between the two wheels.
+        */
+        virtual void set_motors(float speed, float turn) {}
 
 };
 
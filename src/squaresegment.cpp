@@ -1,5 +1,6 @@
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <math.h>
 
 #include "squaresegment.hpp"
 
@@ -23,6 +24,35 @@ SquareSegment::contains(const glm::vec3& point) const
     return am_ab > 0 && am_ab < ab_ab && am_ad > 0 && am_ad < ad_ad;
 }
 
+/* Return the distance from the projection of a point to the center line of
+   the road of this segment, that goes from side ad to the opposite side.
+   Parameters:
+     * point: the point.
+*/
+float
+SquareSegment::get_center_distance(const glm::vec3& point) const
+{
+    glm::vec2 am(glm::vec2(point) - a);
+
+    return fabs(dot(am, ad) / ad_ad - 0.5) * sqrt(ad_ad);
+}
+
+/* Return the distance from the projection of a point to the center line of a
+   branch of a crossroad, an arc of radius half the side of the square.
+   Parameters:
+     * point: the point.
+     * u: position of the center of the arc along side ab (0 or 1).
+     * v: position of the center of the arc along side ad (0 or 1).
+*/
+float
+SquareSegment::get_arc_distance(const glm::vec3& point, float u, float v)
+    const
+{
+    glm::vec2 cm(glm::vec2(point) - (a + ab*u + ad*v));
+
+    return fabs(length(cm) - sqrt(ad_ad)/2);
+}
+
 /* Set the corners that delimite this square.
    Parameters:
      * a: first corner.
@@ -18,6 +18,13 @@ class SquareSegment: public TrackSegment {
         // Return true if this segment contains the projection of point
         virtual bool contains(const glm::vec3& point) const;
 
+        /* Return the distance from the projection of a point to the center
+           line of the road of this segment.
+           Parameters:
+             * point: the point.
+        */
+        virtual float get_center_distance(const glm::vec3& point) const;
+
     protected:
 
         /* Set the corners that delimite this square.
@@ -29,6 +36,17 @@ class SquareSegment: public TrackSegment {
         void set_corners(
             const glm::vec3& a, const glm::vec3& b, const glm::vec3& d);
 
+        /* Return the distance from the projection of a point to the center
+           line of a branch of a crossroad, an arc of radius half the side
+           of the square.
+           Parameters:
+             * point: the point.
+             * u: position of the center of the arc along side ab (0 or 1).
+             * v: position of the center of the arc along side ad (0 or 1).
+        */
+        float get_arc_distance(const glm::vec3& point, float u, float v)
+            const;
+
     private:
 
         // Precomputed variables to compute if a point is inside this segment
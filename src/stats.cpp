@@ -0,0 +1,120 @@
+
+#include <math.h>
+#include <string.h>
+
+#include "stats.hpp"
+
+#define US_PER_SECOND   1000000.0
+
+Stats::Stats()
+{
+    reset();
+}
+
+/* Record the time spent in a stage.
+   Parameters:
+     * stage: the stage.
+     * seconds: the time spent (in s).
+*/
+void
+Stats::add(stats_stage_t stage, float seconds)
+{
+    uint32_t us;
+
+    // Negative times can come from frames timestamped by another clock
+    if (seconds < 0.0)
+        seconds = 0.0;
+    us = (seconds * US_PER_SECOND < UINT32_MAX)
+        ? (uint32_t)(seconds * US_PER_SECOND) : UINT32_MAX;
+    buckets[stage][bucket(us)]++;
+    count[stage]++;
+    if (us > max[stage])
+        max[stage] = us;
+}
+
+/* Return a summary of the times recorded for a stage.
+   Parameters:
+     * stage: the stage.
+     * summary: the output summary.
+*/
+void
+Stats::get_summary(stats_stage_t stage, stats_summary_t& summary) const
+{
+    summary.count = count[stage];
+    summary.p50 = percentile(stage, 0.5);
+    summary.p99 = percentile(stage, 0.99);
+    summary.max = max[stage];
+}
+
+// Remove all the recorded times
+void
+Stats::reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    memset(count, 0, sizeof(count));
+    memset(max, 0, sizeof(max));
+}
+
+// PRIVATE FUNCTIONS
+
+/* Return the value below which a fraction of the recorded times of a stage
+   are.
+   Parameters:
+     * stage: the stage.
+     * fraction: the fraction of times (between 0.0 and 1.0).
+*/
+uint32_t
+Stats::percentile(stats_stage_t stage, float fraction) const
+{
+    uint32_t rank, sum = 0;
+    uint32_t limit;
+
+    if (!count[stage])
+        return 0;
+    rank = (uint32_t)ceil(fraction * count[stage]);
+    if (!rank)
+        rank = 1;
+    for (size_t i = 0; i < STATS_BUCKETS; i++) {
+        sum += buckets[stage][i];
+        if (sum >= rank) {
+            // The bucket limit can't be higher than the maximum time
+            limit = bucket_limit(i);
+            return (limit < max[stage]) ? limit : max[stage];
+        }
+    }
+    return max[stage];
+}
+
+/* Return the bucket of a value.
+   The values lower than 4 have their own bucket, the rest are divided in
+   four buckets for each power of two.
+   Parameters:
+     * value: the value.
+*/
+size_t
+Stats::bucket(uint32_t value)
+{
+    unsigned int octave;
+
+    if (value < 4)
+        return value;
+    octave = 31 - __builtin_clz(value);
+    return 4 * (octave - 1) + ((value >> (octave - 2)) & 3);
+}
+
+/* Return the highest value that falls in a bucket.
+   Parameters:
+     * index: index of the bucket.
+*/
+uint32_t
+Stats::bucket_limit(size_t index)
+{
+    unsigned int octave, sub;
+
+    if (index < 4)
+        return index;
+    octave = index / 4 + 1;
+    sub = index % 4;
+    return ((uint64_t)(5 + sub) << (octave - 2)) - 1;
+}
+
@@ -0,0 +1,97 @@
+/* stats.hpp
+   Timing statistics of the stages of the main loop. Each stage keeps a
+   histogram with logarithmic buckets (four per power of two), so recording
+   a time is just incrementing a counter and the percentiles have an error
+   lower than 25%.
+*/
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Number of buckets of each histogram (enough for any 32 bit value)
+#define STATS_BUCKETS   124
+
+// Stages of the main loop that are timed
+typedef enum {
+    // Waiting for the next frame
+    STAGE_FRAME_WAIT,
+    // Finding the road in the frame
+    STAGE_ROAD,
+    // Finding the path along the road
+    STAGE_PATH,
+    // Moving the motors
+    STAGE_MOTORS,
+    // Sending the data to the subscriptors
+    STAGE_TELEMETRY,
+    // From the capture of the frame until the motors are moved
+    STAGE_LATENCY,
+    NUM_STAGES
+} stats_stage_t;
+
+// Summary of the times of a stage (in us)
+typedef struct {
+    uint32_t count;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+} stats_summary_t;
+
+class Stats {
+
+    public:
+
+        Stats();
+
+        /* Record the time spent in a stage.
+           Parameters:
+             * stage: the stage.
+             * seconds: the time spent (in s).
+        */
+        void add(stats_stage_t stage, float seconds);
+
+        /* Return a summary of the times recorded for a stage.
+           Parameters:
+             * stage: the stage.
+             * summary: the output summary.
+        */
+        void get_summary(stats_stage_t stage, stats_summary_t& summary) const;
+
+        // Remove all the recorded times
+        void reset();
+
+    private:
+
+        // Histogram of the times (in us) of each stage
+        uint32_t buckets[NUM_STAGES][STATS_BUCKETS];
+
+        // Number of times recorded and maximum time of each stage (in us)
+        uint32_t count[NUM_STAGES];
+        uint32_t max[NUM_STAGES];
+
+        /* Return the value below which a fraction of the recorded times of a
+           stage are.
+           Parameters:
+             * stage: the stage.
+             * fraction: the fraction of times (between 0.0 and 1.0).
+        */
+        uint32_t percentile(stats_stage_t stage, float fraction) const;
+
+        /* Return the bucket of a value.
+           Parameters:
+             * value: the value.
+        */
+        static size_t bucket(uint32_t value);
+
+        /* Return the highest value that falls in a bucket.
+           Parameters:
+             * index: index of the bucket.
+        */
+        static uint32_t bucket_limit(size_t index);
+
+};
+
+#endif
+
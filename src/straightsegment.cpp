@@ -56,45 +56,49 @@ StraightSegment::get_output(int output, glm::vec3& pos, float& orient) const
     orient = orientation;
 }
 
-/* Initialize the geometry.
+// Initialize the geometry: the bounding box and the shape used by contains
+void
+StraightSegment::init_geometry()
+{
+    gl_vertex_t tr_vertices[STRAIGHT_NUM_VERTICES];
+
+    transform_vertices(vertices, tr_vertices);
+    compute_bounding_box(tr_vertices, STRAIGHT_NUM_VERTICES);
+
+    // Precomputed variables used in the contains function
+    set_corners(tr_vertices[8].position, tr_vertices[9].position,
+        tr_vertices[5].position);
+}
+
+/* Write the vertices and the indices of this segment in the buffers of the
+   track.
    Parameters:
      * first_vertex: index in the OpenGL Vertex Buffer for the first
          vertex of this segment.
      * first_index: index in the OpenGL Index Buffer for the first
          index of this segment.
-     * context: OpenGL objects.
+     * context: OpenGL objects, with the buffers being built.
 */
 void
-StraightSegment::init_geometry(size_t first_vertex, size_t first_index,
+StraightSegment::fill_geometry(size_t first_vertex, size_t first_index,
     const gl_context_t& context)
 {
-    gl_vertex_t tr_vertices[STRAIGHT_NUM_VERTICES];
-    GLushort tr_indices[STRAIGHT_NUM_INDICES];
-
-    this->first_vertex = first_vertex;
-    this->first_index = first_index;
-    this->context = context;
-
-    fill_buffers(vertices, tr_vertices, indices, tr_indices);
-
-    // Precomputed variables used in the contains function
-    set_corners(tr_vertices[8].position, tr_vertices[9].position,
-        tr_vertices[5].position);
+    fill_buffers(vertices, indices, first_vertex, first_index, context);
 }
 
-// Render this segment
+/* Add the draws of this segment: for each part, its texture, its primitive
+   and its range of the index buffer.
+   Parameters:
+     * draws: vector where to add the draws.
+*/
 void
-StraightSegment::render()
+StraightSegment::get_draws(vector<gl_draw_t>& draws) const
 {
-    // Draw the primitives
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    // Draw the road
-    glUniform1i(context.u_texture, texture);
-    glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT,
-        (void *)(first_index * sizeof(GLushort)));
-    // Draw the sides
-    glUniform1i(context.u_texture, WOOD_TEXTURE);
-    glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_SHORT,
-        (void *)((first_index + 4) * sizeof(GLushort)));
+    gl_draw_t road = {texture, GL_TRIANGLE_STRIP, 4, (GLsizei)first_index};
+    gl_draw_t sides = {WOOD_TEXTURE, GL_TRIANGLES, 12,
+        (GLsizei)first_index + 4};
+
+    draws.push_back(road);
+    draws.push_back(sides);
 }
 
@@ -0,0 +1,648 @@
+
+#include <err.h>
+#include <errno.h>
+#include <fstream>
+#include <getopt.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <poll.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "followexception.hpp"
+#include "options.hpp"
+#include "pilot.hpp"
+#include "pipeline.hpp"
+#include "trackfile.hpp"
+#include "utilities.hpp"
+#include "virtualcamera.hpp"
+#include "virtualmotors.hpp"
+
+#define OPTSTRING   "c:j:r:t:h"
+
+// Maximum simulated time of each run (in s)
+#define DEFAULT_TIME    120
+
+// Simulated time that the robot can be out of the track before the run is
+// given up (in s)
+#define OFF_TRACK_TIMEOUT   1.0
+
+using namespace utilities;
+
+// A parameter of the grid and the values to try
+typedef struct {
+    string name;
+    vector<string> values;
+} grid_param_t;
+
+// Result of a run, sent by the worker process to the main process
+typedef struct {
+    // Time to complete a lap (in s, negative if it wasn't completed)
+    float lap_time;
+    // Number of times that the robot went out of the track
+    unsigned int off_track;
+    // Mean distance from the camera to the center line of the road while
+    // on the track (in cm)
+    float cross_track_error;
+    // Number of frames simulated
+    unsigned long frames;
+} run_result_t;
+
+// A robot of a worker process, with the state of its run
+typedef struct {
+    VirtualCamera *camera;
+    VirtualMotors *motors;
+    Pilot *pilot;
+    RoadFinder *road_finder;
+    PathFinder *path_finder;
+    const VirtualTrack *track;
+    Road road;
+    glm::vec3 position;
+    glm::vec3 orientation;
+    glm::vec3 normal;
+    // Segment where the robot was, checked first in the next frame
+    int segment;
+    // Segments visited, and the one where the robot started
+    vector<bool> visited;
+    size_t nvisited;
+    int start;
+    // If the track is a loop, or it is open and ends in its last segment
+    bool closed;
+    // Frames on the track and sum of the distances to the center line
+    size_t on_frames;
+    float distance;
+    // If the robot is on the track, and when it went out of it
+    bool on_track;
+    float off_time;
+    run_result_t result;
+} robot_t;
+
+// A worker process and the combinations that it runs, one for each robot
+typedef struct {
+    pid_t pid;
+    int fd;
+    size_t combination;
+    size_t ncombinations;
+    // Bytes of the results read from the pipe so far
+    size_t received;
+} worker_t;
+
+// Configuration file
+const char *config_file = 0;
+
+// File with the grid of parameters
+const char *grid_file = 0;
+
+// Number of worker processes at once (0 is one per CPU)
+long njobs = 0;
+
+// Number of robots of each worker process, that share the track
+long nrobots = 1;
+
+// Maximum simulated time of each run (in s)
+float max_time = DEFAULT_TIME;
+
+// Print help message and exits
+void
+print_help()
+{
+    printf("Usage: follow-sweep [options ...] GRID\n"
+           "Runs the line follower on the virtual track of the configuration\n"
+           "file, in simulated time, with each combination of the values of\n"
+           "GRID, and prints the results as CSV. Each line of GRID gives an\n"
+           "option and its values separated by commas (Kp=0.1,0.2,0.3).\n"
+           "Options:\n"
+           "  -h, --help                    Show this message and exit.\n"
+           "  -c=CONFIG, --config=CONFIG    Give the configuration file.\n"
+           "  -j=JOBS, --jobs=JOBS          Number of worker processes at\n"
+           "                                once (one per CPU by default).\n"
+           "  -r=ROBOTS, --robots=ROBOTS    Number of runs of each worker\n"
+           "                                process at once, with robots\n"
+           "                                that share the track (1 by\n"
+           "                                default).\n"
+           "  -t=TIME, --time=TIME          Maximum simulated time of each\n"
+           "                                run (in s).\n");
+    exit(0);
+}
+
+// Parse the command line arguments
+void
+parse_args(int argc, char **argv)
+{
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"config", required_argument, 0, 'c'},
+        {"jobs", required_argument, 0, 'j'},
+        {"robots", required_argument, 0, 'r'},
+        {"time", required_argument, 0, 't'},
+        {0, 0, 0, 0}
+    };
+    int o;
+
+    do {
+        o = getopt_long(argc, argv, OPTSTRING, long_opts, 0);
+        switch (o) {
+            case 'h':
+                print_help();
+            case 'c':
+                config_file = optarg;
+                break;
+            case 'j':
+                njobs = atol(optarg);
+                break;
+            case 'r':
+                nrobots = atol(optarg);
+                break;
+            case 't':
+                max_time = atof(optarg);
+                break;
+            case '?':
+                exit(1);
+            default:
+                break;
+        }
+    } while (o != -1);
+
+    if (!config_file)
+        errx(1, "missing config file");
+    if (optind != argc - 1)
+        errx(1, "missing grid file");
+    grid_file = argv[optind];
+    if (njobs < 0)
+        errx(1, "invalid number of jobs");
+    if (!njobs)
+        njobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nrobots < 1)
+        errx(1, "invalid number of robots");
+    if (max_time <= 0)
+        errx(1, "invalid time");
+}
+
+/* Load the grid of parameters.
+   Parameters:
+     * file: path of the grid file.
+     * grid: output parameters and their values.
+*/
+void
+load_grid(const char *file, vector<grid_param_t>& grid)
+{
+    ifstream f(file);
+    string line, value;
+    size_t pos_eq;
+    grid_param_t param;
+
+    if (f.fail())
+        err(1, "cannot open file %s", file);
+    while (getline(f, line)) {
+        // Jump comments and white lines
+        if (line == "" || line[0] == '#')
+            continue;
+        if ((pos_eq = line.find('=')) == string::npos)
+            errx(1, "wrong grid line '%s'", line.c_str());
+        param.name = line.substr(0, pos_eq);
+        param.values.clear();
+        stringstream ss(line.substr(pos_eq + 1));
+        while (getline(ss, value, ',')) {
+            param.values.push_back(value);
+        }
+        if (param.values.empty())
+            errx(1, "no values for %s", param.name.c_str());
+        grid.push_back(param);
+    }
+}
+
+/* Get the index of the value of each parameter in a combination. The last
+   parameter changes the fastest.
+   Parameters:
+     * grid: the parameters.
+     * combination: number of the combination.
+     * indices: output index of the value of each parameter.
+*/
+void
+get_combination(const vector<grid_param_t>& grid, size_t combination,
+    vector<size_t>& indices)
+{
+    indices.resize(grid.size());
+    for (size_t i = grid.size(); i-- > 0;) {
+        indices[i] = combination % grid[i].values.size();
+        combination /= grid[i].values.size();
+    }
+}
+
+/* Create a robot on the virtual track.
+   Parameters:
+     * options: options of the run.
+     * shared: camera whose track the robot uses, or 0 to load the track.
+     * robot: output robot.
+*/
+void
+create_robot(const Options& options, VirtualCamera *shared, robot_t& robot)
+{
+    cam_params_t cam_params;
+    vector<segment_t> segments;
+    float time_step;
+
+    // The time advances a PID period with each frame, if the configuration
+    // doesn't give the step
+    pipeline::get_cam_params(options, cam_params);
+    cam_params.pixel_format = PIXFMT_BGR;
+    time_step = options.get_float("SimulationTimeStep") / 1000.0;
+    if (time_step <= 0.0)
+        time_step = options.get_float("PIDPeriod") / 1000.0;
+    try {
+        if (shared) {
+            robot.camera = new VirtualCamera(shared, cam_params, time_step);
+        } else {
+            trackfile::load(options.get_string("TrackFile"), segments);
+            robot.camera = new VirtualCamera(segments, cam_params, true,
+                time_step, options.get_float("TrackStreamRadius"));
+        }
+    } catch (FollowException& e) {
+        errx(1, "cannot create the virtual camera: %s", e.what());
+    }
+    robot.motors = new VirtualMotors(robot.camera,
+        options.get_float("VirtualMotorsRpm"),
+        options.get_float("WheelDistance"),
+        options.get_float("WheelDiameter"));
+    robot.pilot = new Pilot(robot.motors, options.get_float("MaxSpeed"),
+        options.get_float("Kp"), options.get_float("Ki"),
+        options.get_float("Kd"), options.get_float("PIDPeriod") / 1000.0);
+    robot.road_finder = pipeline::create_road_finder(options, cam_params);
+    robot.path_finder = pipeline::create_path_finder(options);
+
+    // A lap is completed when the robot is back at the start segment after
+    // going through all of them, or in an open track, like the generated
+    // ones, when it reaches the last segment
+    robot.track = robot.camera->get_track();
+    robot.closed = robot.track->is_closed();
+    robot.visited.assign(robot.track->get_num_segments(), false);
+    robot.camera->get_position(robot.position, robot.orientation,
+        robot.normal);
+    robot.segment = -1;
+    if ((robot.start = robot.track->find_segment(robot.position,
+        robot.segment)) < 0)
+    {
+        errx(1, "the start position is outside the track");
+    }
+    robot.visited[robot.start] = true;
+    robot.nvisited = 1;
+    robot.on_frames = 0;
+    robot.off_time = 0;
+    robot.distance = 0;
+    robot.on_track = true;
+
+    robot.result.lap_time = -1;
+    robot.result.off_track = 0;
+    robot.result.frames = 0;
+    robot.motors->start();
+}
+
+/* Run a frame of the line follower on a robot.
+   Parameters:
+     * robot: the robot.
+   Return false when the robot completes a lap, it goes out of the track for
+   too long or the time runs out.
+*/
+bool
+step_robot(robot_t& robot)
+{
+    vector<glm::vec2> path;
+    struct timespec timestamp;
+    int segment;
+    float t;
+
+    robot.camera->fetch();
+    Mat& frame = robot.camera->next();
+    timestamp = robot.camera->get_timestamp();
+    t = timestamp.tv_sec + timestamp.tv_nsec * 1e-9;
+    if (t > max_time)
+        return false;
+
+    // The same as the autonomous mode of the line follower
+    robot.road_finder->find(frame, timestamp, robot.road);
+    robot.path_finder->find(robot.road, path);
+    if (path.size() > 2) {
+        glm::vec2 v = glm::normalize(path[2] - path[0]);
+        robot.pilot->set_angle(-v[0], robot.road.get_timestamp());
+    }
+    robot.road_finder->set_motors(robot.pilot->get_speed(),
+        robot.pilot->get_turn());
+    robot.result.frames++;
+
+    // Measure where the motors have taken the robot
+    robot.camera->get_position(robot.position, robot.orientation,
+        robot.normal);
+    if ((segment = robot.track->find_segment(robot.position,
+        robot.segment)) < 0)
+    {
+        if (robot.on_track) {
+            robot.result.off_track++;
+            robot.off_time = t;
+            robot.on_track = false;
+        } else if (t - robot.off_time > OFF_TRACK_TIMEOUT) {
+            return false;
+        }
+        return true;
+    }
+    robot.on_track = true;
+    robot.distance += robot.track->get_center_distance(segment,
+        robot.position);
+    robot.on_frames++;
+    if (!robot.closed) {
+        if (segment == (int)robot.visited.size() - 1) {
+            robot.result.lap_time = t;
+            return false;
+        }
+    } else if (!robot.visited[segment]) {
+        robot.visited[segment] = true;
+        robot.nvisited++;
+    } else if (segment == robot.start
+        && robot.nvisited == robot.visited.size())
+    {
+        robot.result.lap_time = t;
+        return false;
+    }
+    return true;
+}
+
+/* Run the line follower on the virtual track with several robots at once,
+   until each one completes a lap, it goes out of the track for too long or
+   the time runs out. The robots share the track, loaded only once, and
+   they run a frame each in turn.
+   Parameters:
+     * options: options of the run of each robot.
+     * results: output result of the run of each robot.
+*/
+void
+run(const vector<Options>& options, vector<run_result_t>& results)
+{
+    vector<robot_t> robots(options.size());
+    vector<bool> running(options.size(), true);
+    size_t nrunning = robots.size();
+
+    for (size_t i = 0; i < robots.size(); i++) {
+        create_robot(options[i], i > 0 ? robots[0].camera : 0, robots[i]);
+    }
+    while (nrunning > 0) {
+        // The frames of all the robots are rendered before the first one is
+        // read back, so the GPU renders a frame while another is used. Each
+        // one is rendered after its robot has moved, as in step_robot.
+        for (size_t i = 0; i < robots.size(); i++) {
+            if (running[i])
+                robots[i].camera->render_next();
+        }
+        for (size_t i = 0; i < robots.size(); i++) {
+            if (running[i] && !step_robot(robots[i])) {
+                running[i] = false;
+                nrunning--;
+            }
+        }
+    }
+
+    // The cameras that share the track of the first one go first
+    results.resize(robots.size());
+    for (size_t i = robots.size(); i-- > 0;) {
+        robot_t& robot = robots[i];
+        robot.result.cross_track_error = robot.on_frames ?
+            robot.distance / robot.on_frames : 0;
+        results[i] = robot.result;
+        delete robot.path_finder;
+        delete robot.road_finder;
+        delete robot.pilot;
+        delete robot.motors;
+        delete robot.camera;
+    }
+}
+
+/* Start a worker process that runs some combinations, one after another,
+   with a robot for each one.
+   Parameters:
+     * options: options of the configuration file.
+     * grid: the parameters.
+     * combination: number of the first combination.
+     * ncombinations: number of combinations.
+     * worker: output worker process.
+*/
+void
+start_worker(const Options& options, const vector<grid_param_t>& grid,
+    size_t combination, size_t ncombinations, worker_t& worker)
+{
+    vector<size_t> indices;
+    vector<Options> run_options;
+    vector<run_result_t> results;
+    int fds[2];
+
+    if (pipe(fds) < 0)
+        err(1, "cannot create pipe");
+    // Don't give the pending output to the worker too
+    fflush(stdout);
+    if ((worker.pid = fork()) < 0)
+        err(1, "cannot create worker process");
+    if (!worker.pid) {
+        // Each worker has its own OpenGL context, created after the fork
+        close(fds[0]);
+        run_options.resize(ncombinations, options);
+        for (size_t c = 0; c < ncombinations; c++) {
+            get_combination(grid, combination + c, indices);
+            for (size_t i = 0; i < grid.size(); i++) {
+                run_options[c].set(grid[i].name, grid[i].values[indices[i]]);
+            }
+        }
+        run(run_options, results);
+        if (write(fds[1], &results[0], ncombinations * sizeof(run_result_t))
+            != (ssize_t)(ncombinations * sizeof(run_result_t)))
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    worker.fd = fds[0];
+    worker.combination = combination;
+    worker.ncombinations = ncombinations;
+    worker.received = 0;
+}
+
+/* Read the results that a worker process has written in its pipe so far.
+   Parameters:
+     * worker: the worker.
+     * results: results of the combinations.
+   Return true when the pipe has been closed, because the worker has
+   finished.
+*/
+bool
+read_results(worker_t& worker, vector<run_result_t>& results)
+{
+    size_t n = worker.ncombinations * sizeof(run_result_t);
+    ssize_t r;
+    char extra;
+
+    // Anything written after the results is read too, and makes the
+    // combinations fail
+    if (worker.received < n) {
+        r = read(worker.fd,
+            (char *)&results[worker.combination] + worker.received,
+            n - worker.received);
+    } else {
+        r = read(worker.fd, &extra, 1);
+    }
+    if (r < 0)
+        return errno != EINTR;
+    worker.received += r;
+    return r == 0;
+}
+
+/* Wait until a worker process finishes and get its results. The pipes are
+   read while the workers run, and a worker is waited for only when its pipe
+   has been closed, so that it never blocks writing in a full pipe.
+   Parameters:
+     * workers: the running workers (the finished one is removed).
+     * results: results of the combinations.
+     * done: tells which combinations have finished.
+     * failed: tells which combinations have failed.
+*/
+void
+wait_worker(vector<worker_t>& workers, vector<run_result_t>& results,
+    vector<bool>& done, vector<bool>& failed)
+{
+    vector<struct pollfd> fds(workers.size());
+    vector<worker_t>::iterator it;
+    ssize_t finished = -1;
+    int status;
+    size_t c, n;
+    bool ok;
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        fds[i].fd = workers[i].fd;
+        fds[i].events = POLLIN;
+    }
+    while (finished < 0) {
+        if (poll(&fds[0], fds.size(), -1) < 0) {
+            if (errno != EINTR)
+                err(1, "cannot wait for the workers");
+            continue;
+        }
+        for (size_t i = 0; i < workers.size() && finished < 0; i++) {
+            if (fds[i].revents && read_results(workers[i], results))
+                finished = i;
+        }
+    }
+    it = workers.begin() + finished;
+    while (waitpid(it->pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            err(1, "cannot wait for the workers");
+    }
+    c = it->combination;
+    n = it->ncombinations;
+    ok = WIFEXITED(status) && !WEXITSTATUS(status)
+        && it->received == n * sizeof(run_result_t);
+    for (size_t i = c; i < c + n; i++) {
+        if (!ok) {
+            warnx("combination %zu failed", i + 1);
+            failed[i] = true;
+        }
+        done[i] = true;
+    }
+    close(it->fd);
+    workers.erase(it);
+}
+
+/* Print the results of the finished combinations that haven't been printed,
+   in order.
+   Parameters:
+     * grid: the parameters.
+     * results: results of the combinations.
+     * done: tells which combinations have finished.
+     * failed: tells which combinations have failed.
+     * next: next combination to print (it's updated).
+*/
+void
+print_results(const vector<grid_param_t>& grid,
+    const vector<run_result_t>& results, const vector<bool>& done,
+    const vector<bool>& failed, size_t& next)
+{
+    vector<size_t> indices;
+
+    for (; next < done.size() && done[next]; next++) {
+        get_combination(grid, next, indices);
+        for (size_t i = 0; i < grid.size(); i++) {
+            printf("%s,", grid[i].values[indices[i]].c_str());
+        }
+        if (failed[next]) {
+            printf(",,,\n");
+            continue;
+        }
+        // The lap time is empty if the lap wasn't completed
+        if (results[next].lap_time >= 0)
+            printf("%.3f", results[next].lap_time);
+        printf(",%u,%.3f,%lu\n", results[next].off_track,
+            results[next].cross_track_error, results[next].frames);
+    }
+    fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+    map<string, string> defaults;
+    Options options;
+    vector<grid_param_t> grid;
+    vector<run_result_t> results;
+    vector<bool> done, failed;
+    vector<worker_t> workers;
+    size_t ncombinations = 1, next = 0;
+
+    parse_args(argc, argv);
+    pipeline::set_default_options(defaults);
+    options = Options(config_file, defaults);
+    // The robots always have a virtual camera and virtual motors
+    options.set("Camera", "virtual");
+    options.set("Motors", "virtual");
+    load_grid(grid_file, grid);
+    for (size_t i = 0; i < grid.size(); i++) {
+        ncombinations *= grid[i].values.size();
+        // A misspelt option would be set without changing anything
+        try {
+            options.get_string(grid[i].name);
+        } catch (FollowException& e) {
+            errx(1, "unknown option %s in the grid", grid[i].name.c_str());
+        }
+        // The robots of a worker share the track of the first one
+        if (nrobots > 1 && (grid[i].name == "TrackFile"
+            || grid[i].name == "TrackStreamRadius"))
+        {
+            errx(1, "%s can't change with several robots",
+                grid[i].name.c_str());
+        }
+    }
+    results.resize(ncombinations);
+    done.resize(ncombinations, false);
+    failed.resize(ncombinations, false);
+
+    for (size_t i = 0; i < grid.size(); i++) {
+        printf("%s,", grid[i].name.c_str());
+    }
+    printf("lap_time,off_track,cross_track_error,frames\n");
+
+    // Keep njobs workers running, each one with nrobots combinations
+    for (size_t c = 0; c < ncombinations; c += nrobots) {
+        if (workers.size() == (size_t)njobs) {
+            wait_worker(workers, results, done, failed);
+            print_results(grid, results, done, failed, next);
+        }
+        workers.push_back(worker_t());
+        start_worker(options, grid, c,
+            min((size_t)nrobots, ncombinations - c), workers.back());
+    }
+    while (!workers.empty()) {
+        wait_worker(workers, results, done, failed);
+        print_results(grid, results, done, failed, next);
+    }
+    return 0;
+}
+
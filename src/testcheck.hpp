@@ -0,0 +1,18 @@
+/* testcheck.hpp
+   Checks of the tests run by make check. Each test is a single program that
+   reports its failed checks and returns failures ? 1 : 0 from main.
+*/
+
+#ifndef TESTCHECK_HPP
+#define TESTCHECK_HPP
+
+#include <err.h>
+
+// Number of failed checks
+static int failures = 0;
+
+// Report a failed check
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { warnx(__VA_ARGS__); failures++; } } while (0)
+
+#endif
@@ -0,0 +1,349 @@
+
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdlib.h>
+
+#include "followexception.hpp"
+#include "trackfile.hpp"
+
+// Maximum number of segments removed to get out of a dead end, for each
+// segment of the track, before the generation is given up
+#define MAX_BACKTRACKS  100
+
+// Cell of the grid of the generated tracks
+typedef pair<int, int> cell_t;
+
+// How a segment type is placed on the grid, relative to the cell where the
+// track enters it and to the direction of the track: the first coordinate
+// is forwards and the second one to the left
+typedef struct {
+    segment_type_t type;
+    // Input of the segment, or output taken by the next one (crossroads)
+    int branch;
+    // Cells covered by the segment
+    int ncells;
+    int cells[4][2];
+    // Cell of the branch not taken, kept empty (only crossroads)
+    bool has_reserved;
+    int reserved[2];
+    // Cell where the next segment starts and turn of the direction (1 to
+    // the left, -1 to the right)
+    int next[2];
+    int turn;
+    // Probability of the shape, relative to the others
+    unsigned int weight;
+} shape_t;
+
+// Relates segment strings IDs with their enumerations
+static const segment_id_t segments_ids[] = {
+    {SEGMENT_STRAIGHT, "Straight"},
+    {SEGMENT_TURNLEFT, "TurnLeft"},
+    {SEGMENT_TURNRIGHT, "TurnRight"},
+    {SEGMENT_DASHED1, "Dashed1"},
+    {SEGMENT_DASHED2, "Dashed2"},
+    {SEGMENT_ZIGZAG, "ZigZag"},
+    {SEGMENT_WIDENARROW, "WideNarrow"},
+    {SEGMENT_NARROW, "Narrow"},
+    {SEGMENT_NARROWWIDE, "NarrowWide"},
+    {SEGMENT_VCROSSROAD, "VCrossroad"},
+    {SEGMENT_ACROSSROAD, "ACrossroad"},
+    {SEGMENT_DOUBLETURNLEFT, "DoubleTurnLeft"},
+    {SEGMENT_DOUBLETURNRIGHT, "DoubleTurnRight"}
+};
+
+// The shapes of the generated tracks
+static const shape_t shapes[] = {
+    {SEGMENT_STRAIGHT, 0, 1, {{0, 0}}, false, {0, 0}, {1, 0}, 0, 8},
+    {SEGMENT_DASHED1, 0, 1, {{0, 0}}, false, {0, 0}, {1, 0}, 0, 2},
+    {SEGMENT_DASHED2, 0, 1, {{0, 0}}, false, {0, 0}, {1, 0}, 0, 2},
+    {SEGMENT_ZIGZAG, 0, 1, {{0, 0}}, false, {0, 0}, {1, 0}, 0, 2},
+    {SEGMENT_WIDENARROW, 0, 1, {{0, 0}}, false, {0, 0}, {1, 0}, 0, 1},
+    {SEGMENT_NARROW, 0, 1, {{0, 0}}, false, {0, 0}, {1, 0}, 0, 4},
+    {SEGMENT_NARROWWIDE, 0, 1, {{0, 0}}, false, {0, 0}, {1, 0}, 0, 2},
+    {SEGMENT_TURNLEFT, 0, 1, {{0, 0}}, false, {0, 0}, {0, 1}, 1, 3},
+    {SEGMENT_TURNRIGHT, 0, 1, {{0, 0}}, false, {0, 0}, {0, -1}, -1, 3},
+    {SEGMENT_DOUBLETURNLEFT, 0, 4, {{0, 0}, {1, 0}, {0, 1}, {1, 1}},
+        false, {0, 0}, {1, 2}, 1, 1},
+    {SEGMENT_DOUBLETURNRIGHT, 0, 4, {{0, 0}, {1, 0}, {0, -1}, {1, -1}},
+        false, {0, 0}, {1, -2}, -1, 1},
+    {SEGMENT_VCROSSROAD, 0, 1, {{0, 0}}, true, {0, -1}, {0, 1}, 1, 1},
+    {SEGMENT_VCROSSROAD, 1, 1, {{0, 0}}, true, {0, 1}, {0, -1}, -1, 1},
+    {SEGMENT_ACROSSROAD, 0, 1, {{0, 0}}, true, {0, -1}, {0, 1}, 1, 1},
+    {SEGMENT_ACROSSROAD, 1, 1, {{0, 0}}, true, {0, 1}, {0, -1}, -1, 1}
+};
+
+#define NUM_SHAPES  (sizeof(shapes)/sizeof(shape_t))
+
+// Directions of the grid, starting with +X and turning to the left. The
+// tracks start at the cell (0, 0) going to +Y, as the virtual track.
+static const int directions[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+// Where a segment of a generated track is placed
+typedef struct {
+    // Cell where the track enters, direction and if the road is narrow
+    cell_t cell;
+    int dir;
+    bool narrow;
+    // The shape, and the shapes already tried at this place
+    size_t shape;
+    uint32_t tried;
+} placement_t;
+
+/* Return the cell at a position relative to a placement.
+   Parameters:
+     * p: the placement.
+     * rel: the position, forwards and to the left.
+*/
+static cell_t
+get_cell(const placement_t& p, const int rel[2])
+{
+    const int *f = directions[p.dir], *l = directions[(p.dir + 1) % 4];
+
+    return cell_t(p.cell.first + rel[0] * f[0] + rel[1] * l[0],
+        p.cell.second + rel[0] * f[1] + rel[1] * l[1]);
+}
+
+/* Return if a shape can be placed.
+   Parameters:
+     * p: the placement.
+     * shape: the shape.
+     * remaining: number of segments left, including this one.
+     * used: the cells already used.
+*/
+static bool
+fits(const placement_t& p, const shape_t& shape, size_t remaining,
+    const set<cell_t>& used)
+{
+    bool narrow_type = shape.type == SEGMENT_NARROW
+        || shape.type == SEGMENT_NARROWWIDE;
+
+    // The track never goes to -X, so it can't get into a dead end
+    if ((p.dir + shape.turn + 4) % 4 == 2)
+        return false;
+
+    // A narrow road is made of Narrow segments between a WideNarrow and a
+    // NarrowWide, and it's closed before the end of the track
+    if (p.narrow != narrow_type)
+        return false;
+    if (shape.type == SEGMENT_WIDENARROW && remaining < 2)
+        return false;
+    if (shape.type == SEGMENT_NARROW && remaining < 2)
+        return false;
+
+    for (int i = 0; i < shape.ncells; i++) {
+        if (used.count(get_cell(p, shape.cells[i])))
+            return false;
+    }
+    if (shape.has_reserved && used.count(get_cell(p, shape.reserved)))
+        return false;
+    return remaining == 1 || !used.count(get_cell(p, shape.next));
+}
+
+/* Mark or unmark the cells of a shape as used.
+   Parameters:
+     * p: the placement, with the shape.
+     * used: the cells used.
+     * mark: true to mark them, false to unmark them.
+*/
+static void
+mark_cells(const placement_t& p, set<cell_t>& used, bool mark)
+{
+    const shape_t& shape = shapes[p.shape];
+
+    for (int i = 0; i < shape.ncells; i++) {
+        if (mark)
+            used.insert(get_cell(p, shape.cells[i]));
+        else
+            used.erase(get_cell(p, shape.cells[i]));
+    }
+    if (shape.has_reserved) {
+        if (mark)
+            used.insert(get_cell(p, shape.reserved));
+        else
+            used.erase(get_cell(p, shape.reserved));
+    }
+}
+
+/* Generate a random track, a chain of segments of all the types that doesn't
+   cross itself. It's a random walk over the grid: each segment is chosen at
+   random among the shapes that fit, and when none fits the last segments
+   are removed to try other shapes. As the walk never goes to -X, it never
+   gets back to a column of cells that it left, and that only happens at the
+   end of a narrow road.
+   Parameters:
+     * nsegments: number of segments.
+     * seed: seed of the random numbers, the same seed gives the same track.
+     * segments: output segments of the track.
+   Throws FollowException if the track can't be generated.
+*/
+void
+trackfile::generate(size_t nsegments, unsigned int seed,
+    vector<segment_t>& segments)
+{
+    // The raw output of the generator is the same with every library
+    mt19937 rng(seed);
+    vector<placement_t> track;
+    set<cell_t> used;
+    placement_t p = {cell_t(0, 0), 1, false, 0, 0};
+    unsigned int total, r;
+    size_t backtracks = 0;
+    segment_t s;
+
+    while (track.size() < nsegments) {
+        total = 0;
+        for (size_t i = 0; i < NUM_SHAPES; i++) {
+            if (!(p.tried & (1 << i))
+                && fits(p, shapes[i], nsegments - track.size(), used))
+            {
+                total += shapes[i].weight;
+            }
+        }
+
+        // Dead end, try another shape for the last segment
+        if (!total) {
+            if (track.empty() || ++backtracks > MAX_BACKTRACKS * nsegments) {
+                throw FollowException("cannot generate a track of "
+                    + to_string(nsegments) + " segments");
+            }
+            p = track.back();
+            track.pop_back();
+            mark_cells(p, used, false);
+            continue;
+        }
+
+        // Choose a shape with its probability
+        r = rng() % total;
+        for (p.shape = 0; p.shape < NUM_SHAPES; p.shape++) {
+            if (!(p.tried & (1 << p.shape))
+                && fits(p, shapes[p.shape], nsegments - track.size(), used))
+            {
+                if (r < shapes[p.shape].weight)
+                    break;
+                r -= shapes[p.shape].weight;
+            }
+        }
+        p.tried |= 1 << p.shape;
+        mark_cells(p, used, true);
+        track.push_back(p);
+
+        // The next segment starts where this one ends
+        const shape_t& shape = shapes[p.shape];
+        p.cell = get_cell(p, shape.next);
+        p.dir = (p.dir + shape.turn + 4) % 4;
+        if (shape.type == SEGMENT_WIDENARROW)
+            p.narrow = true;
+        else if (shape.type == SEGMENT_NARROWWIDE)
+            p.narrow = false;
+        p.tried = 0;
+    }
+
+    // Each segment follows the previous one, through the branch taken if
+    // it's a VCrossroad
+    for (size_t i = 0; i < track.size(); i++) {
+        const shape_t& shape = shapes[track[i].shape];
+        s.type = shape.type;
+        s.input = shape.type == SEGMENT_ACROSSROAD ? shape.branch : 0;
+        s.prev = -1;
+        s.output = 0;
+        if (i > 0 && shapes[track[i - 1].shape].type == SEGMENT_VCROSSROAD)
+            s.output = shapes[track[i - 1].shape].branch;
+        segments.push_back(s);
+    }
+}
+
+/* Load a track file.
+   Parameters:
+     * file: path of the track file.
+     * segments: output segments of the track.
+   Throws FollowException if the file can't be read or has a wrong segment.
+*/
+void
+trackfile::load(const string& file, vector<segment_t>& segments)
+{
+    string line;
+    size_t linenum = 1, sep;
+    ifstream f(file);
+    segment_t s;
+
+    if (f.fail()) {
+        throw FollowException("cannot open file " + file);
+    }
+    while (getline(f, line)) {
+        // Ignore comments
+        if (line[0] == '#') continue;
+        // Get the elements of the line
+        stringstream ss(line);
+        string stype, sinput, soutput;
+        ss >> stype >> sinput >> soutput;
+        // Get the type of segment
+        s.type = SEGMENT_NULL;
+        for (size_t i = 0; i < sizeof(segments_ids)/sizeof(segment_id_t);
+            i++)
+        {
+            if (stype == segments_ids[i].str_id) {
+                s.type = segments_ids[i].type;
+            }
+        }
+        if (s.type == SEGMENT_NULL) {
+            throw FollowException("wrong track segment '" + line
+                + "' (line " + to_string(linenum) + ")");
+        }
+        // Get the input
+        s.input = (sinput != "") ? atoi(sinput.c_str()) : 0;
+        // Get the output
+        if (soutput != "") {
+            sep = soutput.find(':');
+            if (sep != soutput.npos) {
+                s.prev = atoi(soutput.substr(0, sep).c_str());
+                s.output = atoi(soutput.substr(sep + 1).c_str());
+            } else {
+                s.prev = atoi(soutput.c_str());
+                s.output = 0;
+            }
+        } else {
+            s.prev = -1;
+            s.output = 0;
+        }
+        segments.push_back(s);
+        linenum++;
+    }
+}
+
+/* Save a track file.
+   Parameters:
+     * file: path of the track file.
+     * segments: segments of the track.
+   Throws FollowException if the file can't be written.
+*/
+void
+trackfile::save(const string& file, const vector<segment_t>& segments)
+{
+    ofstream f(file);
+    const char *str_id;
+
+    if (f.fail()) {
+        throw FollowException("cannot create file " + file);
+    }
+    for (size_t i = 0; i < segments.size(); i++) {
+        str_id = 0;
+        for (size_t j = 0; j < sizeof(segments_ids)/sizeof(segment_id_t);
+            j++)
+        {
+            if (segments[i].type == segments_ids[j].type)
+                str_id = segments_ids[j].str_id;
+        }
+        if (!str_id) {
+            throw FollowException("wrong track segment "
+                + to_string(segments[i].type));
+        }
+        f << str_id << " " << segments[i].input << " " << segments[i].prev
+            << ":" << segments[i].output << "\n";
+    }
+    f.close();
+    if (f.fail()) {
+        throw FollowException("cannot write file " + file);
+    }
+}
+
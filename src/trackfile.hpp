@@ -0,0 +1,65 @@
+/* trackfile.hpp
+   Reads the files that describe the virtual tracks. Each line of a track
+   file is a segment: its type, the input that connects it with the previous
+   segment and the previous segment with the output to connect to
+   ("prev:output", the output is 0 if not given, and the previous segment is
+   the last one if not given). The lines that start with '#' are comments.
+   Also generates random tracks, to test with tracks too long to write by
+   hand.
+*/
+
+#ifndef TRACKFILE_HPP
+#define TRACKFILE_HPP
+
+#include <string>
+#include <vector>
+
+#include "virtualtrack.hpp"
+
+using namespace std;
+
+// Type that relates the string identifier of a segment type with its
+// enumeration
+typedef struct {
+    segment_type_t type;
+    const char *str_id;
+} segment_id_t;
+
+namespace trackfile {
+
+    /* Load a track file.
+       Parameters:
+         * file: path of the track file.
+         * segments: output segments of the track.
+       Throws FollowException if the file can't be read or has a wrong
+       segment.
+    */
+    void load(const string& file, vector<segment_t>& segments);
+
+    /* Generate a random track, a chain of segments of all the types that
+       doesn't cross itself. The segments are placed on a grid of square
+       cells of the size of a straight segment, and the track goes up and
+       down while it advances to +X. The crossroads are taken through one
+       of their branches, and the cell of the other branch is left empty.
+       Parameters:
+         * nsegments: number of segments.
+         * seed: seed of the random numbers, the same seed gives the same
+                 track.
+         * segments: output segments of the track.
+       Throws FollowException if the track can't be generated.
+    */
+    void generate(size_t nsegments, unsigned int seed,
+        vector<segment_t>& segments);
+
+    /* Save a track file.
+       Parameters:
+         * file: path of the track file.
+         * segments: segments of the track.
+       Throws FollowException if the file can't be written.
+    */
+    void save(const string& file, const vector<segment_t>& segments);
+
+}
+
+#endif
+
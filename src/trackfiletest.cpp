@@ -0,0 +1,224 @@
+/* trackfiletest.cpp
+   Checks the random tracks of trackfile::generate, that the tracks are
+   written and read back the same, and that the track files are parsed as
+   documented.
+*/
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "followexception.hpp"
+#include "testcheck.hpp"
+#include "trackfile.hpp"
+
+// Number of segments of the long tracks, that have all the segment types
+#define LONG_TRACK      1000
+
+// Number of seeds tried
+#define NSEEDS          20
+
+// Number of segment types (SEGMENT_NULL isn't one)
+#define NUM_TYPES       SEGMENT_DOUBLETURNRIGHT
+
+// Return true if two tracks are the same
+bool
+same_track(const vector<segment_t>& a, const vector<segment_t>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].type != b[i].type || a[i].input != b[i].input
+            || a[i].prev != b[i].prev || a[i].output != b[i].output)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Write a file.
+   Parameters:
+     * file: path of the file.
+     * contents: the contents.
+*/
+void
+write_file(const string& file, const string& contents)
+{
+    FILE *f;
+
+    if (!(f = fopen(file.c_str(), "w")))
+        err(1, "cannot create %s", file.c_str());
+    fputs(contents.c_str(), f);
+    if (ferror(f) || fclose(f) != 0)
+        err(1, "cannot write %s", file.c_str());
+}
+
+/* Check a generated track: its length, that each segment follows the
+   previous one, and that the narrow roads are closed.
+   Parameters:
+     * segments: the track.
+     * nsegments: number of segments asked for.
+     * seed: seed of the track, for the messages.
+*/
+void
+check_track(const vector<segment_t>& segments, size_t nsegments,
+    unsigned int seed)
+{
+    bool narrow = false;
+
+    CHECK(segments.size() == nsegments, "seed %u: %zu segments instead of %zu",
+        seed, segments.size(), nsegments);
+    for (size_t i = 0; i < segments.size(); i++) {
+        const segment_t& s = segments[i];
+
+        CHECK(s.prev == -1, "seed %u: segment %zu doesn't follow the "
+            "previous one", seed, i);
+        CHECK(s.type == SEGMENT_ACROSSROAD || s.input == 0,
+            "seed %u: segment %zu has input %d", seed, i, s.input);
+        CHECK((i > 0 && segments[i - 1].type == SEGMENT_VCROSSROAD)
+            || s.output == 0, "seed %u: segment %zu uses output %d", seed, i,
+            s.output);
+        // The Narrow segments are only between a WideNarrow and a
+        // NarrowWide
+        if (s.type == SEGMENT_WIDENARROW) {
+            CHECK(!narrow, "seed %u: segment %zu narrows a narrow road",
+                seed, i);
+            narrow = true;
+        } else if (s.type == SEGMENT_NARROWWIDE) {
+            CHECK(narrow, "seed %u: segment %zu widens a wide road", seed, i);
+            narrow = false;
+        } else {
+            CHECK(narrow == (s.type == SEGMENT_NARROW),
+                "seed %u: segment %zu doesn't fit the width of the road",
+                seed, i);
+        }
+    }
+    CHECK(!narrow, "seed %u: the track ends in a narrow road", seed);
+}
+
+// Check the generated tracks
+void
+check_generate()
+{
+    vector<segment_t> a, b;
+    vector<bool> types;
+    size_t lengths[] = {1, 2, 3, 10, LONG_TRACK};
+
+    for (unsigned int seed = 1; seed <= NSEEDS; seed++) {
+        for (size_t l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+            a.clear();
+            try {
+                trackfile::generate(lengths[l], seed, a);
+            } catch (FollowException& e) {
+                CHECK(false, "seed %u: %s", seed, e.what());
+                continue;
+            }
+            check_track(a, lengths[l], seed);
+        }
+
+        // The same seed gives the same track, and all the types are used
+        b.clear();
+        trackfile::generate(LONG_TRACK, seed, b);
+        CHECK(same_track(a, b), "seed %u: two different tracks", seed);
+        types.assign(NUM_TYPES + 1, false);
+        for (size_t i = 0; i < b.size(); i++) {
+            types[b[i].type] = true;
+        }
+        for (int t = 1; t <= NUM_TYPES; t++) {
+            CHECK(types[t], "seed %u: no segment of type %d", seed, t);
+        }
+    }
+}
+
+/* Check that a track is saved and loaded back the same.
+   Parameters:
+     * file: path of the track file.
+*/
+void
+check_save_load(const string& file)
+{
+    vector<segment_t> a, b;
+
+    trackfile::generate(LONG_TRACK, 1, a);
+    try {
+        trackfile::save(file, a);
+        trackfile::load(file, b);
+        CHECK(same_track(a, b), "the track loaded isn't the one saved");
+    } catch (FollowException& e) {
+        CHECK(false, "cannot save and load a track: %s", e.what());
+    }
+}
+
+/* Check the parsing of a track file.
+   Parameters:
+     * file: path of the track file.
+*/
+void
+check_parse(const string& file)
+{
+    vector<segment_t> segments;
+    segment_t expected[] = {
+        {SEGMENT_STRAIGHT, 0, -1, 0},
+        {SEGMENT_VCROSSROAD, 0, -1, 0},
+        {SEGMENT_TURNLEFT, 0, 1, 1},
+        {SEGMENT_ACROSSROAD, 1, 2, 0},
+        {SEGMENT_NARROW, 0, -1, 0}
+    };
+
+    write_file(file, "# A comment\n"
+                     "Straight\n"
+                     "VCrossroad 0\n"
+                     "TurnLeft 0 1:1\n"
+                     "# Another comment\n"
+                     "ACrossroad 1 2\n"
+                     "Narrow 0 -1:0\n");
+    try {
+        trackfile::load(file, segments);
+        CHECK(same_track(segments, vector<segment_t>(expected,
+            expected + sizeof(expected)/sizeof(expected[0]))),
+            "wrong segments parsed");
+    } catch (FollowException& e) {
+        CHECK(false, "cannot parse a track: %s", e.what());
+    }
+
+    // An unknown segment
+    write_file(file, "Straight\nRoundabout 0\n");
+    segments.clear();
+    try {
+        trackfile::load(file, segments);
+        CHECK(false, "unknown segment parsed");
+    } catch (FollowException& e) {
+    }
+
+    // A missing file
+    unlink(file.c_str());
+    try {
+        trackfile::load(file, segments);
+        CHECK(false, "missing file loaded");
+    } catch (FollowException& e) {
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    char dir[] = "/tmp/trackfiletest.XXXXXX";
+    string file;
+
+    if (!mkdtemp(dir))
+        err(1, "cannot create a temporary directory");
+    file = string(dir) + "/test.track";
+
+    check_generate();
+    check_save_load(file);
+    check_parse(file);
+
+    unlink(file.c_str());
+    rmdir(dir);
+    return failures ? 1 : 0;
+}
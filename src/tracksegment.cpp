@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtx/vector_angle.hpp>
 
@@ -7,7 +8,7 @@
 
 TrackSegment::TrackSegment(const glm::vec3& position, float orientation,
         int input, size_t num_vertices, size_t num_indices):
-    position(position), orientation(orientation), input(input),
+    position(position), orientation(orientation), input(input), outputs(0),
     num_vertices(num_vertices), num_indices(num_indices),
     bb_min(INT_MAX, INT_MAX), bb_max(INT_MIN, INT_MIN)
 {}
@@ -53,6 +54,16 @@ TrackSegment::get_bounding_box(glm::vec2& min, glm::vec2& max) const
     max = bb_max;
 }
 
+/* Tell that an output connects with a next segment.
+   Parameters:
+     * output: the index of the output.
+*/
+void
+TrackSegment::use_output(int output)
+{
+    outputs |= 1 << output;
+}
+
 // Return the number of indices of the geometry
 size_t
 TrackSegment::get_num_indices()
@@ -83,10 +94,10 @@ TrackSegment::compute_bounding_box(const gl_vertex_t *vertices, size_t nv)
     }
 }
 
-// Fill the vertex and index buffers
+// Rotate and translate the vertices to the place of this segment
 void
-TrackSegment::fill_buffers(const gl_vertex_t *vertices,
-    gl_vertex_t *tr_vertices, const GLushort *indices, GLushort *tr_indices)
+TrackSegment::transform_vertices(const gl_vertex_t *vertices,
+    gl_vertex_t *tr_vertices) const
 {
     glm::mat4 m(1);
 
@@ -101,21 +112,22 @@ TrackSegment::fill_buffers(const gl_vertex_t *vertices,
             m * glm::vec4(vertices[i].normal, 0.0));
         tr_vertices[i].texcoord = vertices[i].texcoord;
     }
+}
 
-    // Add to the indices the first_vertex offset
+// Fill the vertices and the indices of this segment in the buffers of the
+// track
+void
+TrackSegment::fill_buffers(const gl_vertex_t *vertices,
+    const GLushort *indices, size_t first_vertex, size_t first_index,
+    const gl_context_t& context)
+{
+    this->first_vertex = first_vertex;
+    this->first_index = first_index;
+
+    // The indices are 32 bits wide, the track builds the index buffer from
+    // them
+    transform_vertices(vertices, context.vertices + first_vertex);
     for (size_t i = 0; i < num_indices; i++) {
-        tr_indices[i] = indices[i] + first_vertex;
+        context.indices[first_index + i] = indices[i] + first_vertex;
     }
-
-    // Insert the vertex and index data in the buffers
-    glBindBuffer(GL_ARRAY_BUFFER, context.vertex_buffer);
-    glBufferSubData(GL_ARRAY_BUFFER, first_vertex * sizeof(gl_vertex_t),
-        num_vertices * sizeof(gl_vertex_t), tr_vertices);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first_index * sizeof(GLushort),
-        num_indices * sizeof(GLushort), tr_indices);
-
-    // Compute the bounding box
-    compute_bounding_box(tr_vertices, num_vertices);
 }
-
@@ -5,9 +5,12 @@
 #include <GLES2/gl2.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <vector>
 
 #include "gl.hpp"
 
+using namespace std;
+
 // Default height of the segments
 #define SEGMENT_H   2
 
@@ -22,6 +25,13 @@ class TrackSegment {
         // Return true if this segment contains the projection of point
         virtual bool contains(const glm::vec3& point) const = 0;
 
+        /* Return the distance from the projection of a point to the center
+           line of the road of this segment.
+           Parameters:
+             * point: the point.
+        */
+        virtual float get_center_distance(const glm::vec3& point) const = 0;
+
         /* Given a position and an orientation and normal vectors, correct them
            to make sure that they are over the segment.
            Parameters:
@@ -44,25 +54,42 @@ class TrackSegment {
         virtual void get_output(
             int output, glm::vec3& pos, float& orient) const = 0;
 
+        /* Tell that an output connects with a next segment.
+           Parameters:
+             * output: the index of the output.
+        */
+        void use_output(int output);
+
         // Return the number of indices of the geometry
         size_t get_num_indices();
 
         // Return the number of vertices of the geometry
         size_t get_num_vertices();
 
-        /* Initialize the geometry.
+        /* Initialize the geometry: the bounding box and the shape used by
+           contains. It's done once, the segment doesn't move.
+        */
+        virtual void init_geometry() = 0;
+
+        /* Write the vertices and the indices of this segment in the buffers
+           of the track. Only the places in the buffers change, so it can be
+           done while other threads call contains.
            Parameters:
              * first_vertex: index in the OpenGL Vertex Buffer for the first
                  vertex of this segment.
              * first_index: index in the OpenGL Index Buffer for the first
                  index of this segment.
-             * context: OpenGL objects.
+             * context: OpenGL objects, with the buffers being built.
         */
-        virtual void init_geometry(size_t first_vertex, size_t first_index,
+        virtual void fill_geometry(size_t first_vertex, size_t first_index,
             const gl_context_t& context) = 0;
 
-        // Render this segment
-        virtual void render() = 0;
+        /* Add the draws of this segment: for each part, its texture, its
+           primitive and its range of the index buffer.
+           Parameters:
+             * draws: vector where to add the draws.
+        */
+        virtual void get_draws(vector<gl_draw_t>& draws) const = 0;
 
     protected:
 
@@ -72,9 +99,6 @@ class TrackSegment {
         // Segment orientation (angle in the plane, in degrees)
         float orientation;
 
-        // OpenGL context
-        gl_context_t context;
-
         // First vertex in the Vertex Buffer for this segment
         GLintptr first_vertex;
 
@@ -84,6 +108,9 @@ class TrackSegment {
         // Input to use to connect this segment with the previous one
         int input;
 
+        // Outputs that connect with a next segment (a bit for each one)
+        unsigned int outputs;
+
         // Geometry size
         size_t num_vertices;
         size_t num_indices;
@@ -95,10 +122,15 @@ class TrackSegment {
         // Compute the bounding box of this segment
         void compute_bounding_box(const gl_vertex_t *vertices, size_t nv);
 
-        // Fill the vertex and index buffers
+        // Rotate and translate the vertices to the place of this segment
+        void transform_vertices(const gl_vertex_t *vertices,
+            gl_vertex_t *tr_vertices) const;
+
+        // Fill the vertices and the indices of this segment in the buffers
+        // of the track
         void fill_buffers(const gl_vertex_t *vertices,
-            gl_vertex_t *tr_vertices, const GLushort *indices,
-            GLushort *tr_indices);
+            const GLushort *indices, size_t first_vertex, size_t first_index,
+            const gl_context_t& context);
 
 };
 
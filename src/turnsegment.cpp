@@ -25,26 +25,28 @@ TurnSegment::contains(const glm::vec3& point) const
         && length(am) <= SEGMENT_R;
 }
 
-/* Initialize the geometry.
+/* Return the distance from the projection of a point to the center line of
+   the road of this segment, the arc at half the radius.
    Parameters:
-     * first_vertex: index in the OpenGL Vertex Buffer for the first
-         vertex of this segment.
-     * first_index: index in the OpenGL Index Buffer for the first
-         index of this segment.
-     * context: OpenGL objects.
+     * point: the point.
 */
+float
+TurnSegment::get_center_distance(const glm::vec3& point) const
+{
+    glm::vec3 am(point - a);
+
+    am[2] = 0;
+    return fabs(length(am) - SEGMENT_R/2);
+}
+
+// Initialize the geometry: the bounding box and the shape used by contains
 void
-TurnSegment::init_geometry(size_t first_vertex, size_t first_index,
-    const gl_context_t& context)
+TurnSegment::init_geometry()
 {
     gl_vertex_t tr_vertices[TURN_NUM_VERTICES];
-    GLushort tr_indices[TURN_NUM_INDICES];
-
-    this->first_vertex = first_vertex;
-    this->first_index = first_index;
-    this->context = context;
 
-    fill_buffers(vertices, tr_vertices, indices, tr_indices);
+    transform_vertices(vertices, tr_vertices);
+    compute_bounding_box(tr_vertices, TURN_NUM_VERTICES);
 
     // Precomputed variables used in the contains function
     a = tr_vertices[0].position;
@@ -55,19 +57,36 @@ TurnSegment::init_geometry(size_t first_vertex, size_t first_index,
     ad[2] = 0;
 }
 
-// Render this segment
+/* Write the vertices and the indices of this segment in the buffers of the
+   track.
+   Parameters:
+     * first_vertex: index in the OpenGL Vertex Buffer for the first
+         vertex of this segment.
+     * first_index: index in the OpenGL Index Buffer for the first
+         index of this segment.
+     * context: OpenGL objects, with the buffers being built.
+*/
+void
+TurnSegment::fill_geometry(size_t first_vertex, size_t first_index,
+    const gl_context_t& context)
+{
+    fill_buffers(vertices, indices, first_vertex, first_index, context);
+}
+
+/* Add the draws of this segment: for each part, its texture, its primitive
+   and its range of the index buffer.
+   Parameters:
+     * draws: vector where to add the draws.
+*/
 void
-TurnSegment::render()
+TurnSegment::get_draws(vector<gl_draw_t>& draws) const
 {
-    // Draw the primitives
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    // Draw the road
-    glUniform1i(context.u_texture, ROAD_TEXTURE);
-    glDrawElements(GL_TRIANGLE_FAN, NTRIANGLES + 2, GL_UNSIGNED_SHORT,
-        (void *)(first_index * sizeof(GLushort)));
-    // Draw the side
-    glUniform1i(context.u_texture, WOOD_TEXTURE);
-    glDrawElements(GL_TRIANGLE_STRIP, NTRIANGLES * 2 + 2, GL_UNSIGNED_SHORT,
-        (void *)((first_index + NTRIANGLES + 2) * sizeof(GLushort)));
+    gl_draw_t road = {ROAD_TEXTURE, GL_TRIANGLE_FAN, NTRIANGLES + 2,
+        (GLsizei)first_index};
+    gl_draw_t side = {WOOD_TEXTURE, GL_TRIANGLE_STRIP, NTRIANGLES * 2 + 2,
+        (GLsizei)first_index + NTRIANGLES + 2};
+
+    draws.push_back(road);
+    draws.push_back(side);
 }
 
@@ -22,19 +22,35 @@ class TurnSegment: public TrackSegment {
         // Return true if this segment contains the projection of point
         virtual bool contains(const glm::vec3& point) const;
 
-        /* Initialize the geometry.
+        /* Return the distance from the projection of a point to the center
+           line of the road of this segment.
+           Parameters:
+             * point: the point.
+        */
+        virtual float get_center_distance(const glm::vec3& point) const;
+
+        // Initialize the geometry: the bounding box and the shape used by
+        // contains
+        virtual void init_geometry();
+
+        /* Write the vertices and the indices of this segment in the buffers
+           of the track.
            Parameters:
              * first_vertex: index in the OpenGL Vertex Buffer for the first
                  vertex of this segment.
              * first_index: index in the OpenGL Index Buffer for the first
                  index of this segment.
-             * context: OpenGL objects.
+             * context: OpenGL objects, with the buffers being built.
         */
-        virtual void init_geometry(size_t first_vertex, size_t first_index,
+        virtual void fill_geometry(size_t first_vertex, size_t first_index,
             const gl_context_t& context);
 
-        // Render this segment
-        virtual void render();
+        /* Add the draws of this segment: for each part, its texture, its
+           primitive and its range of the index buffer.
+           Parameters:
+             * draws: vector where to add the draws.
+        */
+        virtual void get_draws(vector<gl_draw_t>& draws) const;
 
     private:
 
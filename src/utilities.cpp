@@ -16,6 +16,14 @@
 
 #define MAX_STATIC_READ     1024
 
+// Fixed point coefficients for the BGR to gray conversion. They are the same
+// that OpenCV uses in cvtColor, so the result is the same as converting the
+// whole frame.
+#define GRAY_SHIFT  14
+#define GRAY_B      1868
+#define GRAY_G      9617
+#define GRAY_R      4899
+
 // TODO: Don't use gettimeofday
 // TODO: remove writefile
 // TODO: remove readfile
@@ -118,6 +126,22 @@ utilities::loadfile(const char *filename)
     return buf;
 }
 
+/* Convert a row of BGR(A) pixels to gray.
+   Parameters:
+     * src: pointer to the first pixel of the row.
+     * size: number of pixels to convert.
+     * channels: number of color channels in src (3 or 4).
+     * dst: output gray row (must have room for size bytes).
+*/
+void
+utilities::grayrow(const uchar *src, size_t size, size_t channels, uchar *dst)
+{
+    for (size_t i = 0; i < size; i++, src += channels) {
+        dst[i] = (src[0]*GRAY_B + src[1]*GRAY_G + src[2]*GRAY_R
+            + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT;
+    }
+}
+
 /* Find the local maximums of the non-zero contiguous values in an array.
    Parameters:
      * src: the input array.
@@ -155,6 +179,20 @@ utilities::localmax(int *src, size_t size, size_t max_points, int* max)
     return num;
 }
 
+/* Extract the Y values of a row of YUYV pixels.
+   Parameters:
+     * src: pointer to the first pixel of the row.
+     * size: number of pixels to extract.
+     * dst: output gray row (must have room for size bytes).
+*/
+void
+utilities::lumarowyuyv(const uchar *src, size_t size, uchar *dst)
+{
+    for (size_t i = 0; i < size; i++, src += 2) {
+        dst[i] = src[0];
+    }
+}
+
 /* Compute the mean color of an array of pixels.
    Parameters:
      * ptr: pointer to a pixel in a Mat.
@@ -175,6 +213,55 @@ utilities::meancolor(
     mean_color = Scalar(b/size, g/size, r/size);
 }
 
+/* Compute the mean color of a part of a row of NV12 pixels.
+   Parameters:
+     * y: pointer to the first pixel of the row in the Y plane.
+     * uv: pointer to the row of the UV plane that corresponds to y.
+     * start: first pixel to use for the mean.
+     * size: number of pixels to use for the mean.
+     * mean_color: output mean color, as (Y, U, V).
+*/
+void
+utilities::meancolornv12(const uchar *y, const uchar *uv, size_t start,
+    size_t size, Scalar& mean_color)
+{
+    unsigned int sy = 0, su = 0, sv = 0;
+    const uchar *pair;
+
+    for (size_t i = start; i < start + size; i++) {
+        pair = uv + (i & ~(size_t)1);
+        sy += y[i];
+        su += pair[0];
+        sv += pair[1];
+    }
+    mean_color = Scalar(sy/size, su/size, sv/size);
+}
+
+/* Compute the mean color of a part of a row of YUYV pixels.
+   Each pair of pixels shares its U and V values, that are taken once for
+   every pixel.
+   Parameters:
+     * row: pointer to the first pixel of the row.
+     * start: first pixel to use for the mean.
+     * size: number of pixels to use for the mean.
+     * mean_color: output mean color, as (Y, U, V).
+*/
+void
+utilities::meancoloryuyv(
+    const uchar *row, size_t start, size_t size, Scalar& mean_color)
+{
+    unsigned int y = 0, u = 0, v = 0;
+    const uchar *pair;
+
+    for (size_t i = start; i < start + size; i++) {
+        pair = row + (i & ~(size_t)1) * 2;
+        y += row[i * 2];
+        u += pair[1];
+        v += pair[3];
+    }
+    mean_color = Scalar(y/size, u/size, v/size);
+}
+
 /* Plot a 1D vector.
    Parameters:
      * x: the vector to plot.
@@ -268,6 +355,29 @@ utilities::readfile(const string& file, string& value)
     close(fd);
 }
 
+/* Compute the time elapsed between two instants.
+   Parameters:
+     * t0: the first instant.
+     * t1: the second instant.
+   Return the elapsed time in seconds (negative if t1 is before t0).
+*/
+float
+utilities::timediff(const struct timespec& t0, const struct timespec& t1)
+{
+    return (float)(t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9f;
+}
+
+/* Get the current time of the monotonic clock, the one used for the frames
+   timestamps.
+   Parameters:
+     * t: the output current time.
+*/
+void
+utilities::timenow(struct timespec& t)
+{
+    clock_gettime(CLOCK_MONOTONIC, &t);
+}
+
 /* Write a value to a file.
    Parameters:
      * file: path to the file to write to.
@@ -292,3 +402,17 @@ utilities::writefile(const string& file, const string& value)
     close(fd);
 }
 
+/* Compute the distance between two YUV colors. The difference in Y counts
+   three times, so that for neutral colors (U = V = 128) the distance is the
+   same that colordistance gives for their BGR values.
+   Parameters:
+     * a: first color, as (Y, U, V).
+     * b: second color, as (Y, U, V).
+*/
+unsigned int
+utilities::yuvdistance(const Scalar& a, const Scalar& b)
+{
+    int dy = a[0] - b[0], du = a[1] - b[1], dv = a[2] - b[2];
+    return 3*dy*dy + du*du + dv*dv;
+}
+
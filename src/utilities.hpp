@@ -4,6 +4,7 @@
 
 #include "opencv2/opencv.hpp"
 #include <string>
+#include <time.h>
 
 using namespace cv;
 using namespace std;
@@ -33,9 +34,26 @@ namespace utilities {
     */
     const char *loadfile(const char *filename);
 
+    /* Convert a row of BGR(A) pixels to gray.
+       Parameters:
+         * src: pointer to the first pixel of the row.
+         * size: number of pixels to convert.
+         * channels: number of color channels in src (3 or 4).
+         * dst: output gray row (must have room for size bytes).
+    */
+    void grayrow(const uchar *src, size_t size, size_t channels, uchar *dst);
+
     // Find the local maximums of the non-zero contiguous values in an array.
     size_t localmax(int *src, size_t size, size_t max_points, int* max);
 
+    /* Extract the Y values of a row of YUYV pixels.
+       Parameters:
+         * src: pointer to the first pixel of the row.
+         * size: number of pixels to extract.
+         * dst: output gray row (must have room for size bytes).
+    */
+    void lumarowyuyv(const uchar *src, size_t size, uchar *dst);
+
     /* Compute the mean color of an array of pixels.
        Parameters:
          * ptr: pointer to a pixel in a Mat.
@@ -46,6 +64,27 @@ namespace utilities {
     void meancolor(
         uchar *ptr, size_t size, size_t channels, Scalar& mean_color);
 
+    /* Compute the mean color of a part of a row of NV12 pixels.
+       Parameters:
+         * y: pointer to the first pixel of the row in the Y plane.
+         * uv: pointer to the row of the UV plane that corresponds to y.
+         * start: first pixel to use for the mean.
+         * size: number of pixels to use for the mean.
+         * mean_color: output mean color, as (Y, U, V).
+    */
+    void meancolornv12(const uchar *y, const uchar *uv, size_t start,
+        size_t size, Scalar& mean_color);
+
+    /* Compute the mean color of a part of a row of YUYV pixels.
+       Parameters:
+         * row: pointer to the first pixel of the row.
+         * start: first pixel to use for the mean.
+         * size: number of pixels to use for the mean.
+         * mean_color: output mean color, as (Y, U, V).
+    */
+    void meancoloryuyv(
+        const uchar *row, size_t start, size_t size, Scalar& mean_color);
+
     // Plot a 1D vector.
     void plot(int *x, size_t size, int scaley, Mat& plt);
 
@@ -62,6 +101,21 @@ namespace utilities {
     */
     void readfile(const string& file, string& value);
 
+    /* Compute the time elapsed between two instants.
+       Parameters:
+         * t0: the first instant.
+         * t1: the second instant.
+       Return the elapsed time in seconds (negative if t1 is before t0).
+    */
+    float timediff(const struct timespec& t0, const struct timespec& t1);
+
+    /* Get the current time of the monotonic clock, the one used for the
+       frames timestamps.
+       Parameters:
+         * t: the output current time.
+    */
+    void timenow(struct timespec& t);
+
     /* Write a value to a file.
        Parameters:
          * file: path to the file to write to.
@@ -69,6 +123,17 @@ namespace utilities {
     */
     void writefile(const string& file, const string& value);
 
+    /* Compute the distance between two YUV colors. The difference in Y
+       counts three times, so that for neutral colors (U = V = 128) the
+       distance is the one that colordistance gives for BGR values with
+       the same differences. The luma of limited range YUV spans 219 levels
+       instead of 255, so the same colors are nearer by (219/255)^2.
+       Parameters:
+         * a: first color, as (Y, U, V).
+         * b: second color, as (Y, U, V).
+    */
+    unsigned int yuvdistance(const Scalar& a, const Scalar& b);
+
 }
 
 #endif
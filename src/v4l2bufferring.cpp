@@ -0,0 +1,257 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "followexception.hpp"
+#include "utilities.hpp"
+#include "v4l2bufferring.hpp"
+
+/* Call ioctl, retrying if it is interrupted by a signal.
+   Parameters:
+     * fd: file descriptor of the device.
+     * request: the request.
+     * arg: argument of the request.
+*/
+static int
+xioctl(int fd, unsigned long request, void *arg)
+{
+    int r;
+
+    do {
+        r = ioctl(fd, request, arg);
+    } while (r < 0 && errno == EINTR);
+    return r;
+}
+
+/* Constructor.
+   Parameters:
+     * device: path of the V4L2 device.
+     * cam_params: camera's parameters (size and pixel format).
+     * nbuffers: number of buffers to request to the driver (it can give
+         more).
+   Throws FollowException if the device can't be configured.
+*/
+V4L2BufferRing::V4L2BufferRing(const string& device,
+        const cam_params_t& cam_params, size_t nbuffers):
+    device(device), fd(-1), buffers(0), nbuffers(0), streaming(false)
+{
+    struct v4l2_capability cap;
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    try {
+        if ((fd = open(device.c_str(), O_RDWR)) < 0)
+            fail("cannot open");
+        if (xioctl(fd, VIDIOC_QUERYCAP, &cap) < 0)
+            fail("not a V4L2 device");
+        if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)
+            || !(cap.capabilities & V4L2_CAP_STREAMING))
+        {
+            throw FollowException(device + ": cannot stream video");
+        }
+        set_format(cam_params);
+        map_buffers(nbuffers);
+
+        // Give all the buffers to the driver and start streaming
+        for (size_t i = 0; i < this->nbuffers; i++)
+            enqueue(i);
+        if (xioctl(fd, VIDIOC_STREAMON, &type) < 0)
+            fail("cannot start streaming");
+        streaming = true;
+    } catch (FollowException& e) {
+        release();
+        throw;
+    }
+}
+
+V4L2BufferRing::~V4L2BufferRing()
+{
+    release();
+}
+
+// Return the number of buffers of the ring
+size_t
+V4L2BufferRing::get_size() const
+{
+    return nbuffers;
+}
+
+/* Return the memory of a buffer.
+   Parameters:
+     * index: index of the buffer.
+*/
+unsigned char *
+V4L2BufferRing::get_buffer(size_t index) const
+{
+    return buffers[index].start;
+}
+
+/* Wait until the driver fills a buffer.
+   Parameters:
+     * timestamp: output capture time of the frame, given by the driver if it
+         uses the monotonic clock.
+   Return the index of the buffer.
+*/
+size_t
+V4L2BufferRing::dequeue(struct timespec& timestamp)
+{
+    struct v4l2_buffer buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd, VIDIOC_DQBUF, &buf) < 0)
+        fail("cannot dequeue buffer");
+    // Use the time when the driver captured the frame, if it is taken from
+    // the same clock as ours
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK)
+        == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+    {
+        timestamp.tv_sec = buf.timestamp.tv_sec;
+        timestamp.tv_nsec = buf.timestamp.tv_usec * 1000;
+    } else {
+        utilities::timenow(timestamp);
+    }
+    return buf.index;
+}
+
+/* Give a buffer back to the driver.
+   Parameters:
+     * index: index of the buffer.
+*/
+void
+V4L2BufferRing::enqueue(size_t index)
+{
+    struct v4l2_buffer buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (xioctl(fd, VIDIOC_QBUF, &buf) < 0)
+        fail("cannot queue buffer");
+}
+
+// PRIVATE FUNCTIONS
+
+/* Configure the size and pixel format of the frames.
+   Parameters:
+     * cam_params: camera's parameters (size and pixel format).
+*/
+void
+V4L2BufferRing::set_format(const cam_params_t& cam_params)
+{
+    struct v4l2_format fmt;
+    size_t bytesperline;
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = cam_params.width;
+    fmt.fmt.pix.height = cam_params.height;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    switch (cam_params.pixel_format) {
+        case PIXFMT_YUYV:
+            fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+            bytesperline = cam_params.width * 2;
+            break;
+        case PIXFMT_NV12:
+            fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_NV12;
+            bytesperline = cam_params.width;
+            break;
+        default:
+            fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_BGR24;
+            bytesperline = cam_params.width * 3;
+            break;
+    }
+    if (xioctl(fd, VIDIOC_S_FMT, &fmt) < 0)
+        fail("cannot set format");
+
+    // The driver can change the format to the nearest one it supports, but
+    // the frames are used as they are, so it must be exactly the requested
+    // one, without padding at the end of the rows
+    if (fmt.fmt.pix.width != cam_params.width
+        || fmt.fmt.pix.height != cam_params.height
+        || fmt.fmt.pix.sizeimage < frame_size(cam_params)
+        || (fmt.fmt.pix.bytesperline
+            && fmt.fmt.pix.bytesperline != bytesperline))
+    {
+        throw FollowException(device + ": unsupported size or pixel format");
+    }
+}
+
+/* Request the buffers to the driver and map them.
+   Parameters:
+     * count: number of buffers to request.
+*/
+void
+V4L2BufferRing::map_buffers(size_t count)
+{
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buf;
+    void *addr;
+
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) < 0)
+        fail("cannot request buffers");
+    // Two buffers are kept by the camera, so at least one more is needed
+    // to capture while the others are in use
+    if (req.count < 3)
+        throw FollowException(device + ": not enough buffers");
+
+    buffers = new v4l2_mapping_t[req.count];
+    for (nbuffers = 0; nbuffers < req.count; nbuffers++) {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = nbuffers;
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buf) < 0)
+            fail("cannot query buffer");
+        addr = mmap(0, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+            buf.m.offset);
+        if (addr == MAP_FAILED)
+            fail("cannot map buffer");
+        buffers[nbuffers].start = (unsigned char *)addr;
+        buffers[nbuffers].length = buf.length;
+    }
+}
+
+// Stop the streaming, unmap the buffers and close the device
+void
+V4L2BufferRing::release()
+{
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (streaming) {
+        xioctl(fd, VIDIOC_STREAMOFF, &type);
+        streaming = false;
+    }
+    if (buffers) {
+        for (size_t i = 0; i < nbuffers; i++)
+            munmap(buffers[i].start, buffers[i].length);
+        delete[] buffers;
+        buffers = 0;
+        nbuffers = 0;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+/* Throw a FollowException with the message and the current errno.
+   Parameters:
+     * msg: the message.
+*/
+void
+V4L2BufferRing::fail(const string& msg)
+{
+    throw FollowException(device + ": " + msg + ": " + strerror(errno));
+}
+
@@ -0,0 +1,100 @@
+/* v4l2bufferring.hpp
+   A ring of buffers shared with a V4L2 capture device through memory
+   mapping (V4L2_MEMORY_MMAP). The driver writes the frames directly in the
+   buffers, that are used in place.
+*/
+
+#ifndef V4L2BUFFERRING_HPP
+#define V4L2BUFFERRING_HPP
+
+#include <string>
+
+#include "bufferring.hpp"
+#include "camparams.hpp"
+
+using namespace std;
+
+// A buffer mapped from the device
+typedef struct {
+    unsigned char *start;
+    size_t length;
+} v4l2_mapping_t;
+
+class V4L2BufferRing: public BufferRing {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * device: path of the V4L2 device.
+             * cam_params: camera's parameters (size and pixel format).
+             * nbuffers: number of buffers to request to the driver (it can
+                 give more).
+           Throws FollowException if the device can't be configured.
+        */
+        V4L2BufferRing(const string& device, const cam_params_t& cam_params,
+            size_t nbuffers);
+
+        virtual ~V4L2BufferRing();
+
+        // Return the number of buffers of the ring
+        virtual size_t get_size() const;
+
+        /* Return the memory of a buffer.
+           Parameters:
+             * index: index of the buffer.
+        */
+        virtual unsigned char *get_buffer(size_t index) const;
+
+        /* Wait until the driver fills a buffer.
+           Parameters:
+             * timestamp: output capture time of the frame, given by the
+                 driver if it uses the monotonic clock.
+           Return the index of the buffer.
+        */
+        virtual size_t dequeue(struct timespec& timestamp);
+
+        /* Give a buffer back to the driver.
+           Parameters:
+             * index: index of the buffer.
+        */
+        virtual void enqueue(size_t index);
+
+    private:
+
+        // Path and file descriptor of the device
+        string device;
+        int fd;
+
+        // The buffers mapped from the device
+        v4l2_mapping_t *buffers;
+        size_t nbuffers;
+
+        // true while the device is streaming
+        bool streaming;
+
+        /* Configure the size and pixel format of the frames.
+           Parameters:
+             * cam_params: camera's parameters (size and pixel format).
+        */
+        void set_format(const cam_params_t& cam_params);
+
+        /* Request the buffers to the driver and map them.
+           Parameters:
+             * count: number of buffers to request.
+        */
+        void map_buffers(size_t count);
+
+        // Stop the streaming, unmap the buffers and close the device
+        void release();
+
+        /* Throw a FollowException with the message and the current errno.
+           Parameters:
+             * msg: the message.
+        */
+        void fail(const string& msg);
+
+};
+
+#endif
+
@@ -0,0 +1,124 @@
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "filebufferring.hpp"
+#include "followexception.hpp"
+#include "v4l2bufferring.hpp"
+#include "v4l2camera.hpp"
+
+/* Constructor.
+   Parameters:
+     * cam_params: camera's parameters (size and pixel format).
+     * device: path of the V4L2 device, or of a file of raw frames.
+     * nbuffers: number of buffers of the ring.
+   Throws FollowException if the device or the file can't be used.
+*/
+V4L2Camera::V4L2Camera(const cam_params_t& cam_params, const string& device,
+        size_t nbuffers):
+    cam_params(cam_params), ring(0), front_index(-1), back_index(-1)
+{
+    struct stat st;
+    int rows, type;
+
+    // Use the device, or a file with the same kind of frames
+    if (stat(device.c_str(), &st) < 0) {
+        throw FollowException("cannot stat " + device + ": "
+            + strerror(errno));
+    }
+    if (S_ISCHR(st.st_mode)) {
+        ring = new V4L2BufferRing(device, cam_params, nbuffers);
+    } else if (S_ISREG(st.st_mode)) {
+        ring = new FileBufferRing(device, cam_params);
+    } else {
+        throw FollowException(device + " is not a device nor a file");
+    }
+
+    // Create a frame header for each buffer
+    switch (cam_params.pixel_format) {
+        case PIXFMT_YUYV:
+            rows = cam_params.height;
+            type = CV_8UC2;
+            break;
+        case PIXFMT_NV12:
+            rows = cam_params.height + cam_params.height / 2;
+            type = CV_8UC1;
+            break;
+        default:
+            rows = cam_params.height;
+            type = CV_8UC3;
+            break;
+    }
+    for (size_t i = 0; i < ring->get_size(); i++) {
+        frames.push_back(
+            Mat(rows, cam_params.width, type, ring->get_buffer(i)));
+    }
+}
+
+V4L2Camera::~V4L2Camera()
+{
+    // Release the frame headers before the buffers
+    frames.clear();
+    delete ring;
+}
+
+/* Fetch the next frame.
+   The previous front frame can still be in use, so it is kept as the back
+   frame. The old back frame is not used anymore and is given back to the
+   ring.
+*/
+void
+V4L2Camera::fetch()
+{
+    struct timespec timestamp;
+
+    if (back_index >= 0)
+        ring->enqueue(back_index);
+    back_index = front_index;
+    front_index = ring->dequeue(timestamp);
+
+    // Only the headers are assigned, the buffers are not copied
+    set_buffers(frames[front_index],
+        (back_index >= 0) ? frames[back_index] : frames[front_index]);
+    set_timestamp(timestamp);
+}
+
+/* Lend the buffer of the frame returned by next. It's kept out of the ring
+   of buffers until it's given back.
+   Return the index of the buffer in the ring.
+*/
+ssize_t
+V4L2Camera::lend()
+{
+    ssize_t buffer = front_index;
+
+    // The next fetch doesn't give it back to the ring
+    front_index = -1;
+    return buffer;
+}
+
+/* Give a lent buffer back to the ring of buffers.
+   Parameters:
+     * buffer: the index returned by lend.
+*/
+void
+V4L2Camera::give_back(ssize_t buffer)
+{
+    ring->enqueue(buffer);
+}
+
+// Return frame's height
+size_t
+V4L2Camera::get_height()
+{
+    return cam_params.height;
+}
+
+// Return frame's width
+size_t
+V4L2Camera::get_width()
+{
+    return cam_params.width;
+}
+
@@ -0,0 +1,78 @@
+/* v4l2camera.hpp
+   Represents a real camera managed directly through V4L2. The frames are
+   the buffers mapped from the device, used in place without any copy. A
+   file of raw frames can be given instead of the device to test it.
+*/
+
+#ifndef V4L2CAMERA_HPP
+#define V4L2CAMERA_HPP
+
+#include <string>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "bufferring.hpp"
+#include "camera.hpp"
+#include "camparams.hpp"
+
+using namespace cv;
+using namespace std;
+
+class V4L2Camera: public Camera {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * cam_params: camera's parameters (size and pixel format).
+             * device: path of the V4L2 device, or of a file of raw frames.
+             * nbuffers: number of buffers of the ring.
+           Throws FollowException if the device or the file can't be used.
+        */
+        V4L2Camera(const cam_params_t& cam_params, const string& device,
+            size_t nbuffers);
+
+        virtual ~V4L2Camera();
+
+        // Fetch the next frame
+        virtual void fetch();
+
+        /* Lend the buffer of the frame returned by next. It's kept out of
+           the ring of buffers until it's given back.
+           Return the index of the buffer in the ring.
+        */
+        virtual ssize_t lend();
+
+        /* Give a lent buffer back to the ring of buffers.
+           Parameters:
+             * buffer: the index returned by lend.
+        */
+        virtual void give_back(ssize_t buffer);
+
+        // Return frame's height
+        virtual size_t get_height();
+
+        // Return frame's width
+        virtual size_t get_width();
+
+    private:
+
+        // The camera parameters
+        cam_params_t cam_params;
+
+        // The ring of buffers, from the device or from a file
+        BufferRing *ring;
+
+        // A frame header that wraps each buffer of the ring
+        vector<Mat> frames;
+
+        // Buffers currently out of the ring, as front and back frames (-1
+        // if there's none or it has been lent)
+        ssize_t front_index;
+        ssize_t back_index;
+
+};
+
+#endif
+
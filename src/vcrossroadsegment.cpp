@@ -34,6 +34,27 @@ VCrossroadSegment::VCrossroadSegment(const glm::vec3& position,
 VCrossroadSegment::~VCrossroadSegment()
 {}
 
+/* Return the distance from the projection of a point to the center line of
+   the branch of the road followed. The road enters through the middle of
+   side ad and the branches turn to the side ab (output 1) and to the
+   opposite one (output 0). If both outputs lead somewhere, the nearest
+   branch is the one followed.
+   Parameters:
+     * point: the point.
+*/
+float
+VCrossroadSegment::get_center_distance(const glm::vec3& point) const
+{
+    float left = get_arc_distance(point, 0, 1);
+    float right = get_arc_distance(point, 0, 0);
+
+    if (outputs == 1)
+        return left;
+    if (outputs == 2)
+        return right;
+    return left < right ? left : right;
+}
+
 /* Get the next segment's position (the connection point)
    Parameters:
      * output: the index of the output to use.
@@ -60,45 +81,50 @@ VCrossroadSegment::get_output(int output, glm::vec3& pos, float& orient) const
     }
 }
 
-/* Initialize the geometry.
+// Initialize the geometry: the bounding box and the shape used by contains
+void
+VCrossroadSegment::init_geometry()
+{
+    gl_vertex_t tr_vertices[VCROSS_NUM_VERTICES];
+
+    transform_vertices(vertices, tr_vertices);
+    compute_bounding_box(tr_vertices, VCROSS_NUM_VERTICES);
+
+    // Precomputed variables used in the contains function
+    set_corners(tr_vertices[1].position, tr_vertices[3].position,
+        tr_vertices[0].position);
+}
+
+/* Write the vertices and the indices of this segment in the buffers of the
+   track.
    Parameters:
      * first_vertex: index in the OpenGL Vertex Buffer for the first
          vertex of this segment.
      * first_index: index in the OpenGL Index Buffer for the first
          index of this segment.
-     * context: OpenGL objects.
+     * context: OpenGL objects, with the buffers being built.
 */
 void
-VCrossroadSegment::init_geometry(size_t first_vertex, size_t first_index,
+VCrossroadSegment::fill_geometry(size_t first_vertex, size_t first_index,
     const gl_context_t& context)
 {
-    gl_vertex_t tr_vertices[VCROSS_NUM_VERTICES];
-    GLushort tr_indices[VCROSS_NUM_INDICES];
-
-    this->first_vertex = first_vertex;
-    this->first_index = first_index;
-    this->context = context;
-
-    fill_buffers(vertices, tr_vertices, indices, tr_indices);
-
-    // Precomputed variables used in the contains function
-    set_corners(tr_vertices[1].position, tr_vertices[3].position,
-        tr_vertices[0].position);
+    fill_buffers(vertices, indices, first_vertex, first_index, context);
 }
 
-// Render this segment
+/* Add the draws of this segment: for each part, its texture, its primitive
+   and its range of the index buffer.
+   Parameters:
+     * draws: vector where to add the draws.
+*/
 void
-VCrossroadSegment::render()
+VCrossroadSegment::get_draws(vector<gl_draw_t>& draws) const
 {
-    // Draw the primitives
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    // Draw the road
-    glUniform1i(context.u_texture, ROAD_VCROSSROAD_TEXTURE);
-    glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT,
-        (void *)(first_index * sizeof(GLushort)));
-    // Draw the side
-    glUniform1i(context.u_texture, WOOD_TEXTURE);
-    glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT,
-        (void *)((first_index + 4) * sizeof(GLushort)));
+    gl_draw_t road = {ROAD_VCROSSROAD_TEXTURE, GL_TRIANGLE_STRIP, 4,
+        (GLsizei)first_index};
+    gl_draw_t side = {WOOD_TEXTURE, GL_TRIANGLE_STRIP, 4,
+        (GLsizei)first_index + 4};
+
+    draws.push_back(road);
+    draws.push_back(side);
 }
 
@@ -1,9 +1,14 @@
 
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
 #include <glm/gtx/rotate_vector.hpp>
 #include <math.h>
+#include <string.h>
 
 #include "followexception.hpp"
+#include "utilities.hpp"
 #include "virtualcamera.hpp"
 
 #include "opencv2/opencv.hpp"
@@ -11,89 +16,211 @@
 // Near value for the perspective cone (this NEVER must be <= 0!!)
 #define Z_NEAR  0.1
 
+#define NS_PER_SECOND   1000000000
+
 #define X11_PIXMAP_DEPTH            24
 #define X11_IMAGE_ALIGN             8
 #define X11_IMAGE_BYTES_PER_PIXEL   4
 
+// Size of the pbuffer used when EGL can't make a context current without a
+// surface (the rendering goes to the framebuffer objects anyway)
+#define PBUFFER_SIZE    1
+
+// OpenGL ES 3 values to read back through pixel buffer objects, not in the
+// OpenGL ES 2 headers
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER    0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ          0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT         0x0001
+#endif
+
 /* Constructor.
    Parameters:
      * segments: description of the virtual track's segments.
      * cam_params: camera's parameters.
+     * headless: render to a framebuffer object instead of to an X11
+         pixmap.
+     * time_step: time that the simulated clock advances with each frame
+         (in s), or 0 to use the real time.
+     * stream_radius: distance from the camera to the segments of the track
+         kept in the buffers (in cm), or 0 to keep the whole track.
 */
 VirtualCamera::VirtualCamera(const vector<segment_t>& segments,
-        const cam_params_t& cam_params):
-    Camera(), cam_params(cam_params),
+        const cam_params_t& cam_params, bool headless, float time_step,
+        float stream_radius):
+    Camera(), owns_track(true), cam_params(cam_params),
     front_buffer(cam_params.height, cam_params.width, CV_8UC4),
-    back_buffer(cam_params.height, cam_params.width, CV_8UC4)
+    back_buffer(cam_params.height, cam_params.width, CV_8UC4),
+    headless(headless), x11_display(0), map_buffer_range(0),
+    unmap_buffer(0), pending_slot(-1),
+    time_step(llroundf(time_step * NS_PER_SECOND)), segment_hint(-1)
 {
     glm::vec3 bs_center;
     float bs_radius;
 
+    // The simulated clock starts at 0, so the runs are the same every time
+    sim_time.tv_sec = 0;
+    sim_time.tv_nsec = 0;
+
+    for (int i = 0; i < RENDER_SLOTS; i++) {
+        fbo[i] = fbo_color[i] = fbo_depth[i] = pbo[i] = 0;
+    }
+
     // Set the buffers to use
     set_buffers(front_buffer, back_buffer);
 
     // Initialize the EGL/OpenGL machinery
-    init_x11();
-    init_egl();
-    init_gl();
+    if (headless) {
+        init_headless();
+        init_framebuffers();
+    } else {
+        init_x11();
+        init_egl();
+    }
 
     // Initialize the track
-    track = new VirtualTrack(segments);
+    track = new VirtualTrack(segments, stream_radius);
 
     // Initialize camera position
     track->get_start_position(position, orientation, normal);
 
-    // Set the camera projection. The Z-Far is set to the scene's bounding
-    // sphere diameter plus the Z-Near. That way we assure that no matter where
-    // the camera is, the whole scene is shown.
+    // The Z-Far is set to the scene's bounding sphere diameter plus the
+    // Z-Near. That way we assure that no matter where the camera is, the
+    // whole scene is shown.
     track->get_bounding_sphere(bs_center, bs_radius);
-    track->set_projection(
-        cam_params.fovh, cam_params.fovv, Z_NEAR, bs_radius*2);
+    z_far = bs_radius*2;
+}
+
+/* Constructor of a camera that renders the track of another one, with its
+   OpenGL context. Both must be headless, and the other camera must be
+   deleted after this one. The whole track is kept in the buffers from then
+   on, as it's seen from several places.
+   Parameters:
+     * shared: the camera with the track.
+     * cam_params: camera's parameters.
+     * time_step: time that the simulated clock advances with each frame
+         (in s), or 0 to use the real time.
+   Throws FollowException if the other camera isn't headless.
+*/
+VirtualCamera::VirtualCamera(VirtualCamera *shared,
+        const cam_params_t& cam_params, float time_step):
+    Camera(), track(shared->track), owns_track(false),
+    z_far(shared->z_far), cam_params(cam_params),
+    front_buffer(cam_params.height, cam_params.width, CV_8UC4),
+    back_buffer(cam_params.height, cam_params.width, CV_8UC4),
+    headless(true), x11_display(0),
+    map_buffer_range(shared->map_buffer_range),
+    unmap_buffer(shared->unmap_buffer), pending_slot(-1),
+    read_format(shared->read_format),
+    time_step(llroundf(time_step * NS_PER_SECOND)), segment_hint(-1)
+{
+    if (!shared->headless) {
+        throw FollowException("only headless cameras can share the track");
+    }
+
+    // The simulated clock starts at 0, so the runs are the same every time
+    sim_time.tv_sec = 0;
+    sim_time.tv_nsec = 0;
+
+    for (int i = 0; i < RENDER_SLOTS; i++) {
+        fbo[i] = fbo_color[i] = fbo_depth[i] = pbo[i] = 0;
+    }
+
+    // Set the buffers to use
+    set_buffers(front_buffer, back_buffer);
+
+    // The context is already current, only the framebuffer objects are new
+    init_framebuffers();
+
+    // Each robot would change the segments in the buffers otherwise
+    track->stop_streaming();
+
+    // Initialize camera position
+    track->get_start_position(position, orientation, normal);
 }
 
 VirtualCamera::~VirtualCamera()
 {
-    delete track;
+    if (owns_track)
+        delete track;
+
+    // Finalize the framebuffer and pixel buffer objects
+    if (fbo[0]) {
+        glDeleteFramebuffers(RENDER_SLOTS, fbo);
+        glDeleteTextures(RENDER_SLOTS, fbo_color);
+        glDeleteRenderbuffers(RENDER_SLOTS, fbo_depth);
+    }
+    if (pbo[0])
+        glDeleteBuffers(RENDER_SLOTS, pbo);
 
     // Finalize x11
-    XFreePixmap(x11_display, x11_pixmap);
-    XCloseDisplay(x11_display);
+    if (x11_display) {
+        XFreePixmap(x11_display, x11_pixmap);
+        XCloseDisplay(x11_display);
+    }
 }
 
 // Fetch the next frame
 void
 VirtualCamera::fetch()
 {
-    XImage *aux;
-
-    // Set the camera position and orientation
-    // The camera position (eye) is the current position in the track + the
-    // camera Z position (added in the direction of the normal!)
-    glm::vec3 eye = position + normal * cam_params.cam_z;
-
-    // The camera orientation is obtained rotating the orientation vector the
-    // camera angle through the orientation x normal vector
-    // Beware, rotate needs the angle in radians
-    glm::vec3 vx = glm::cross(orientation, normal);
-    glm::vec3 o = glm::rotate(orientation, (float)(cam_params.cam_angle), vx);
-    track->set_view(eye, eye + o, cross(vx, o));
-
-    // Clear the color and depth buffers
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Render the scene
-    track->render();
-    glFinish();
-
-    // Read back the pixels from the pixmap where the scene is rendered
-    XGetSubImage(x11_display, x11_pixmap, 0, 0, cam_params.width,
-        cam_params.height, AllPlanes, ZPixmap, x11_back_img, 0, 0);
+    XImage *aux_img;
+    Mat aux;
+    struct timespec timestamp;
+    int slot;
+
+    if (headless) {
+        // Use the frame rendered ahead by the previous fetch or by
+        // render_next, or render it now if there's none
+        render_next();
+        slot = pending_slot;
+        read_slot(slot);
+        timestamp = slot_timestamp[slot];
+        pending_slot = -1;
+
+        // In real time, render the next frame while this one is being used.
+        // With the simulated clock the frames are rendered on demand, so
+        // each one sees the last movement of the motors, as with a real
+        // camera, and not the movement before it.
+        if (!time_step) {
+            pending_slot = (slot + 1) % RENDER_SLOTS;
+            render_slot(pending_slot);
+        }
+    } else {
+        render(timestamp);
+        glFinish();
+
+        // Read back the pixels from the pixmap where the scene is rendered
+        XGetSubImage(x11_display, x11_pixmap, 0, 0, cam_params.width,
+            cam_params.height, AllPlanes, ZPixmap, x11_back_img, 0, 0);
+        aux_img = x11_front_img;
+        x11_front_img = x11_back_img;
+        x11_back_img = aux_img;
+    }
 
     // Swap the back and front images
     swap_buffers();
-    aux = x11_front_img;
-    x11_front_img = x11_back_img;
-    x11_back_img = aux;
+    set_timestamp(timestamp);
+    aux = front_buffer;
+    front_buffer = back_buffer;
+    back_buffer = aux;
+}
+
+/* Start rendering the next frame from the current position, without
+   waiting for it, if it isn't being rendered yet. The next fetch reads it
+   back. Only headless cameras render ahead, the others render in fetch.
+*/
+void
+VirtualCamera::render_next()
+{
+    if (headless && pending_slot < 0) {
+        pending_slot = 0;
+        render_slot(pending_slot);
+    }
 }
 
 // Return frame's height
@@ -120,6 +247,28 @@ VirtualCamera::get_position(
     normal = this->normal;
 }
 
+// Return the scene from where the frames are rendered
+const VirtualTrack *
+VirtualCamera::get_track() const
+{
+    return track;
+}
+
+/* Get the current time of the clock of the frames: the simulated clock, or
+   the monotonic clock if the camera isn't simulated. The simulated clock
+   only advances when a frame is rendered.
+   Parameters:
+     * t: the output current time.
+*/
+void
+VirtualCamera::get_time(struct timespec& t)
+{
+    if (time_step)
+        t = sim_time;
+    else
+        utilities::timenow(t);
+}
+
 // Set the position, orientation and normal of the camera
 void
 VirtualCamera::set_position(
@@ -128,7 +277,8 @@ VirtualCamera::set_position(
     this->position = position;
     this->orientation = orientation;
     this->normal = normal;
-    track->correct_position(this->position, this->orientation, this->normal);
+    track->correct_position(this->position, this->orientation, this->normal,
+        segment_hint);
 }
 
 // PRIVATE FUNCTIONS
@@ -189,11 +339,134 @@ VirtualCamera::init_egl()
     }
 }
 
-// Initialize OpenGL stuff
+// Create the framebuffer objects and the pixel buffer objects (headless)
 void
-VirtualCamera::init_gl()
+VirtualCamera::init_framebuffers()
 {
-    glViewport(0, 0, cam_params.width, cam_params.height);
+    // Create the framebuffer objects, with a texture for the colors and a
+    // renderbuffer for the depth
+    glGenFramebuffers(RENDER_SLOTS, fbo);
+    glGenTextures(RENDER_SLOTS, fbo_color);
+    glGenRenderbuffers(RENDER_SLOTS, fbo_depth);
+    for (int i = 0; i < RENDER_SLOTS; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo[i]);
+        glBindTexture(GL_TEXTURE_2D, fbo_color[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, cam_params.width,
+            cam_params.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, fbo_color[i], 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, fbo_depth[i]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16,
+            cam_params.width, cam_params.height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+            GL_RENDERBUFFER, fbo_depth[i]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER)
+            != GL_FRAMEBUFFER_COMPLETE)
+        {
+            throw FollowException("framebuffer object not complete");
+        }
+    }
+
+    // Create the pixel buffer objects, if they can be mapped
+    if (map_buffer_range && unmap_buffer) {
+        glGenBuffers(RENDER_SLOTS, pbo);
+        for (int i = 0; i < RENDER_SLOTS; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER,
+                back_buffer.total() * back_buffer.elemSize(), 0,
+                GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+// Initialize EGL without X11, and the framebuffer objects
+void
+VirtualCamera::init_headless()
+{
+    EGLint majorVersion, minorVersion;
+    EGLint config_attrs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_NONE
+    };
+    const EGLint pbuffer_attrs[] = {
+        EGL_WIDTH, PBUFFER_SIZE,
+        EGL_HEIGHT, PBUFFER_SIZE,
+        EGL_NONE
+    };
+    const EGLint context3_attrs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 3,
+        EGL_NONE
+    };
+    const EGLint context_attrs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+    const char *extensions;
+    EGLConfig egl_config;
+    EGLint nconfs;
+    EGLContext context;
+
+    // Get the display and initialize EGL. The surfaceless platform of Mesa
+    // works without any window system or GPU (with its software renderer).
+    egl_display = EGL_NO_DISPLAY;
+    extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display) {
+            egl_display = get_platform_display(
+                EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+        }
+    }
+    if (egl_display == EGL_NO_DISPLAY)
+        egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (egl_display == EGL_NO_DISPLAY) {
+        throw FollowException("error in eglGetDisplay");
+    }
+    if (!eglInitialize(egl_display, &majorVersion, &minorVersion)) {
+        throw FollowException("error in eglInitialize");
+    }
+
+    // Obtain the configuration
+    if (!eglChooseConfig(egl_display, config_attrs, &egl_config, 1, &nconfs)
+        || !nconfs)
+    {
+        throw FollowException("error in eglChooseConfig");
+    }
+
+    // Create the rendering context (of OpenGL ES 3 if possible, to read
+    // back through pixel buffer objects) and make it current, without a
+    // surface if possible
+    if ((context = eglCreateContext(egl_display, egl_config, EGL_NO_CONTEXT,
+        context3_attrs)) != EGL_NO_CONTEXT)
+    {
+        map_buffer_range = (map_buffer_range_t)
+            eglGetProcAddress("glMapBufferRange");
+        unmap_buffer = (unmap_buffer_t)eglGetProcAddress("glUnmapBuffer");
+    } else if ((context = eglCreateContext(egl_display, egl_config,
+        EGL_NO_CONTEXT, context_attrs)) == EGL_NO_CONTEXT)
+    {
+        throw FollowException("error in eglCreateContext");
+    }
+    extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+    if (extensions && strstr(extensions, "EGL_KHR_surfaceless_context")) {
+        egl_surface = EGL_NO_SURFACE;
+    } else if ((egl_surface = eglCreatePbufferSurface(
+        egl_display, egl_config, pbuffer_attrs)) == EGL_NO_SURFACE)
+    {
+        throw FollowException("error in eglCreatePbufferSurface");
+    }
+    if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, context)) {
+        throw FollowException("error in eglMakeCurrent");
+    }
+
+    // Read back the pixels as BGRA if possible, to avoid the conversion
+    extensions = (const char *)glGetString(GL_EXTENSIONS);
+    read_format = (extensions && strstr(extensions, "GL_EXT_read_format_bgra"))
+        ? GL_BGRA_EXT : GL_RGBA;
 }
 
 // Initialize X11 stuff
@@ -216,3 +489,102 @@ VirtualCamera::init_x11()
         cam_params.width * X11_IMAGE_BYTES_PER_PIXEL);
 }
 
+/* Finish reading back a slot to the back buffer.
+   Parameters:
+     * slot: the slot.
+*/
+void
+VirtualCamera::read_slot(int slot)
+{
+    void *pixels;
+
+    if (pbo[slot]) {
+        // Map the pixels already copied to the pixel buffer object
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+        pixels = map_buffer_range(GL_PIXEL_PACK_BUFFER, 0,
+            back_buffer.total() * back_buffer.elemSize(), GL_MAP_READ_BIT);
+        if (!pixels) {
+            throw FollowException("error in glMapBufferRange");
+        }
+        Mat mapped(cam_params.height, cam_params.width, CV_8UC4, pixels);
+        if (read_format == GL_BGRA_EXT)
+            mapped.copyTo(back_buffer);
+        else
+            cvtColor(mapped, back_buffer, COLOR_RGBA2BGRA);
+        unmap_buffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    } else {
+        // Only the rendering of this slot has to be finished, the slot
+        // rendered after it goes on
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo[slot]);
+        glReadPixels(0, 0, cam_params.width, cam_params.height, read_format,
+            GL_UNSIGNED_BYTE, back_buffer.data);
+        if (read_format != GL_BGRA_EXT)
+            cvtColor(back_buffer, back_buffer, COLOR_RGBA2BGRA);
+    }
+}
+
+/* Render the scene as seen from the current position.
+   Parameters:
+     * timestamp: output capture time of the frame.
+*/
+void
+VirtualCamera::render(struct timespec& timestamp)
+{
+    // The frame shows the scene as it is now. The simulated clock advances
+    // a fixed time step with each frame, whatever the real time spent.
+    if (time_step) {
+        sim_time.tv_nsec += time_step;
+        sim_time.tv_sec += sim_time.tv_nsec / NS_PER_SECOND;
+        sim_time.tv_nsec %= NS_PER_SECOND;
+    }
+    get_time(timestamp);
+
+    // Set the camera position and orientation
+    // The camera position (eye) is the current position in the track + the
+    // camera Z position (added in the direction of the normal!)
+    glm::vec3 eye = position + normal * cam_params.cam_z;
+
+    // The camera orientation is obtained rotating the orientation vector the
+    // camera angle through the orientation x normal vector
+    // Beware, rotate needs the angle in radians
+    glm::vec3 vx = glm::cross(orientation, normal);
+    glm::vec3 o = glm::rotate(orientation, (float)(cam_params.cam_angle), vx);
+
+    // The track can be rendered by other cameras too, so the viewport and
+    // the projection are set each time. The framebuffer object is read back
+    // bottom row first, so the image is flipped to get the top row first,
+    // as in the pixmap.
+    glViewport(0, 0, cam_params.width, cam_params.height);
+    track->set_projection(
+        cam_params.fovh, cam_params.fovv, Z_NEAR, z_far, headless);
+    track->set_view(eye, eye + o, cross(vx, o));
+
+    // Clear the color and depth buffers
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Render the scene
+    track->render();
+}
+
+/* Render the scene to a slot and start reading it back.
+   Parameters:
+     * slot: the slot.
+*/
+void
+VirtualCamera::render_slot(int slot)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo[slot]);
+    render(slot_timestamp[slot]);
+    if (pbo[slot]) {
+        // The copy to the pixel buffer object doesn't wait for the
+        // rendering, it's queued after it
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+        glReadPixels(0, 0, cam_params.width, cam_params.height, read_format,
+            GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    // Start the rendering without waiting for it
+    glFlush();
+}
+
@@ -1,20 +1,48 @@
 
 /* virtualcamera.hpp
    Represents a virtual camera, that is actually a way of getting images
-   rendered from a virtual camera in an OpenGL scene.
+   rendered from a virtual camera in an OpenGL scene. The scene is rendered
+   either to an X11 pixmap, read back with XGetSubImage, or headless to a
+   framebuffer object, read back with glReadPixels, that doesn't need an X
+   server. The headless camera renders each frame ahead, while the previous
+   one is being used, and reads it back in the next fetch (through a pixel
+   buffer object with OpenGL ES 3), so rendering and readback overlap.
+   The camera can be simulated: then the capture times of the frames come
+   from a clock that advances a fixed time step with each frame, and not
+   from the real time, so a simulation runs as fast as the frames can be
+   rendered and gives the same result every time. The simulated frames are
+   rendered on demand in each fetch and not ahead, so they don't add a frame
+   of delay to the control of the motors.
+   Several headless cameras, one for each virtual robot, can render the
+   same track: the first one creates the OpenGL context and the track, with
+   its buffers and textures, and the others only their own framebuffer
+   objects. They must be used from the same thread. Each camera can start
+   rendering its next frame with render_next once its robot has moved, so
+   all of them render before any waits for its readback in fetch.
 */
 
 #ifndef VIRTUALCAMERA_HPP
 #define VIRTUALCAMERA_HPP
 
 #include <EGL/egl.h>
+#include <GLES2/gl2.h>
 #include <glm/vec3.hpp>
+#include <stdint.h>
+#include <time.h>
 #include <X11/Xlib.h>
 
 #include "camera.hpp"
 #include "camparams.hpp"
 #include "virtualtrack.hpp"
 
+// Number of frames being rendered or read back at once (headless)
+#define RENDER_SLOTS    2
+
+// Functions of OpenGL ES 3 to map the pixel buffer objects
+typedef void *(GL_APIENTRY *map_buffer_range_t)(GLenum target,
+    GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (GL_APIENTRY *unmap_buffer_t)(GLenum target);
+
 class VirtualCamera: public Camera {
 
     public:
@@ -23,15 +51,44 @@ class VirtualCamera: public Camera {
            Parameters:
              * segments: description of the virtual track's segments.
              * cam_params: camera's parameters.
+             * headless: render to a framebuffer object instead of to an
+                 X11 pixmap.
+             * time_step: time that the simulated clock advances with each
+                 frame (in s), or 0 to use the real time.
+             * stream_radius: distance from the camera to the segments of
+                 the track kept in the buffers (in cm), or 0 to keep the
+                 whole track.
+        */
+        VirtualCamera(const vector<segment_t>& segments,
+            const cam_params_t& cam_params, bool headless, float time_step,
+            float stream_radius);
+
+        /* Constructor of a camera that renders the track of another one,
+           with its OpenGL context. Both must be headless, and the other
+           camera must be deleted after this one. The whole track is kept
+           in the buffers from then on.
+           Parameters:
+             * shared: the camera with the track.
+             * cam_params: camera's parameters.
+             * time_step: time that the simulated clock advances with each
+                 frame (in s), or 0 to use the real time.
+           Throws FollowException if the other camera isn't headless.
         */
-        VirtualCamera(
-            const vector<segment_t>& segments, const cam_params_t& cam_params);
+        VirtualCamera(VirtualCamera *shared, const cam_params_t& cam_params,
+            float time_step);
 
         ~VirtualCamera();
 
         // Fetch the next frame
         virtual void fetch();
 
+        /* Start rendering the next frame from the current position, without
+           waiting for it, if it isn't being rendered yet. The next fetch
+           reads it back. Only headless cameras render ahead, the others
+           render in fetch.
+        */
+        void render_next();
+
         // Return frame's height
         virtual size_t get_height();
 
@@ -42,14 +99,30 @@ class VirtualCamera: public Camera {
         void get_position(glm::vec3& position, glm::vec3& orientation,
             glm::vec3& normal) const;
 
+        // Return the scene from where the frames are rendered
+        const VirtualTrack *get_track() const;
+
+        /* Get the current time of the clock of the frames: the simulated
+           clock, or the monotonic clock if the camera isn't simulated. The
+           simulated clock only advances when a frame is rendered.
+           Parameters:
+             * t: the output current time.
+        */
+        void get_time(struct timespec& t);
+
         // Set the position, orientation and normal of the camera
         void set_position(
             glm::vec3& position, glm::vec3& orientation, glm::vec3& normal);
 
     private:
 
-        // The scene from where the frames are rendered and retrieved
+        // The scene from where the frames are rendered and retrieved, and
+        // if this camera created it (the others share it)
         VirtualTrack *track;
+        bool owns_track;
+
+        // Far clip distance, to see the whole scene from anywhere
+        float z_far;
 
         // The camera's parameters
         cam_params_t cam_params;
@@ -58,6 +131,9 @@ class VirtualCamera: public Camera {
         Mat front_buffer;
         Mat back_buffer;
 
+        // Render to a framebuffer object instead of to an X11 pixmap
+        bool headless;
+
         // X11 state and variables
         Display *x11_display;
         Pixmap x11_pixmap;
@@ -68,16 +144,67 @@ class VirtualCamera: public Camera {
         EGLDisplay egl_display;
         EGLSurface egl_surface;
 
+        // Framebuffer objects and their color and depth attachments, one
+        // for each slot (headless)
+        GLuint fbo[RENDER_SLOTS];
+        GLuint fbo_color[RENDER_SLOTS];
+        GLuint fbo_depth[RENDER_SLOTS];
+
+        // Pixel buffer objects where the slots are read back (only with
+        // OpenGL ES 3, otherwise 0) and the functions to map them
+        GLuint pbo[RENDER_SLOTS];
+        map_buffer_range_t map_buffer_range;
+        unmap_buffer_t unmap_buffer;
+
+        // Capture time of the frame of each slot
+        struct timespec slot_timestamp[RENDER_SLOTS];
+
+        // Slot rendered ahead and not read back yet (-1 if there's none)
+        int pending_slot;
+
+        // Format to read back the pixels as BGRA (headless)
+        GLenum read_format;
+
+        // Time step of the simulated clock (in ns, 0 if not simulated) and
+        // its current time
+        int64_t time_step;
+        struct timespec sim_time;
+
         // Current position, orientation and normal in the virtual track
         glm::vec3 position;
         glm::vec3 orientation;
         glm::vec3 normal;
 
+        // Segment of the track under the camera, checked first when it
+        // moves (-1 if unknown)
+        int segment_hint;
+
         // Initialize EGL library
         void init_egl();
 
-        // Initialize OpenGL stuff
-        void init_gl();
+        // Create the framebuffer objects and the pixel buffer objects
+        void init_framebuffers();
+
+        // Initialize EGL without X11, and the framebuffer objects
+        void init_headless();
+
+        /* Finish reading back a slot to the back buffer.
+           Parameters:
+             * slot: the slot.
+        */
+        void read_slot(int slot);
+
+        /* Render the scene as seen from the current position.
+           Parameters:
+             * timestamp: output capture time of the frame.
+        */
+        void render(struct timespec& timestamp);
+
+        /* Render the scene to a slot and start reading it back.
+           Parameters:
+             * slot: the slot.
+        */
+        void render_slot(int slot);
 
         // Initialize X11 stuff
         void init_x11();
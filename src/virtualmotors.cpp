@@ -10,8 +10,6 @@
 
 #define MIN_TURN    0.001
 
-// TODO: Don't use gettimeofday
-
 using namespace utilities;
 
 /* Constructor.
@@ -31,6 +29,17 @@ VirtualMotors::VirtualMotors(VirtualCamera *camera, float max_speed,
 VirtualMotors::~VirtualMotors()
 {}
 
+/* Get the current time of the clock of the camera, that is the simulated
+   clock if the camera has one.
+   Parameters:
+     * t: the output current time.
+*/
+void
+VirtualMotors::get_time(struct timespec& t)
+{
+    camera->get_time(t);
+}
+
 /* Move the motors by an arc.
    Parameters:
      * speed: mean speed (0.0 is no movement and 1.0 is max speed).
@@ -39,16 +48,15 @@ VirtualMotors::~VirtualMotors()
 void
 VirtualMotors::move(float speed, float turn)
 {
-    struct timeval t_current;
+    struct timespec t_current;
     float dt;
     float s1, s2;
     float radius, angle;
     glm::vec3 position, orientation, normal, center;
 
-    // Compute the elapsed time
-    gettimeofday(&t_current, 0);
-    dt = (float)(t_current.tv_sec - t_prev.tv_sec
-        + (t_current.tv_usec - t_prev.tv_usec) * 1e-6);
+    // Compute the elapsed time (simulated, if the camera is simulated)
+    get_time(t_current);
+    dt = timediff(t_prev, t_current);
     t_prev = t_current;
 
     // Compute the speeds for each wheel and the mean speed
@@ -90,7 +98,7 @@ VirtualMotors::move(float speed, float turn)
 void
 VirtualMotors::start()
 {
-    gettimeofday(&t_prev, 0);
+    get_time(t_prev);
 }
 
 // Stop the motors
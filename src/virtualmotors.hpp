@@ -2,7 +2,7 @@
 #ifndef VIRTUALMOTORS_HPP
 #define VIRTUALMOTORS_HPP
 
-#include <sys/time.h>
+#include <time.h>
 
 #include "motors.hpp"
 #include "virtualcamera.hpp"
@@ -29,6 +29,13 @@ class VirtualMotors: public Motors {
 
         virtual ~VirtualMotors();
 
+        /* Get the current time of the clock of the camera, that is the
+           simulated clock if the camera has one.
+           Parameters:
+             * t: the output current time.
+        */
+        virtual void get_time(struct timespec& t);
+
         /* Move the motors by an arc.
            Parameters:
              * speed: mean speed (0.0 is no movement and 1.0 is max speed).
@@ -51,7 +58,7 @@ class VirtualMotors: public Motors {
         float max_speed;
 
         // Time in previous invocation (used to calculate the distance to move)
-        struct timeval t_prev;
+        struct timespec t_prev;
 
 };
 
@@ -1,7 +1,12 @@
 
+#include <algorithm>
+#include <float.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/matrix.hpp>
 #include <limits.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "acrossroadsegment.hpp"
 #include "dashedline1segment.hpp"
@@ -26,6 +31,10 @@ using namespace utilities;
 #define VERTEX_SHADER_FILE      "vertex.sl"
 #define FRAGMENT_SHADER_FILE    "fragment.sl"
 
+// Asset pack with the textures and the shaders, used instead of their files
+// if it exists
+#define ASSET_PACK_FILE         "follow.pack"
+
 // Vertex shader attributes
 #define ATTR_POSITION   0
 #define ATTR_NORMAL     1
@@ -40,9 +49,26 @@ using namespace utilities;
 // Size of the carpet texture against the size of the floor
 #define TEXTURE_COORDS_MULT 20
 
+// Distance from the output of the last segment to the origin to consider
+// that the track is closed
+#define CLOSED_TRACK_DELTA  1.0
+
 // Ilumination constants
 #define ATTENUATION 0.00002
 
+// Size of the cells of the grid of segments, the size of a square segment,
+// and maximum number of cells for each segment (with a bigger track the
+// cells are bigger)
+#define GRID_CELL_SIZE          30.0f
+#define GRID_CELLS_PER_SEGMENT  16
+
+// Maximum number of vertices of a chunk of the track with 16 bits indices
+#define MAX_CHUNK_VERTICES  65536
+
+// Part of the stream radius that the eye can move before the segments in the
+// buffers are chosen again
+#define STREAM_MARGIN   0.25f
+
 // Geometry constants
 #define ROOM_NUM_VERTICES   24
 #define ROOM_NUM_INDICES    34
@@ -66,24 +92,39 @@ const texture_info_t VirtualTrack::texture_info[NUM_TEXTURES] = {
    Parameters:
      * segments: sequence of segments to build the track. The last one must be
                  SEGMENT_NULL.
+     * stream_radius: distance from the eye to the segments kept in the
+         buffers, or 0 to keep the whole track.
 */
-VirtualTrack::VirtualTrack(const vector<segment_t>& segments):
-    bb_min(INT_MAX, INT_MAX, 0), bb_max(INT_MIN, INT_MIN, WALLS_H)
+VirtualTrack::VirtualTrack(const vector<segment_t>& segments,
+        float stream_radius):
+    bb_min(INT_MAX, INT_MAX, 0), bb_max(INT_MIN, INT_MIN, WALLS_H),
+    stream_radius(stream_radius), assets(0)
 {
+    glm::vec3 position, orientation, normal;
+
+    init_assets();
     init_segments(segments);
     init_gl_program();
     init_gl_buffers();
     init_gl_textures();
     init_segments_geometry();
+    init_grid();
     compute_bounding_box();
-    init_geometry();
+    init_frustum();
+    get_start_position(position, orientation, normal);
+    stream_segments(glm::vec2(position));
     init_gl_lights();
+
+    // The textures and the shaders are in OpenGL now
+    delete assets;
+    assets = 0;
 }
 
 VirtualTrack::~VirtualTrack()
 {
     destroy_segments();
     destroy_gl();
+    delete assets;
 }
 
 /* Given a position and an orientation and normal vectors, correct
@@ -92,24 +133,19 @@ VirtualTrack::~VirtualTrack()
      * position: position to correct.
      * orientation: orientation to correct.
      * normal: normal to correct.
+     * hint: segment hint of the caller, as in find_segment.
 */
 void
 VirtualTrack::correct_position(glm::vec3& position, glm::vec3& orientation,
-    glm::vec3& normal) const
+    glm::vec3& normal, int& hint) const
 {
-    vector<TrackSegment *>::const_iterator it;
-    bool found = false;
-
-    for (it = segments.begin(); it != segments.end() && !found; it++) {
-        if ((*it)->contains(position)) {
-            (*it)->correct_position(position, orientation, normal);
-            found = true;
-        }
-    }
+    int segment = find_segment(position, hint);
 
-    // Case where the point is outside the track
-    if (!found) {
-        // The position is the same as at the input but with Z = 0
+    if (segment >= 0) {
+        segments[segment]->correct_position(position, orientation, normal);
+    } else {
+        // The point is outside the track: the position is the same as at
+        // the input but with Z = 0
         position[2] = 0;
         // Make sure the orientation vector is in the XY plane (and its normal)
         orientation[2] = 0;
@@ -119,6 +155,41 @@ VirtualTrack::correct_position(glm::vec3& position, glm::vec3& orientation,
     }
 }
 
+/* Find the segment that contains the projection of a position. The segment
+   given as hint is checked first, and then only the segments in the cell of
+   the grid where the position is. The track is shared by several robots, so
+   each caller keeps its own hint.
+   Parameters:
+     * position: the position.
+     * hint: segment found the previous time by the caller (-1 if none),
+           updated with the one found.
+   Return the index of the segment, or -1 if the position is outside the
+   track.
+*/
+int
+VirtualTrack::find_segment(const glm::vec3& position, int& hint) const
+{
+    float x, y;
+    size_t cell;
+
+    // The mobile is usually still over the same segment
+    if (hint >= 0 && segments[hint]->contains(position))
+        return hint;
+
+    x = floor((position[0] - grid_min[0]) / grid_cell_size);
+    y = floor((position[1] - grid_min[1]) / grid_cell_size);
+    if (x < 0 || x >= grid_width || y < 0 || y >= grid_height)
+        return -1;
+    cell = (size_t)y * grid_width + (size_t)x;
+    for (size_t i = grid_cells[cell]; i < grid_cells[cell + 1]; i++) {
+        if (segments[grid_segments[i]]->contains(position)) {
+            hint = grid_segments[i];
+            return hint;
+        }
+    }
+    return -1;
+}
+
 // Return the scene's bounding sphere
 void
 VirtualTrack::get_bounding_sphere(glm::vec3& center, float& radius) const
@@ -127,6 +198,46 @@ VirtualTrack::get_bounding_sphere(glm::vec3& center, float& radius) const
     radius = bs_radius;
 }
 
+/* Return the distance from a position to the center line of the road of a
+   segment.
+   Parameters:
+     * segment: index of the segment.
+     * position: the position.
+*/
+float
+VirtualTrack::get_center_distance(size_t segment, const glm::vec3& position)
+    const
+{
+    return segments[segment]->get_center_distance(position);
+}
+
+// Return the number of segments of the track
+size_t
+VirtualTrack::get_num_segments() const
+{
+    return segments.size();
+}
+
+/* Return true if the last segment connects with the first one, so that the
+   track is a loop. The first segment is placed at the origin.
+*/
+bool
+VirtualTrack::is_closed() const
+{
+    glm::vec3 pos;
+    float orient;
+
+    if (segments.empty())
+        return false;
+    // Any of the outputs of a crossroad can close the track
+    for (int output = 0; output < 2; output++) {
+        segments.back()->get_output(output, pos, orient);
+        if (glm::length(glm::vec2(pos)) < CLOSED_TRACK_DELTA)
+            return true;
+    }
+    return false;
+}
+
 /* Get the starting position for the mobile.
    Parameters:
      * position: returned starting position.
@@ -137,50 +248,71 @@ void
 VirtualTrack::get_start_position(
     glm::vec3& position, glm::vec3& orientation, glm::vec3& normal) const
 {
+    int hint = -1;
+
     // Set the start position to (0, 1, 0) instead of (0, 0, 0) to avoid that
     // the car is outside the track if the track is open.
     position = glm::vec3(0, 1, 0);
     orientation = glm::vec3(0, 1, 0);
     normal = glm::vec3(0, 0, 1);
-    correct_position(position, orientation, normal);
+    correct_position(position, orientation, normal, hint);
 }
 
 // Render the scene
 void
 VirtualTrack::render()
 {
-    vector<TrackSegment *>::const_iterator it;
-
-    glBindBuffer(GL_ARRAY_BUFFER, context.vertex_buffer);
-
-    // Position
-    glVertexAttribPointer(ATTR_POSITION, 3, GL_FLOAT, GL_FALSE,
-        sizeof(gl_vertex_t), (void *)offsetof(gl_vertex_t, position));
-    glEnableVertexAttribArray(ATTR_POSITION);
-
-    // Normal
-    glVertexAttribPointer(ATTR_NORMAL, 3, GL_FLOAT, GL_FALSE,
-        sizeof(gl_vertex_t), (void *)offsetof(gl_vertex_t, normal));
-    glEnableVertexAttribArray(ATTR_NORMAL);
+    vector<uint32_t>::const_iterator it, first;
+    const gl_draw_t *ranges;
+    gl_draw_t draw;
+    size_t n = resident_segments.size() + 1;
 
-    // Texture coordinates
-    glVertexAttribPointer(ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
-        sizeof(gl_vertex_t), (void *)offsetof(gl_vertex_t, texcoord));
-    glEnableVertexAttribArray(ATTR_TEXCOORD);
-
-    // Draw the primitives
+    cull_segments();
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    // Draw the floor
-    glUniform1i(context.u_texture, CARPET_TEXTURE);
-    glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT, (void *)0);
-    // Draw the walls
-    glUniform1i(context.u_texture, WALL_TEXTURE);
-    glDrawElements(GL_TRIANGLES, 30, GL_UNSIGNED_SHORT,
-        (void *)(4 * sizeof(GLushort)));
-
-    // Render the segments
-    for (it = segments.begin(); it != segments.end(); it++) {
-        (*it)->render();
+    it = visible_segments.begin();
+    for (size_t c = 0; c + 1 < chunk_segments.size(); c++) {
+        // The visible segments of this chunk
+        first = it;
+        while (it != visible_segments.end() && *it < chunk_segments[c + 1])
+            it++;
+
+        // For each texture, the room and the visible segments, joining the
+        // ranges of the index buffer that follow each other
+        frame_draws.clear();
+        for (int i = 0; i < NUM_TEXTURES; i++) {
+            ranges = &batch_ranges[i * n];
+            draw = ranges[0];
+            if (c > 0)
+                draw.count = 0;
+            for (vector<uint32_t>::const_iterator s = first; s != it; s++) {
+                const gl_draw_t& range = ranges[*s + 1];
+                if (range.count == 0)
+                    continue;
+                if (draw.count > 0 && draw.first + draw.count == range.first) {
+                    draw.count += range.count;
+                    continue;
+                }
+                if (draw.count > 0)
+                    frame_draws.push_back(draw);
+                draw = range;
+            }
+            if (draw.count > 0)
+                frame_draws.push_back(draw);
+        }
+        if (frame_draws.empty())
+            continue;
+
+        // Draw the primitives
+        bind_vertices(chunk_vertices[c]);
+        for (size_t i = 0; i < frame_draws.size(); i++) {
+            if (i == 0
+                || frame_draws[i].texture != frame_draws[i - 1].texture)
+            {
+                glUniform1i(context.u_texture, frame_draws[i].texture);
+            }
+            glDrawElements(GL_TRIANGLES, frame_draws[i].count, index_type,
+                (void *)(frame_draws[i].first * index_size));
+        }
     }
 }
 
@@ -190,13 +322,25 @@ VirtualTrack::render()
      * fovv: vertical Field Of View.
      * znear: near clip distance.
      * zfar: far clip distance.
+     * flip: flip the image vertically, so the top row is the first one
+         in the framebuffer.
 */
 void
-VirtualTrack::set_projection(float fovh, float fovv, float znear, float zfar)
+VirtualTrack::set_projection(float fovh, float fovv, float znear, float zfar,
+    bool flip)
 {
     // Compute the projection matrix
     projection_matrix = glm::perspective(
         glm::radians(fovv), fovh/fovv, znear, zfar);
+
+    // The flip reverses the winding of the faces, so the front faces change
+    if (flip) {
+        projection_matrix = glm::scale(glm::mat4(1.0), glm::vec3(1, -1, 1))
+            * projection_matrix;
+        glFrontFace(GL_CW);
+    } else {
+        glFrontFace(GL_CCW);
+    }
 }
 
 /* Set the point of view.
@@ -214,10 +358,103 @@ VirtualTrack::set_view(
 
     // Update the uniforms
     glUniformMatrix4fv(context.u_mvprojection, 1, GL_FALSE, &mvp[0][0]);
+
+    set_frustum(mvp);
+
+    // Change the segments in the buffers when the eye gets far from the
+    // place where they were chosen
+    if (stream_radius > 0
+        && glm::length(glm::vec2(eye) - stream_center)
+        > stream_radius * STREAM_MARGIN)
+    {
+        stream_segments(glm::vec2(eye));
+    }
+}
+
+/* Keep the whole track in the buffers from now on. A track rendered from
+   several eyes would change its segments in the buffers with each of them.
+*/
+void
+VirtualTrack::stop_streaming()
+{
+    if (stream_radius > 0) {
+        stream_radius = 0;
+        stream_segments(stream_center);
+    }
 }
 
 //// PRIVATE FUNCTIONS
 
+/* Add a draw to the batch of its texture, as a list of triangles. The
+   triangles of the strips keep their winding, and the degenerate ones that
+   join the strips are skipped.
+   Parameters:
+     * draw: the draw, with the indices in context.indices.
+     * base: vertex of the chunk that the index 0 refers to.
+     * batches: the indices of the triangles of each texture.
+*/
+void
+VirtualTrack::add_triangles(const gl_draw_t& draw, GLuint base,
+    vector<GLuint> batches[NUM_TEXTURES])
+{
+    vector<GLuint>& batch = batches[draw.texture];
+    const GLuint *v = context.indices + draw.first;
+    GLuint t[3];
+
+    if (draw.mode == GL_TRIANGLES) {
+        for (GLsizei i = 0; i < draw.count; i++) {
+            batch.push_back(v[i] - base);
+        }
+        return;
+    }
+    for (GLsizei i = 0; i + 2 < draw.count; i++) {
+        if (draw.mode == GL_TRIANGLE_FAN) {
+            t[0] = v[0];
+            t[1] = v[i + 1];
+            t[2] = v[i + 2];
+        } else {
+            // The odd triangles of a strip have the opposite winding
+            t[0] = v[i + (i & 1)];
+            t[1] = v[i + 1 - (i & 1)];
+            t[2] = v[i + 2];
+        }
+        if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2])
+            continue;
+        for (int k = 0; k < 3; k++) {
+            batch.push_back(t[k] - base);
+        }
+    }
+}
+
+/* Set the vertex attributes to the vertex buffer.
+   Parameters:
+     * first_vertex: vertex that the index 0 refers to.
+*/
+void
+VirtualTrack::bind_vertices(size_t first_vertex)
+{
+    size_t offset = first_vertex * sizeof(gl_vertex_t);
+
+    glBindBuffer(GL_ARRAY_BUFFER, context.vertex_buffer);
+
+    // Position
+    glVertexAttribPointer(ATTR_POSITION, 3, GL_FLOAT, GL_FALSE,
+        sizeof(gl_vertex_t),
+        (void *)(offset + offsetof(gl_vertex_t, position)));
+    glEnableVertexAttribArray(ATTR_POSITION);
+
+    // Normal
+    glVertexAttribPointer(ATTR_NORMAL, 3, GL_FLOAT, GL_FALSE,
+        sizeof(gl_vertex_t), (void *)(offset + offsetof(gl_vertex_t, normal)));
+    glEnableVertexAttribArray(ATTR_NORMAL);
+
+    // Texture coordinates
+    glVertexAttribPointer(ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+        sizeof(gl_vertex_t),
+        (void *)(offset + offsetof(gl_vertex_t, texcoord)));
+    glEnableVertexAttribArray(ATTR_TEXCOORD);
+}
+
 // Compile a vertex/fragment shader
 GLuint
 VirtualTrack::compile_shader(GLenum type, const char *shader_src)
@@ -278,24 +515,70 @@ VirtualTrack::compute_bounding_box()
     bs_radius = length(bb_max - bb_min) * 0.5;
 }
 
-// Creates a texture from an array
+/* Creates a texture from an array with its mip levels, one after another
+   from the largest, as in the asset pack.
+   Parameters:
+     * texid: index of the texture.
+     * width: width of the texture.
+     * height: height of the texture.
+     * levels: number of mip levels.
+     * data: the mip levels.
+*/
 void
 VirtualTrack::create_texture_from_array(GLint texid, GLsizei width,
-    GLsizei height, const GLvoid *data)
+    GLsizei height, uint32_t levels, const unsigned char *data)
 {
+    uint32_t w = width, h = height;
+
     glActiveTexture(texid + GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, context.tex_index[texid]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-        GL_UNSIGNED_BYTE, data);
+    for (uint32_t level = 0; level < levels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, w, h, 0, GL_RGB,
+            GL_UNSIGNED_BYTE, data);
+        data += (size_t)w * h * 3;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+        levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+}
+
+/* Creates a texture from the asset pack, with all its mip levels.
+   Parameters:
+     * texid: index of the texture.
+     * width: width of the texture.
+     * height: height of the texture.
+     * name: name of the texture file.
+*/
+void
+VirtualTrack::create_texture_from_asset(GLint texid, GLsizei width,
+    GLsizei height, const char *name)
+{
+    const asset_entry_t& entry = find_asset(name);
+
+    if (entry.width != (uint32_t)width || entry.height != (uint32_t)height) {
+        throw FollowException(string("texture '") + name
+            + "' has a different size in " ASSET_PACK_FILE);
+    }
+    create_texture_from_array(texid, width, height, entry.levels,
+        assets->get_data(entry));
 }
 
-// Creates a texture from a file
+/* Creates a texture from a file. The mip levels are computed as
+   follow-mkpack does, so the texture is the same as the one of the pack.
+   Parameters:
+     * texid: index of the texture.
+     * width: width of the texture.
+     * height: height of the texture.
+     * file: path of the texture file.
+*/
 void
 VirtualTrack::create_texture_from_file(GLint texid, GLsizei width,
     GLsizei height, const char *file)
 {
+    vector<unsigned char> levels;
+    uint32_t nlevels;
     int e;
 
     const char *data = loadfile(file);
@@ -304,8 +587,105 @@ VirtualTrack::create_texture_from_file(GLint texid, GLsizei width,
         throw FollowException(
             string("error loading file '") + file + "': " + strerror(e));
     }
-    create_texture_from_array(texid, width, height, data);
+    levels.assign(data, data + (size_t)width * height * 3);
     delete[] data;
+    nlevels = AssetPack::add_levels(levels, width, height);
+    create_texture_from_array(texid, width, height, nlevels, &levels[0]);
+}
+
+/* Find the segments inside the view frustum. Only the cells of the grid
+   under the frustum are tested, and the segments of the cells inside it
+   that are in the buffers.
+*/
+void
+VirtualTrack::cull_segments()
+{
+    glm::vec2 s_min, s_max, c_min;
+    size_t first[2], last[2], c;
+    uint32_t s;
+
+    visible_segments.clear();
+    if (!get_grid_range(frustum_min, frustum_max, first, last))
+        return;
+
+    // A segment can be in several cells, but it's tested only once
+    if (++cull_stamp == 0) {
+        cull_stamps.assign(segments.size(), 0);
+        cull_stamp = 1;
+    }
+    for (size_t y = first[1]; y <= last[1]; y++) {
+        for (size_t x = first[0]; x <= last[0]; x++) {
+            c_min = grid_min + glm::vec2(x, y) * grid_cell_size;
+            if (!is_box_visible(glm::vec3(c_min, 0), glm::vec3(
+                c_min + glm::vec2(grid_cell_size, grid_cell_size), SEGMENT_H)))
+            {
+                continue;
+            }
+            c = y * grid_width + x;
+            for (size_t k = grid_cells[c]; k < grid_cells[c + 1]; k++) {
+                s = grid_segments[k];
+                if (cull_stamps[s] == cull_stamp)
+                    continue;
+                cull_stamps[s] = cull_stamp;
+                if (resident_index[s] < 0)
+                    continue;
+                segments[s]->get_bounding_box(s_min, s_max);
+                if (is_box_visible(glm::vec3(s_min, 0),
+                    glm::vec3(s_max, SEGMENT_H)))
+                {
+                    visible_segments.push_back(resident_index[s]);
+                }
+            }
+        }
+    }
+
+    // In the order of the track, as in the index buffer
+    sort(visible_segments.begin(), visible_segments.end());
+}
+
+/* Find an asset in the asset pack.
+   Parameters:
+     * name: name of the asset.
+   Throws FollowException if the pack doesn't have it.
+*/
+const asset_entry_t&
+VirtualTrack::find_asset(const char *name) const
+{
+    const asset_entry_t *entry = assets->find(name);
+
+    if (!entry) {
+        throw FollowException(
+            string("'") + name + "' not found in " ASSET_PACK_FILE);
+    }
+    return *entry;
+}
+
+/* Find the cells of the grid under a box.
+   Parameters:
+     * min: the corner of the box with the minimum coordinates.
+     * max: the corner of the box with the maximum coordinates.
+     * first: returned first cell in X and Y.
+     * last: returned last cell in X and Y.
+   Return false if the box is outside the grid.
+*/
+bool
+VirtualTrack::get_grid_range(const glm::vec2& min, const glm::vec2& max,
+    size_t first[2], size_t last[2]) const
+{
+    float lo, hi, ncells;
+
+    if (segments.empty())
+        return false;
+    for (int i = 0; i < 2; i++) {
+        ncells = i == 0 ? grid_width : grid_height;
+        lo = floor((min[i] - grid_min[i]) / grid_cell_size);
+        hi = floor((max[i] - grid_min[i]) / grid_cell_size);
+        if (hi < 0 || lo >= ncells)
+            return false;
+        first[i] = lo < 0 ? 0 : lo;
+        last[i] = hi >= ncells ? ncells - 1 : hi;
+    }
+    return true;
 }
 
 // Destroy the track segments.
@@ -319,6 +699,139 @@ VirtualTrack::destroy_segments()
     }
 }
 
+/* Map the asset pack, if there's one. Without it, the textures and the
+   shaders are loaded from their own files.
+*/
+void
+VirtualTrack::init_assets()
+{
+    if (access(ASSET_PACK_FILE, F_OK) == 0)
+        assets = new AssetPack(ASSET_PACK_FILE);
+}
+
+/* Group the draws of the room and the segments in the buffers by texture,
+   converting the strips and fans to lists of triangles, so each texture is
+   drawn with only one call. The index buffer is replaced by the lists of
+   triangles of each texture, one after another, and in each of them the
+   triangles of the room come first and then the ones of each segment, in
+   the order of the track, so the visible segments can be drawn alone.
+   The indices are 16 bits wide if the buffers have up to 65536 vertices.
+   More vertices use 32 bits indices if the GPU supports them, or they are
+   split in chunks of up to 65536 vertices, each one with its own batches.
+*/
+void
+VirtualTrack::init_batches()
+{
+    const char *version = (const char *)glGetString(GL_VERSION);
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    vector<gl_draw_t> draws;
+    vector<GLuint> batches[NUM_TEXTURES];
+    vector<GLuint> indices;
+    vector<GLushort> short_indices;
+    size_t n = resident_segments.size() + 1;
+    size_t total_vertices = ROOM_NUM_VERTICES;
+    size_t first_vertex, nv, first_item, start[NUM_TEXTURES];
+
+    // The floor and the walls
+    gl_draw_t floor = {CARPET_TEXTURE, GL_TRIANGLE_STRIP, 4, 0};
+    gl_draw_t walls = {WALL_TEXTURE, GL_TRIANGLES, 30, 4};
+
+    // Type of the indices
+    for (size_t r = 0; r < resident_segments.size(); r++) {
+        total_vertices += segments[resident_segments[r]]->get_num_vertices();
+    }
+    index_type = GL_UNSIGNED_SHORT;
+    if (total_vertices > MAX_CHUNK_VERTICES
+        && ((version && strncmp(version, "OpenGL ES 3", 11) == 0)
+        || (extensions && strstr(extensions, "GL_OES_element_index_uint"))))
+    {
+        index_type = GL_UNSIGNED_INT;
+    }
+    index_size = index_type == GL_UNSIGNED_INT ?
+        sizeof(GLuint) : sizeof(GLushort);
+
+    // The chunks, the first one has the room
+    chunk_segments.assign(1, 0);
+    chunk_vertices.assign(1, 0);
+    first_vertex = ROOM_NUM_VERTICES;
+    for (size_t r = 0; r < resident_segments.size(); r++) {
+        nv = segments[resident_segments[r]]->get_num_vertices();
+        if (index_type == GL_UNSIGNED_SHORT
+            && first_vertex + nv - chunk_vertices.back() > MAX_CHUNK_VERTICES)
+        {
+            chunk_segments.push_back(r);
+            chunk_vertices.push_back(first_vertex);
+        }
+        first_vertex += nv;
+    }
+    chunk_segments.push_back(resident_segments.size());
+
+    // The ranges of the room (item 0) and each segment (item r + 1) in the
+    // batches of their chunk, then in the index buffer
+    batch_ranges.resize(NUM_TEXTURES * n);
+    for (size_t c = 0; c + 1 < chunk_segments.size(); c++) {
+        first_item = c == 0 ? 0 : chunk_segments[c] + 1;
+        for (size_t k = first_item; k <= chunk_segments[c + 1]; k++) {
+            draws.clear();
+            if (k == 0) {
+                draws.push_back(floor);
+                draws.push_back(walls);
+            } else {
+                segments[resident_segments[k - 1]]->get_draws(draws);
+            }
+            for (int j = 0; j < NUM_TEXTURES; j++) {
+                start[j] = batches[j].size();
+            }
+            for (size_t d = 0; d < draws.size(); d++) {
+                add_triangles(draws[d], chunk_vertices[c], batches);
+            }
+            for (int j = 0; j < NUM_TEXTURES; j++) {
+                gl_draw_t range = {j, GL_TRIANGLES,
+                    (GLsizei)(batches[j].size() - start[j]),
+                    (GLsizei)start[j]};
+                batch_ranges[j * n + k] = range;
+            }
+        }
+
+        // Place the batches of the chunk one after another
+        for (int j = 0; j < NUM_TEXTURES; j++) {
+            for (size_t k = first_item; k <= chunk_segments[c + 1]; k++) {
+                batch_ranges[j * n + k].first += indices.size();
+            }
+            indices.insert(indices.end(), batches[j].begin(),
+                batches[j].end());
+            batches[j].clear();
+        }
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
+    if (index_type == GL_UNSIGNED_INT) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+            &indices[0], GL_STATIC_DRAW);
+    } else {
+        short_indices.assign(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+            short_indices.size() * sizeof(GLushort), &short_indices[0],
+            GL_STATIC_DRAW);
+    }
+
+    delete[] context.indices;
+    context.indices = 0;
+}
+
+// Set the view frustum to see the whole track until the view is set
+void
+VirtualTrack::init_frustum()
+{
+    for (int i = 0; i < 6; i++) {
+        frustum_planes[i] = glm::vec4(0, 0, 0, 1);
+    }
+    frustum_min = glm::vec2(-FLT_MAX, -FLT_MAX);
+    frustum_max = glm::vec2(FLT_MAX, FLT_MAX);
+    cull_stamps.assign(segments.size(), 0);
+    cull_stamp = 0;
+}
+
 // Initialize the geometry.
 void
 VirtualTrack::init_geometry()
@@ -369,35 +882,19 @@ VirtualTrack::init_geometry()
         20, 21, 22, 22, 21, 23
     };
 
-    glBindBuffer(GL_ARRAY_BUFFER, context.vertex_buffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(indices), indices);
+    copy(vertices, vertices + ROOM_NUM_VERTICES, context.vertices);
+    copy(indices, indices + ROOM_NUM_INDICES, context.indices);
 }
 
-// Initialize OpenGL Vertex and Index buffers.
+// Initialize OpenGL Vertex and Index buffers. They are filled with the
+// segments near the eye.
 void
 VirtualTrack::init_gl_buffers()
 {
-    vector<TrackSegment *>::const_iterator it;
-    size_t total_vertices = ROOM_NUM_VERTICES;
-    size_t total_indices = ROOM_NUM_INDICES;
-
-    // Get the total number of vertices and indexes to store in the buffers
-    for (it = segments.begin(); it != segments.end(); it++) {
-        total_vertices += (*it)->get_num_vertices();
-        total_indices += (*it)->get_num_indices();
-    }
-
-    // Generate the buffers
     glGenBuffers(1, &context.vertex_buffer);
     glGenBuffers(1, &context.index_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, context.vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, total_vertices * sizeof(gl_vertex_t), 0,
-        GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_buffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, total_indices * sizeof(GLushort), 0,
-        GL_STATIC_DRAW);
+    context.vertices = 0;
+    context.indices = 0;
 }
 
 // Initialize OpenGL lights.
@@ -435,18 +932,27 @@ VirtualTrack::init_gl_program()
     int e;
     string errmsg;
 
-    // Load the vertex and fragment shaders source files
-    const char *vertex_shader_src = loadfile(VERTEX_SHADER_FILE);
-    if (!vertex_shader_src) {
-        e = errno;
-        throw FollowException(string(
-            "error loading file '" VERTEX_SHADER_FILE "': ") + strerror(e));
-    }
-    const char *fragment_shader_src = loadfile(FRAGMENT_SHADER_FILE);
-    if (!fragment_shader_src) {
-        e = errno;
-        throw FollowException(string(
-            "error loading file '" FRAGMENT_SHADER_FILE "': ") + strerror(e));
+    // Load the vertex and fragment shaders source files, or take them from
+    // the asset pack (they end with a null byte there)
+    const char *vertex_shader_src, *fragment_shader_src;
+    if (assets) {
+        vertex_shader_src = (const char *)assets->get_data(
+            find_asset(VERTEX_SHADER_FILE));
+        fragment_shader_src = (const char *)assets->get_data(
+            find_asset(FRAGMENT_SHADER_FILE));
+    } else {
+        vertex_shader_src = loadfile(VERTEX_SHADER_FILE);
+        if (!vertex_shader_src) {
+            e = errno;
+            throw FollowException(string("error loading file '"
+                VERTEX_SHADER_FILE "': ") + strerror(e));
+        }
+        fragment_shader_src = loadfile(FRAGMENT_SHADER_FILE);
+        if (!fragment_shader_src) {
+            e = errno;
+            throw FollowException(string("error loading file '"
+                FRAGMENT_SHADER_FILE "': ") + strerror(e));
+        }
     }
 
     // Compile the shaders
@@ -498,8 +1004,82 @@ VirtualTrack::init_gl_textures()
 
     // Create the textures
     for (int i = 0; i < NUM_TEXTURES; i++) {
-        create_texture_from_file(texture_info[i].index, texture_info[i].w,
-            texture_info[i].h, texture_info[i].filename);
+        if (assets) {
+            create_texture_from_asset(texture_info[i].index,
+                texture_info[i].w, texture_info[i].h,
+                texture_info[i].filename);
+        } else {
+            create_texture_from_file(texture_info[i].index,
+                texture_info[i].w, texture_info[i].h,
+                texture_info[i].filename);
+        }
+    }
+}
+
+// Build the grid of cells with the segments that overlap each one
+void
+VirtualTrack::init_grid()
+{
+    glm::vec2 min(INT_MAX, INT_MAX), max(INT_MIN, INT_MIN), s_min, s_max;
+    size_t x0, y0, x1, y1, ncells;
+
+    grid_min = glm::vec2(0, 0);
+    grid_cell_size = GRID_CELL_SIZE;
+    grid_width = grid_height = 0;
+    grid_cells.assign(1, 0);
+    grid_segments.clear();
+    if (segments.empty())
+        return;
+
+    // The grid covers the bounding boxes of all the segments, with cells
+    // big enough to keep the number of cells proportional to the number of
+    // segments
+    for (size_t i = 0; i < segments.size(); i++) {
+        segments[i]->get_bounding_box(s_min, s_max);
+        min = glm::min(min, s_min);
+        max = glm::max(max, s_max);
+    }
+    ncells = GRID_CELLS_PER_SEGMENT * segments.size();
+    if ((max[0] - min[0]) * (max[1] - min[1])
+        > ncells * grid_cell_size * grid_cell_size)
+    {
+        grid_cell_size = sqrt((max[0] - min[0]) * (max[1] - min[1]) / ncells);
+    }
+    grid_min = min;
+    grid_width = (max[0] - min[0]) / grid_cell_size + 1;
+    grid_height = (max[1] - min[1]) / grid_cell_size + 1;
+
+    // Count the segments of each cell, then place them (in the order of the
+    // track, the same as without the grid)
+    grid_cells.assign(grid_width * grid_height + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < segments.size(); i++) {
+            segments[i]->get_bounding_box(s_min, s_max);
+            x0 = (s_min[0] - grid_min[0]) / grid_cell_size;
+            y0 = (s_min[1] - grid_min[1]) / grid_cell_size;
+            x1 = (s_max[0] - grid_min[0]) / grid_cell_size;
+            y1 = (s_max[1] - grid_min[1]) / grid_cell_size;
+            for (size_t y = y0; y <= y1; y++) {
+                for (size_t x = x0; x <= x1; x++) {
+                    if (pass == 0)
+                        grid_cells[y * grid_width + x + 1]++;
+                    else
+                        grid_segments[grid_cells[y * grid_width + x]++] = i;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (size_t c = 1; c < grid_cells.size(); c++) {
+                grid_cells[c] += grid_cells[c - 1];
+            }
+            grid_segments.resize(grid_cells.back());
+        } else {
+            // Each cell start was moved to the next cell start
+            for (size_t c = grid_cells.size() - 1; c > 0; c--) {
+                grid_cells[c] = grid_cells[c - 1];
+            }
+            grid_cells[0] = 0;
+        }
     }
 }
 
@@ -521,6 +1101,7 @@ VirtualTrack::init_segments(const vector<segment_t>& segments)
         }
         if (seg.prev >= 0) {
             this->segments[seg.prev]->get_output(seg.output, pos, orient);
+            this->segments[seg.prev]->use_output(seg.output);
         }
         switch ((*it).type) {
             case SEGMENT_STRAIGHT:
@@ -568,19 +1149,182 @@ VirtualTrack::init_segments(const vector<segment_t>& segments)
     }
 }
 
-// Define the segments geometry.
+// Define the segments geometry. Only their bounding boxes and their shapes
+// are kept, the vertices are computed again when they go to the buffers.
+// The shapes don't change after this, the robots test them with contains
+// while the segments are streamed.
 void
 VirtualTrack::init_segments_geometry()
 {
     vector<TrackSegment *>::const_iterator it;
-    size_t vertices_i = ROOM_NUM_VERTICES;
-    size_t indices_i = ROOM_NUM_INDICES;
 
     for (it = segments.begin(); it != segments.end(); it++) {
-        (*it)->init_geometry(vertices_i, indices_i, context);
-        vertices_i += (*it)->get_num_vertices();
-        indices_i += (*it)->get_num_indices();
+        (*it)->init_geometry();
+    }
+}
+
+/* Return if a box is inside the view frustum, even partially. The test is
+   conservative: a box near a corner of the frustum can be outside it.
+   Parameters:
+     * min: the corner of the box with the minimum coordinates.
+     * max: the corner of the box with the maximum coordinates.
+*/
+bool
+VirtualTrack::is_box_visible(const glm::vec3& min, const glm::vec3& max)
+    const
+{
+    // The box is outside if the corner farthest along the normal of a plane
+    // is behind it
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& p = frustum_planes[i];
+        if (p.x * (p.x > 0 ? max.x : min.x) + p.y * (p.y > 0 ? max.y : min.y)
+            + p.z * (p.z > 0 ? max.z : min.z) + p.w < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Compute the planes of the view frustum, and the bounding box of the part
+   of it where the segments are, from the floor to the top of their sides.
+   Parameters:
+     * mvp: the modelview-projection matrix.
+*/
+void
+VirtualTrack::set_frustum(const glm::mat4& mvp)
+{
+    glm::mat4 inverse = glm::inverse(mvp);
+    const float z[2] = {0, SEGMENT_H};
+    glm::vec3 corners[8], p;
+    glm::vec4 v;
+    float t;
+    int b;
+
+    // The planes are ax + by + cz + d >= 0 inside the frustum, and they are
+    // the last row of the matrix plus and minus each of the other rows
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            frustum_planes[2 * i][j] = mvp[j][3] + mvp[j][i];
+            frustum_planes[2 * i + 1][j] = mvp[j][3] - mvp[j][i];
+        }
+    }
+
+    // The corners of the frustum, the bits of the index are the X, Y and Z
+    // of the corner in normalized device coordinates
+    for (int i = 0; i < 8; i++) {
+        v = inverse * glm::vec4(i & 1 ? 1 : -1, i & 2 ? 1 : -1,
+            i & 4 ? 1 : -1, 1);
+        corners[i] = glm::vec3(v) / v.w;
+    }
+
+    // The box contains the corners between the two heights, and the points
+    // where the edges of the frustum cross them
+    frustum_min = glm::vec2(FLT_MAX, FLT_MAX);
+    frustum_max = glm::vec2(-FLT_MAX, -FLT_MAX);
+    for (int a = 0; a < 8; a++) {
+        if (corners[a].z >= z[0] && corners[a].z <= z[1]) {
+            frustum_min = glm::min(frustum_min, glm::vec2(corners[a]));
+            frustum_max = glm::max(frustum_max, glm::vec2(corners[a]));
+        }
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (a & bit)
+                continue;
+            b = a | bit;
+            for (int k = 0; k < 2; k++) {
+                if ((corners[a].z - z[k]) * (corners[b].z - z[k]) >= 0)
+                    continue;
+                t = (z[k] - corners[a].z) / (corners[b].z - corners[a].z);
+                p = corners[a] + (corners[b] - corners[a]) * t;
+                frustum_min = glm::min(frustum_min, glm::vec2(p));
+                frustum_max = glm::max(frustum_max, glm::vec2(p));
+            }
+        }
+    }
+}
+
+/* Build the buffers with the segments near a position: the ones whose
+   bounding box is closer than the stream radius in X and Y, found with the
+   grid, or all of them without stream radius. Their vertices and indices
+   are computed again in the new places, and the buffers replaced. Only the
+   buffers change, not the segments.
+   Parameters:
+     * center: the position.
+*/
+void
+VirtualTrack::stream_segments(const glm::vec2& center)
+{
+    glm::vec2 s_min, s_max, r_min, r_max;
+    size_t first[2], last[2], c, total_vertices, total_indices;
+    uint32_t s;
+
+    // The segments near the position
+    for (size_t r = 0; r < resident_segments.size(); r++) {
+        resident_index[resident_segments[r]] = -1;
+    }
+    resident_index.resize(segments.size(), -1);
+    resident_segments.clear();
+    r_min = center - glm::vec2(stream_radius, stream_radius);
+    r_max = center + glm::vec2(stream_radius, stream_radius);
+    if (stream_radius <= 0) {
+        for (size_t i = 0; i < segments.size(); i++) {
+            resident_segments.push_back(i);
+        }
+    } else if (get_grid_range(r_min, r_max, first, last)) {
+        if (++cull_stamp == 0) {
+            cull_stamps.assign(segments.size(), 0);
+            cull_stamp = 1;
+        }
+        for (size_t y = first[1]; y <= last[1]; y++) {
+            for (size_t x = first[0]; x <= last[0]; x++) {
+                c = y * grid_width + x;
+                for (size_t k = grid_cells[c]; k < grid_cells[c + 1]; k++) {
+                    s = grid_segments[k];
+                    if (cull_stamps[s] == cull_stamp)
+                        continue;
+                    cull_stamps[s] = cull_stamp;
+                    segments[s]->get_bounding_box(s_min, s_max);
+                    if (s_max[0] >= r_min[0] && s_min[0] <= r_max[0]
+                        && s_max[1] >= r_min[1] && s_min[1] <= r_max[1])
+                    {
+                        resident_segments.push_back(s);
+                    }
+                }
+            }
+        }
+        sort(resident_segments.begin(), resident_segments.end());
+    }
+
+    // The vertices and indices of the room and the segments, one after
+    // another
+    total_vertices = ROOM_NUM_VERTICES;
+    total_indices = ROOM_NUM_INDICES;
+    for (size_t r = 0; r < resident_segments.size(); r++) {
+        total_vertices += segments[resident_segments[r]]->get_num_vertices();
+        total_indices += segments[resident_segments[r]]->get_num_indices();
     }
+    context.vertices = new gl_vertex_t[total_vertices];
+    context.indices = new GLuint[total_indices];
+    init_geometry();
+    total_vertices = ROOM_NUM_VERTICES;
+    total_indices = ROOM_NUM_INDICES;
+    for (size_t r = 0; r < resident_segments.size(); r++) {
+        s = resident_segments[r];
+        resident_index[s] = r;
+        segments[s]->fill_geometry(total_vertices, total_indices, context);
+        total_vertices += segments[s]->get_num_vertices();
+        total_indices += segments[s]->get_num_indices();
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, context.vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, total_vertices * sizeof(gl_vertex_t),
+        context.vertices, GL_STATIC_DRAW);
+    delete[] context.vertices;
+    context.vertices = 0;
+
+    // The index buffer is filled when the indices are grouped by texture
+    init_batches();
+    stream_center = center;
 }
 
 // Destroy the opengl resources
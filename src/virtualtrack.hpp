@@ -4,9 +4,13 @@
 
 #include <GLES2/gl2.h>
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <stdint.h>
 #include <vector>
 
+#include "assetpack.hpp"
 #include "gl.hpp"
 #include "tracksegment.hpp"
 
@@ -59,8 +63,10 @@ class VirtualTrack {
            Parameters:
              * segments: sequence of segments to build the track. The last one
                          must be SEGMENT_NULL.
+             * stream_radius: distance from the eye to the segments kept in
+                 the buffers, or 0 to keep the whole track.
         */
-        VirtualTrack(const vector<segment_t>& segments);
+        VirtualTrack(const vector<segment_t>& segments, float stream_radius);
 
         // Destructor
         ~VirtualTrack();
@@ -71,13 +77,44 @@ class VirtualTrack {
              * position: position to correct.
              * orientation: orientation to correct.
              * normal: normal to correct.
+             * hint: segment hint of the caller, as in find_segment.
         */
         void correct_position(glm::vec3& position, glm::vec3& orientation,
-            glm::vec3& normal) const;
+            glm::vec3& normal, int& hint) const;
+
+        /* Find the segment that contains the projection of a position. The
+           segment given as hint is checked first, and then only the
+           segments in the cell of the grid where the position is. The
+           track is shared by several robots, so each caller keeps its own
+           hint.
+           Parameters:
+             * position: the position.
+             * hint: segment found the previous time by the caller (-1 if
+                   none), updated with the one found.
+           Return the index of the segment, or -1 if the position is outside
+           the track.
+        */
+        int find_segment(const glm::vec3& position, int& hint) const;
 
         // Return the scene's bounding sphere
         void get_bounding_sphere(glm::vec3& center, float& radius) const;
 
+        /* Return the distance from a position to the center line of the road
+           of a segment.
+           Parameters:
+             * segment: index of the segment.
+             * position: the position.
+        */
+        float get_center_distance(size_t segment, const glm::vec3& position)
+            const;
+
+        // Return the number of segments of the track
+        size_t get_num_segments() const;
+
+        // Return true if the last segment connects with the first one, so
+        // that the track is a loop
+        bool is_closed() const;
+
         /* Get the starting position for the mobile.
            Parameters:
              * position: returned starting position.
@@ -97,8 +134,11 @@ class VirtualTrack {
              * fovv: vertical Field Of View.
              * znear: near clip distance.
              * zfar: far clip distance.
+             * flip: flip the image vertically, so the top row is the first one
+                 in the framebuffer.
         */
-        void set_projection(float fovh, float fovv, float znear, float zfar);
+        void set_projection(float fovh, float fovv, float znear, float zfar,
+            bool flip);
 
         /* Set the point of view.
            Parameters:
@@ -110,28 +150,81 @@ class VirtualTrack {
         void set_view(const glm::vec3& eye, const glm::vec3& center,
             const glm::vec3& up);
 
+        // Keep the whole track in the buffers from now on
+        void stop_streaming();
+
     private:
 
+        /* Add a draw to the batch of its texture, as a list of triangles.
+           Parameters:
+             * draw: the draw, with the indices in context.indices.
+             * base: vertex of the chunk that the index 0 refers to.
+             * batches: the indices of the triangles of each texture.
+        */
+        void add_triangles(const gl_draw_t& draw, GLuint base,
+            vector<GLuint> batches[NUM_TEXTURES]);
+
+        /* Set the vertex attributes to the vertex buffer.
+           Parameters:
+             * first_vertex: vertex that the index 0 refers to.
+        */
+        void bind_vertices(size_t first_vertex);
+
         // Compile a vertex/fragment shader
         GLuint compile_shader(GLenum type, const char *shader_src);
 
         // Compute the bounding box and sphere of the scene
         void compute_bounding_box();
 
-        // Creates a texture from an array
+        // Creates a texture from an array with its mip levels
         void create_texture_from_array(GLint texid, GLsizei width,
-            GLsizei height, const GLvoid *data);
+            GLsizei height, uint32_t levels, const unsigned char *data);
+
+        // Creates a texture from the asset pack, with all its mip levels
+        void create_texture_from_asset(GLint texid, GLsizei width,
+            GLsizei height, const char *name);
 
-        // Creates a texture from a file
+        // Creates a texture from a file, with the same mip levels as in
+        // the asset pack
         void create_texture_from_file(GLint texid, GLsizei width,
             GLsizei height, const char *file);
 
+        // Find the segments inside the view frustum
+        void cull_segments();
+
         // Destroy the opengl resources
         void destroy_gl();
 
         // Destroy the track segments
         void destroy_segments();
 
+        /* Find an asset in the asset pack.
+           Parameters:
+             * name: name of the asset.
+           Throws FollowException if the pack doesn't have it.
+        */
+        const asset_entry_t& find_asset(const char *name) const;
+
+        /* Find the cells of the grid under a box.
+           Parameters:
+             * min: the corner of the box with the minimum coordinates.
+             * max: the corner of the box with the maximum coordinates.
+             * first: returned first cell in X and Y.
+             * last: returned last cell in X and Y.
+           Return false if the box is outside the grid.
+        */
+        bool get_grid_range(const glm::vec2& min, const glm::vec2& max,
+            size_t first[2], size_t last[2]) const;
+
+        // Map the asset pack, if there's one
+        void init_assets();
+
+        // Group the draws of the room and the segments by texture
+        void init_batches();
+
+        // Set the view frustum to see the whole track until the view is set
+        void init_frustum();
+
         // Initialize the geometry.
         void init_geometry();
 
@@ -147,12 +240,30 @@ class VirtualTrack {
         // Initialize textures
         void init_gl_textures();
 
+        // Build the grid of cells with the segments that overlap each one
+        void init_grid();
+
         // Build the track segments.
         void init_segments(const vector<segment_t>& segments);
 
         // Define the segments geometry.
         void init_segments_geometry();
 
+        // Return if a box is inside the view frustum, even partially
+        bool is_box_visible(const glm::vec3& min, const glm::vec3& max) const;
+
+        /* Compute the planes and the bounding box of the view frustum.
+           Parameters:
+             * mvp: the modelview-projection matrix.
+        */
+        void set_frustum(const glm::mat4& mvp);
+
+        /* Build the buffers with the segments near a position.
+           Parameters:
+             * center: the position.
+        */
+        void stream_segments(const glm::vec2& center);
+
         // The track segments
         vector<TrackSegment *> segments;
 
@@ -170,6 +281,66 @@ class VirtualTrack {
         glm::vec3 bs_center;
         float bs_radius;
 
+        // Uniform grid over the segments' bounding boxes: origin, size of
+        // the cells and number of cells in X and Y
+        glm::vec2 grid_min;
+        float grid_cell_size;
+        size_t grid_width;
+        size_t grid_height;
+
+        // Segments that overlap each cell, in order: the ones of cell i are
+        // grid_segments[grid_cells[i]] to grid_segments[grid_cells[i + 1]]
+        vector<uint32_t> grid_cells;
+        vector<uint32_t> grid_segments;
+
+        // Distance from the eye to the segments in the buffers (0 for the
+        // whole track), and position around which they were chosen
+        float stream_radius;
+        glm::vec2 stream_center;
+
+        // Segments in the buffers, in the order of the track, and position
+        // of each segment in resident_segments (-1 if it isn't there)
+        vector<uint32_t> resident_segments;
+        vector<int32_t> resident_index;
+
+        // Ranges of the index buffer with the triangles of each texture.
+        // With n segments in the buffers, for the texture i,
+        // batch_ranges[i * (n + 1)] has the ones of the room and
+        // batch_ranges[i * (n + 1) + r + 1] the ones of the segment
+        // resident_segments[r]
+        vector<gl_draw_t> batch_ranges;
+
+        // Type and size of the indices of the index buffer
+        GLenum index_type;
+        size_t index_size;
+
+        // Chunks of the buffers with up to 65536 vertices, when the indices
+        // are 16 bits wide (only one chunk with 32 bits indices): the first
+        // segment (position in resident_segments) and the first vertex of
+        // each one. The room is in the first chunk, and chunk_segments ends
+        // with the number of segments in the buffers
+        vector<size_t> chunk_segments;
+        vector<size_t> chunk_vertices;
+
+        // Planes of the view frustum, and the bounding box of its part
+        // where the segments are
+        glm::vec4 frustum_planes[6];
+        glm::vec2 frustum_min;
+        glm::vec2 frustum_max;
+
+        // Segments inside the view frustum (positions in resident_segments),
+        // in the order of the track, and number of the culling that tested
+        // each segment the last time
+        vector<uint32_t> visible_segments;
+        vector<uint32_t> cull_stamps;
+        uint32_t cull_stamp;
+
+        // Draws of the last rendered frame
+        vector<gl_draw_t> frame_draws;
+
+        // The asset pack, only while the track is built (0 without it)
+        AssetPack *assets;
+
         // Texture info
         const static texture_info_t texture_info[];
 };
@@ -0,0 +1,113 @@
+
+#include <err.h>
+#include <unistd.h>
+
+#include "workerpool.hpp"
+
+/* Constructor.
+   Parameters:
+     * nworkers: number of workers, counting the calling thread. If it is 0,
+         one worker per online CPU is used.
+*/
+WorkerPool::WorkerPool(size_t nworkers):
+    nworkers(nworkers), threads(0), workers(0), task(0), arg(0), stop(false)
+{
+    long ncpus;
+
+    if (!this->nworkers) {
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        this->nworkers = (ncpus > 0) ? ncpus : 1;
+    }
+    // A single worker is just the calling thread
+    if (this->nworkers == 1) {
+        return;
+    }
+    pthread_barrier_init(&barrier_start, 0, this->nworkers);
+    pthread_barrier_init(&barrier_end, 0, this->nworkers);
+
+    // Create the worker threads. The worker 0 is the calling thread.
+    threads = new pthread_t[this->nworkers - 1];
+    workers = new worker_t[this->nworkers - 1];
+    for (size_t i = 0; i < this->nworkers - 1; i++) {
+        workers[i].pool = this;
+        workers[i].index = i + 1;
+        if (pthread_create(&threads[i], 0, thread_main, &workers[i])) {
+            err(1, "cannot create worker thread");
+        }
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    if (threads) {
+        // Wake up the workers to make them exit
+        stop = true;
+        pthread_barrier_wait(&barrier_start);
+        for (size_t i = 0; i < nworkers - 1; i++) {
+            pthread_join(threads[i], 0);
+        }
+        pthread_barrier_destroy(&barrier_start);
+        pthread_barrier_destroy(&barrier_end);
+        delete[] threads;
+        delete[] workers;
+    }
+}
+
+// Return the number of workers
+size_t
+WorkerPool::get_size() const
+{
+    return nworkers;
+}
+
+/* Run a task in all the workers and wait until all of them finish.
+   Parameters:
+     * task: the task to run.
+     * arg: argument to give to the task.
+*/
+void
+WorkerPool::run(worker_task_t task, void *arg)
+{
+    if (!threads) {
+        task(arg, 0, 1);
+        return;
+    }
+    this->task = task;
+    this->arg = arg;
+    pthread_barrier_wait(&barrier_start);
+    task(arg, 0, nworkers);
+    pthread_barrier_wait(&barrier_end);
+}
+
+// PRIVATE FUNCTIONS
+
+/* Main loop of a worker thread.
+   Parameters:
+     * worker: index of the worker.
+*/
+void
+WorkerPool::work(size_t worker)
+{
+    while (1) {
+        pthread_barrier_wait(&barrier_start);
+        if (stop) {
+            break;
+        }
+        task(arg, worker, nworkers);
+        pthread_barrier_wait(&barrier_end);
+    }
+}
+
+/* Thread main routine.
+   Parameters:
+     * worker: the worker_t of the thread.
+*/
+void *
+WorkerPool::thread_main(void *worker)
+{
+    worker_t *w = (worker_t *)worker;
+
+    w->pool->work(w->index);
+    return 0;
+}
+
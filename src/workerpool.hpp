@@ -0,0 +1,86 @@
+/* workerpool.hpp
+   A small pool of persistent threads that run the same task in parallel.
+   The thread that calls run also works as one of the workers.
+*/
+
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <pthread.h>
+#include <sys/types.h>
+
+/* Type of the tasks run by the pool.
+   Parameters:
+     * arg: argument given to run.
+     * worker: index of the worker that runs the task.
+     * nworkers: total number of workers.
+*/
+typedef void (*worker_task_t)(void *arg, size_t worker, size_t nworkers);
+
+class WorkerPool;
+
+// Arguments for each worker thread
+typedef struct {
+    WorkerPool *pool;
+    size_t index;
+} worker_t;
+
+class WorkerPool {
+
+    public:
+
+        /* Constructor.
+           Parameters:
+             * nworkers: number of workers, counting the calling thread. If
+                 it is 0, one worker per online CPU is used.
+        */
+        WorkerPool(size_t nworkers);
+
+        ~WorkerPool();
+
+        // Return the number of workers
+        size_t get_size() const;
+
+        /* Run a task in all the workers and wait until all of them finish.
+           Parameters:
+             * task: the task to run.
+             * arg: argument to give to the task.
+        */
+        void run(worker_task_t task, void *arg);
+
+    private:
+
+        // Number of workers (including the calling thread)
+        size_t nworkers;
+
+        // The worker threads and their arguments
+        pthread_t *threads;
+        worker_t *workers;
+
+        // Barriers to start and finish each task
+        pthread_barrier_t barrier_start;
+        pthread_barrier_t barrier_end;
+
+        // Current task and its argument
+        worker_task_t task;
+        void *arg;
+
+        // true when the workers must exit
+        bool stop;
+
+        /* Main loop of a worker thread.
+           Parameters:
+             * worker: index of the worker.
+        */
+        void work(size_t worker);
+
+        /* Thread main routine.
+           Parameters:
+             * worker: the worker_t of the thread.
+        */
+        static void *thread_main(void *worker);
+
+};
+
+#endif
+